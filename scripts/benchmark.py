@@ -0,0 +1,240 @@
+#!/usr/bin/env python3
+"""Mede o desempenho de ``parallel_spotify`` com várias quantidades de processos.
+
+Para cada quantidade de processos o script executa o binário ``--trials`` vezes,
+cada execução com o seu próprio diretório de saída, lê o
+``performance_metrics.json`` produzido e agrega os resultados em:
+
+- ``<bench-dir>/results.csv`` – uma linha por execução, com o tempo de parede
+  medido pelo script, ``total_time``/``compute_time`` máximos e o tempo máximo
+  de cada fase reportada pelo executável;
+- ``<bench-dir>/summary.json`` – média e desvio padrão por quantidade de
+  processos, com aceleração e eficiência relativas à menor quantidade medida.
+
+Modos de escalonamento:
+
+- ``strong`` (padrão): o mesmo dataset para todas as quantidades de processos;
+- ``weak``: o dataset é replicado ``P`` vezes (registros concatenados, um único
+  cabeçalho), mantendo constante o volume por processo.
+
+Estados de cache:
+
+- ``warm`` (padrão): uma execução de aquecimento, descartada, antecede as
+  medições de cada quantidade de processos, de modo que o dataset (e o cache
+  de ``--use-cache``) já estejam na memória;
+- ``cold``: antes de cada execução as páginas do dataset são descartadas do
+  cache do sistema com ``posix_fadvise(POSIX_FADV_DONTNEED)`` e o diretório
+  de ``--use-cache`` é apagado, de modo que o cache seja reconstruído.
+
+Argumentos após ``--`` são repassados ao executável. O lançador MPI pode ser
+ajustado com ``--mpirun`` ou com a variável de ambiente ``MPIRUN``.
+
+Exemplo de uso::
+
+    python scripts/benchmark.py spotify_millsongdata.csv --processes 1 2 4 8 \
+        --trials 5 --mode strong -- --threads 2
+"""
+
+from __future__ import annotations
+
+import argparse
+import csv
+import json
+import os
+import shlex
+import shutil
+import statistics
+import subprocess
+import sys
+import time
+from pathlib import Path
+from typing import Dict, List, Sequence
+
+PHASES = ("prepare", "read", "tokenize", "artists", "merge", "serialize", "communicate", "sort", "write")
+
+
+def parse_args(argv: Sequence[str]) -> argparse.Namespace:
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0],
+                                     epilog="Argumentos após -- são repassados ao executável.")
+    parser.add_argument("dataset", type=Path, help="CSV do Spotify Million Song Dataset")
+    parser.add_argument("--processes", type=int, nargs="+", default=[1, 2, 4],
+                        help="quantidades de processos MPI (padrão: 1 2 4)")
+    parser.add_argument("--trials", type=int, default=3, help="execuções medidas por quantidade (padrão: 3)")
+    parser.add_argument("--mode", choices=("strong", "weak"), default="strong",
+                        help="escalonamento forte ou fraco (padrão: strong)")
+    parser.add_argument("--state", choices=("warm", "cold"), default="warm",
+                        help="estado do cache antes de cada execução (padrão: warm)")
+    parser.add_argument("--use-cache", action="store_true",
+                        help="repassa --cache <bench-dir>/cache ao executável")
+    parser.add_argument("--bench-dir", type=Path, default=Path("bench"),
+                        help="diretório dos resultados (padrão: bench)")
+    parser.add_argument("--binary", type=Path, default=Path("bin/parallel_spotify"),
+                        help="executável MPI (padrão: bin/parallel_spotify)")
+    parser.add_argument("--mpirun", default=os.environ.get("MPIRUN", "mpirun"),
+                        help="lançador MPI, com opções (padrão: $MPIRUN ou mpirun)")
+    argv = list(argv)
+    # Tudo após o primeiro "--" pertence ao executável, não ao script.
+    extra: List[str] = []
+    if "--" in argv:
+        split = argv.index("--")
+        argv, extra = argv[:split], argv[split + 1:]
+    args = parser.parse_args(argv)
+    args.extra = extra
+    if args.trials < 1 or any(p < 1 for p in args.processes):
+        parser.error("--trials e --processes devem ser positivos")
+    args.processes = sorted(set(args.processes))
+    return args
+
+
+def drop_page_cache(path: Path) -> None:
+    """Descarta as páginas do arquivo do cache do sistema, quando suportado."""
+    if not hasattr(os, "posix_fadvise"):
+        return
+    fd = os.open(path, os.O_RDONLY)
+    try:
+        os.fsync(fd)
+        os.posix_fadvise(fd, 0, 0, os.POSIX_FADV_DONTNEED)
+    finally:
+        os.close(fd)
+
+
+def weak_dataset(source: Path, copies: int, directory: Path) -> Path:
+    """Replica os registros de ``source`` ``copies`` vezes, sob um único cabeçalho."""
+    if copies == 1:
+        return source
+    directory.mkdir(parents=True, exist_ok=True)
+    target = directory / f"{source.stem}_x{copies}{source.suffix}"
+    if target.exists() and target.stat().st_mtime >= source.stat().st_mtime:
+        return target
+    # O cabeçalho é a primeira linha; as letras entre aspas só começam depois.
+    with source.open("rb") as handle:
+        header = handle.readline()
+        body = handle.read()
+    if body and not body.endswith(b"\n"):
+        body += b"\n"
+    partial = target.with_suffix(target.suffix + ".tmp")
+    with partial.open("wb") as handle:
+        handle.write(header)
+        for _ in range(copies):
+            handle.write(body)
+    partial.replace(target)
+    return target
+
+
+def run_once(args: argparse.Namespace, dataset: Path, processes: int, output_dir: Path) -> Dict[str, float]:
+    """Executa o binário uma vez e devolve os tempos medidos."""
+    if output_dir.exists():
+        shutil.rmtree(output_dir)
+    cache_dir = args.bench_dir / "cache"
+    if args.state == "cold":
+        if args.use_cache and cache_dir.exists():
+            shutil.rmtree(cache_dir)
+        drop_page_cache(dataset)
+    command = shlex.split(args.mpirun) + ["-np", str(processes), str(args.binary), str(dataset),
+                                          "--output-dir", str(output_dir)]
+    if args.use_cache:
+        command += ["--cache", str(cache_dir)]
+    command += args.extra
+    started = time.perf_counter()
+    completed = subprocess.run(command, stdout=subprocess.PIPE, stderr=subprocess.STDOUT, text=True)
+    wall = time.perf_counter() - started
+    (output_dir.parent / f"{output_dir.name}.log").write_text(completed.stdout)
+    if completed.returncode != 0:
+        sys.stderr.write(completed.stdout)
+        raise SystemExit(f"Execução falhou ({completed.returncode}): {shlex.join(command)}")
+    with (output_dir / "performance_metrics.json").open() as handle:
+        metrics = json.load(handle)
+    row = {
+        "wall_seconds": wall,
+        "total_seconds": metrics["total_time"]["max_seconds"],
+        "compute_seconds": metrics["compute_time"]["max_seconds"],
+    }
+    phases = metrics.get("phases", {})
+    for phase in PHASES:
+        row[f"{phase}_seconds"] = phases.get(phase, {}).get("max_seconds", 0.0)
+    return row
+
+
+def summarize(rows: List[Dict[str, object]], mode: str) -> List[Dict[str, object]]:
+    """Média e desvio padrão por quantidade de processos, com aceleração e eficiência."""
+    summary = []
+    for processes in sorted({int(row["processes"]) for row in rows}):
+        selected = [row for row in rows if row["processes"] == processes]
+        entry: Dict[str, object] = {"processes": processes, "trials": len(selected)}
+        for key in ("wall_seconds", "total_seconds", "compute_seconds"):
+            values = [float(row[key]) for row in selected]
+            entry[key] = {
+                "mean": statistics.fmean(values),
+                "stdev": statistics.stdev(values) if len(values) > 1 else 0.0,
+                "min": min(values),
+            }
+        summary.append(entry)
+    if not summary:
+        return summary
+    base_processes = int(summary[0]["processes"])
+    base_time = float(summary[0]["total_seconds"]["mean"])
+    for entry in summary:
+        ratio = base_processes / int(entry["processes"])
+        elapsed = float(entry["total_seconds"]["mean"])
+        relative = base_time / elapsed if elapsed > 0 else 0.0
+        # No escalonamento fraco o trabalho cresce com P: tempo constante é eficiência 1.
+        if mode == "strong":
+            entry["speedup"] = relative
+            entry["efficiency"] = relative * ratio
+        else:
+            entry["speedup"] = relative / ratio
+            entry["efficiency"] = relative
+    return summary
+
+
+def main(argv: Sequence[str]) -> int:
+    args = parse_args(argv)
+    if not args.dataset.is_file():
+        print(f"Dataset não encontrado: {args.dataset}", file=sys.stderr)
+        return 1
+    if not args.binary.is_file():
+        print(f"Executável não encontrado: {args.binary} (execute make)", file=sys.stderr)
+        return 1
+    runs_dir = args.bench_dir / "runs"
+    runs_dir.mkdir(parents=True, exist_ok=True)
+
+    rows: List[Dict[str, object]] = []
+    for processes in args.processes:
+        copies = processes if args.mode == "weak" else 1
+        dataset = weak_dataset(args.dataset, copies, args.bench_dir / "datasets")
+        if args.state == "warm":
+            run_once(args, dataset, processes, runs_dir / f"{args.mode}-np{processes}-warmup")
+        for trial in range(1, args.trials + 1):
+            output_dir = runs_dir / f"{args.mode}-np{processes}-t{trial}"
+            row: Dict[str, object] = {"mode": args.mode, "state": args.state, "processes": processes,
+                                      "trial": trial}
+            row.update(run_once(args, dataset, processes, output_dir))
+            rows.append(row)
+            print(f"np={processes} trial={trial} total={row['total_seconds']:.3f}s "
+                  f"compute={row['compute_seconds']:.3f}s wall={row['wall_seconds']:.3f}s", flush=True)
+
+    with (args.bench_dir / "results.csv").open("w", newline="") as handle:
+        writer = csv.DictWriter(handle, fieldnames=list(rows[0].keys()))
+        writer.writeheader()
+        writer.writerows(rows)
+    summary = {
+        "dataset": str(args.dataset),
+        "mode": args.mode,
+        "state": args.state,
+        "extra_args": args.extra,
+        "results": summarize(rows, args.mode),
+    }
+    with (args.bench_dir / "summary.json").open("w") as handle:
+        json.dump(summary, handle, indent=2)
+        handle.write("\n")
+
+    print(f"{'np':>4} {'total_mean':>11} {'stdev':>8} {'speedup':>8} {'efficiency':>10}")
+    for entry in summary["results"]:
+        total = entry["total_seconds"]
+        print(f"{entry['processes']:>4} {total['mean']:>11.3f} {total['stdev']:>8.3f} "
+              f"{entry['speedup']:>8.2f} {entry['efficiency']:>10.2f}")
+    return 0
+
+
+if __name__ == "__main__":
+    raise SystemExit(main(sys.argv[1:]))
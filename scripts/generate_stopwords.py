@@ -0,0 +1,129 @@
+#!/usr/bin/env python3
+"""Gera a tabela de hash perfeito das stop words padrão do executável MPI.
+
+Lê ``src/stopwords_default.txt`` (uma palavra por linha, ``#`` para
+comentários) e grava ``src/stopwords_default.h`` com uma tabela de hash
+perfeito em dois níveis: o hash FNV-1a da palavra (o mesmo de ``hash_bytes``
+em ``parallel_spotify.c``) escolhe um balde, e a semente do balde, misturada
+ao hash, leva a uma posição exclusiva da tabela. Assim a consulta em tempo de
+execução custa um hash, duas leituras e uma comparação, sem colisões.
+
+O cabeçalho gerado é versionado para que a compilação não dependa do Python;
+o ``Makefile`` o regenera quando a lista ou este script mudam.
+"""
+
+from __future__ import annotations
+
+import argparse
+from pathlib import Path
+
+MASK64 = (1 << 64) - 1
+FNV_OFFSET_BASIS = 1469598103934665603
+FNV_PRIME = 1099511628211
+MIX_MULTIPLIER = 0x9E3779B97F4A7C15
+MAX_SEED = 1 << 20
+
+
+def fnv1a(data: bytes) -> int:
+    """Replica ``hash_bytes`` do código C."""
+    value = FNV_OFFSET_BASIS
+    for byte in data:
+        value = ((value ^ byte) * FNV_PRIME) & MASK64
+    return value
+
+
+def slot_for(hash_value: int, seed: int, table_bits: int) -> int:
+    """Replica a mistura usada por ``default_stopword`` no código C."""
+    mixed = ((hash_value ^ seed) * MIX_MULTIPLIER) & MASK64
+    return mixed >> (64 - table_bits)
+
+
+def load_words(path: Path) -> list[bytes]:
+    words: list[bytes] = []
+    seen: set[bytes] = set()
+    for line in path.read_text(encoding="utf-8").splitlines():
+        word = line.strip().lower()
+        if not word or word.startswith("#"):
+            continue
+        encoded = word.encode("utf-8")
+        if encoded not in seen:
+            seen.add(encoded)
+            words.append(encoded)
+    if not words:
+        raise SystemExit(f"Nenhuma palavra encontrada em {path}")
+    return words
+
+
+def build_table(words: list[bytes]) -> tuple[int, int, list[int], list[bytes | None]]:
+    """Procura sementes por balde, tratando primeiro os baldes mais cheios."""
+    table_bits = max(4, (len(words) * 2 - 1).bit_length())
+    table_size = 1 << table_bits
+    bucket_count = max(1, table_size // 4)
+    buckets: list[list[bytes]] = [[] for _ in range(bucket_count)]
+    for word in words:
+        buckets[fnv1a(word) % bucket_count].append(word)
+
+    seeds = [0] * bucket_count
+    table: list[bytes | None] = [None] * table_size
+    order = sorted(range(bucket_count), key=lambda index: len(buckets[index]), reverse=True)
+    for index in order:
+        bucket = buckets[index]
+        if not bucket:
+            continue
+        for seed in range(MAX_SEED):
+            slots = {slot_for(fnv1a(word), seed, table_bits) for word in bucket}
+            if len(slots) == len(bucket) and all(table[slot] is None for slot in slots):
+                break
+        else:
+            raise SystemExit(f"Sem semente livre para o balde {index}")
+        seeds[index] = seed
+        for word in bucket:
+            table[slot_for(fnv1a(word), seed, table_bits)] = word
+    return table_bits, bucket_count, seeds, table
+
+
+def c_string(word: bytes) -> str:
+    return '"' + "".join(chr(b) if 32 <= b < 127 and b not in (34, 92) else f"\\x{b:02x}" for b in word) + '"'
+
+
+def render(source: Path, words: list[bytes]) -> str:
+    table_bits, bucket_count, seeds, table = build_table(words)
+    lines = [
+        f"/* Gerado por scripts/generate_stopwords.py a partir de {source.as_posix()}; não editar. */",
+        "#ifndef STOPWORDS_DEFAULT_H",
+        "#define STOPWORDS_DEFAULT_H",
+        "",
+        f"#define STOPWORD_COUNT {len(words)}",
+        f"#define STOPWORD_MAX_LENGTH {max(len(word) for word in words)}",
+        f"#define STOPWORD_TABLE_BITS {table_bits}",
+        f"#define STOPWORD_BUCKETS {bucket_count}",
+        "",
+        "static const uint32_t stopword_seeds[STOPWORD_BUCKETS] = {",
+    ]
+    for start in range(0, bucket_count, 8):
+        lines.append("    " + ", ".join(f"{seed}U" for seed in seeds[start:start + 8]) + ",")
+    lines.append("};")
+    lines.append("")
+    lines.append("static const StringView stopword_table[1U << STOPWORD_TABLE_BITS] = {")
+    for word in table:
+        if word is None:
+            lines.append("    {NULL, 0},")
+        else:
+            lines.append(f"    {{{c_string(word)}, {len(word)}}},")
+    lines.append("};")
+    lines.append("")
+    lines.append("#endif")
+    return "\n".join(lines) + "\n"
+
+
+def main() -> None:
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("source", nargs="?", default="src/stopwords_default.txt")
+    parser.add_argument("output", nargs="?", default="src/stopwords_default.h")
+    args = parser.parse_args()
+    source = Path(args.source)
+    Path(args.output).write_text(render(source, load_words(source)), encoding="utf-8")
+
+
+if __name__ == "__main__":
+    main()
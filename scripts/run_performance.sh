@@ -1,8 +1,9 @@
 #!/usr/bin/env bash
 #
 # Executa a aplicação MPI com diferentes quantidades de processos para coletar
-# métricas de desempenho. A documentação foi escrita em português conforme o
-# pedido do projeto.
+# métricas de desempenho. Mantido por compatibilidade: delega a
+# scripts/benchmark.py, que repete as execuções e agrega os resultados em
+# bench/results.csv e bench/summary.json.
 set -euo pipefail
 
 if [[ $# -lt 2 ]]; then
@@ -13,14 +14,4 @@ fi
 data_file="$1"
 shift
 
-if [[ ! -f "$data_file" ]]; then
-  echo "Dataset não encontrado: $data_file" >&2
-  exit 1
-fi
-
-for np in "$@"; do
-  echo "== Executando com $np processos =="
-  mpirun -np "$np" ./bin/parallel_spotify "$data_file"
-  echo
-  sleep 1
-done
+exec "${PYTHON:-python3}" "$(dirname "$0")/benchmark.py" "$data_file" --processes "$@" --trials 1
@@ -1,39 +1,78 @@
 #!/usr/bin/env python3
 """Classifica o sentimento das letras do Spotify usando um LLM local via Ollama.
 
-O script lê o dataset, envia cada letra para o modelo configurado e registra o
-total de previsões "Positive", "Neutral" e "Negative". O modo ``--mock`` evita
-chamadas reais ao modelo e utiliza uma heurística simples baseada em palavras,
-útil para testes automatizados ou quando o servidor Ollama não está acessível.
+O script lê as letras, envia-as ao modelo configurado e registra o total de
+previsões "Positive", "Neutral" e "Negative". O modo ``--mock`` evita chamadas
+reais ao modelo e utiliza uma heurística simples baseada em palavras, útil para
+testes automatizados ou quando o servidor Ollama não está acessível.
+
+A classificação funciona como um pipeline:
+
+- as letras vêm do CSV ou, sem novo parsing, do cache colunar do executável
+  MPI (``--cache``, o arquivo ``<nome do csv>.pscache``) ou das colunas
+  separadas por ``--split-columns`` (``--columns``);
+- várias letras seguem em um mesmo prompt (``--batch-size``) e até
+  ``--concurrency`` lotes ficam em andamento ao mesmo tempo, cada um em uma
+  conexão HTTP persistente (keep-alive) de um pool assíncrono;
+- ``sentiment_cache.jsonl`` guarda o rótulo de cada letra, indexado pelo
+  SHA-256 do texto e pelo modelo, e novas execuções não reclassificam letras
+  já vistas (em ``--mock`` o cache fica só em memória);
+- com ``--prefilter``, o ``sentiment_scores.csv`` de ``parallel_spotify
+  --sentiment`` fornece o rótulo do léxico de cada música, e só as marcadas
+  como ambíguas vão ao modelo;
+- ``sentiment_details.csv`` é gravado na ordem do dataset à medida que os
+  lotes terminam; com ``--resume``, uma execução interrompida é retomada a
+  partir da última linha completa, desde que ``sentiment_details.run.json``
+  registre o mesmo dataset, modelo, ``--max-chars`` e uso de ``--prefilter``.
 
 Exemplo de uso::
 
     python scripts/sentiment_classifier.py spotify_millsongdata.csv \
-        --model llama3 --limit 100 --output-dir output
+        --model llama3 --limit 100 --output-dir output --cache cache
 """
 
 from __future__ import annotations
 
 import argparse
+import asyncio
 import csv
+import hashlib
 import json
 import os
+import re
+import ssl
+import struct
 import sys
 import time
 from dataclasses import dataclass
-from typing import Dict, Iterable, Tuple
-
-try:
-    import requests
-except ImportError as exc:  # pragma: no cover - optional dependency
-    requests = None  # type: ignore
+from itertools import islice
+from pathlib import Path
+from typing import Dict, Iterable, Iterator, List, Optional, Tuple
+from urllib.parse import urlsplit
 
 
 PROMPT_TEMPLATE = """You are an expert music analyst. Classify the overall sentiment of the following song lyrics as one of the following labels: Positive, Neutral, or Negative. Respond using only the label name with no explanations.\n\nLyrics:\n{lyrics}\n"""
 
+BATCH_PROMPT_TEMPLATE = """You are an expert music analyst. Classify the overall sentiment of each of the {count} song lyrics below as one of the following labels: Positive, Neutral, or Negative. Respond with exactly {count} lines in the form "<number>: <label>", one per song and in the same order, with no explanations.\n\n{songs}"""
+
 DEFAULT_MODEL = "llama3"
 OLLAMA_ENDPOINT = os.environ.get("OLLAMA_ENDPOINT", "http://localhost:11434")
 SUPPORTED_LABELS = ("Positive", "Neutral", "Negative")
+DETAIL_FIELDS = ["artist", "song", "label", "latency_seconds"]
+BATCH_ANSWER = re.compile(r"^\s*(?:song\s*)?(\d+)\s*[:.)\-]\s*\**\s*([A-Za-z]+)", re.IGNORECASE)
+
+# Cabeçalho do cache colunar (CacheHeader em src/parallel_spotify.c).
+CACHE_MAGIC = b"PSCACHE1"
+CACHE_VERSION = 1
+CACHE_HEADER = struct.Struct("=8sQQqQQQQQQ")
+CACHE_NO_ARTIST = 0xFFFFFFFF
+
+
+@dataclass
+class Song:
+    artist: str
+    song: str
+    lyrics: str
 
 
 @dataclass
@@ -42,80 +81,392 @@ class ClassificationResult:
     latency: float
 
 
+def mock_label(lyrics: str) -> str:
+    """Aplica uma heurística simples baseada em palavras positivas e negativas."""
+    lowered = lyrics.lower()
+    score = 0
+    positive_keywords = ("love", "happy", "joy", "sunshine", "smile")
+    negative_keywords = ("cry", "sad", "pain", "lonely", "tears")
+    for word in positive_keywords:
+        if word in lowered:
+            score += 1
+    for word in negative_keywords:
+        if word in lowered:
+            score -= 1
+    if score > 0:
+        return "Positive"
+    if score < 0:
+        return "Negative"
+    return "Neutral"
+
+
+def normalise_label(output: str) -> str:
+    """Normaliza a resposta do modelo garantindo que o rótulo seja suportado."""
+    words = output.split()
+    cleaned = words[0].strip(" .,:;*\"'").title() if words else ""
+    if cleaned not in SUPPORTED_LABELS:
+        return "Neutral"
+    return cleaned
+
+
+def parse_batch_answer(output: str, count: int) -> Optional[List[str]]:
+    """Extrai os rótulos numerados de uma resposta em lote, ou None se faltar algum."""
+    labels: Dict[int, str] = {}
+    for line in output.splitlines():
+        match = BATCH_ANSWER.match(line)
+        if match:
+            labels.setdefault(int(match.group(1)), normalise_label(match.group(2)))
+    if any(number not in labels for number in range(1, count + 1)):
+        return None
+    return [labels[number] for number in range(1, count + 1)]
+
+
+def lyric_hash(lyrics: str) -> str:
+    """Chave do cache de resultados: SHA-256 da letra sem espaços nas pontas."""
+    return hashlib.sha256(lyrics.strip().encode("utf-8")).hexdigest()
+
+
+class OllamaConnection:
+    """Conexão HTTP/1.1 persistente com o servidor, reaberta quando cai."""
+
+    def __init__(self, endpoint: str, timeout: float) -> None:
+        parts = urlsplit(endpoint)
+        self.secure = parts.scheme == "https"
+        self.host = parts.hostname or "localhost"
+        self.port = parts.port or (443 if self.secure else 80)
+        self.base_path = parts.path.rstrip("/")
+        self.timeout = timeout
+        self.reader: Optional[asyncio.StreamReader] = None
+        self.writer: Optional[asyncio.StreamWriter] = None
+
+    async def close(self) -> None:
+        if self.writer is not None:
+            self.writer.close()
+            try:
+                await self.writer.wait_closed()
+            except OSError:
+                pass
+        self.reader = self.writer = None
+
+    async def _exchange(self, path: str, body: bytes) -> Tuple[int, Dict[str, str], bytes]:
+        if self.writer is None:
+            self.reader, self.writer = await asyncio.open_connection(
+                self.host, self.port, ssl=ssl.create_default_context() if self.secure else None
+            )
+        assert self.reader is not None
+        request = (
+            f"POST {self.base_path}{path} HTTP/1.1\r\n"
+            f"Host: {self.host}:{self.port}\r\n"
+            "Content-Type: application/json\r\n"
+            f"Content-Length: {len(body)}\r\n"
+            "Connection: keep-alive\r\n\r\n"
+        ).encode("ascii")
+        self.writer.write(request + body)
+        await self.writer.drain()
+        status_line = await self.reader.readline()
+        if not status_line:
+            raise ConnectionError("connection closed by the server")
+        status = int(status_line.split()[1])
+        headers: Dict[str, str] = {}
+        while True:
+            line = await self.reader.readline()
+            if line in (b"\r\n", b"\n", b""):
+                break
+            name, _, value = line.decode("latin-1").partition(":")
+            headers[name.strip().lower()] = value.strip()
+        if headers.get("transfer-encoding", "").lower() == "chunked":
+            chunks = []
+            while True:
+                size = int((await self.reader.readline()).split(b";")[0], 16)
+                if size == 0:
+                    await self.reader.readline()
+                    break
+                chunks.append(await self.reader.readexactly(size))
+                await self.reader.readline()
+            payload = b"".join(chunks)
+        elif "content-length" in headers:
+            payload = await self.reader.readexactly(int(headers["content-length"]))
+        else:
+            payload = await self.reader.read()
+            headers["connection"] = "close"
+        if headers.get("connection", "").lower() == "close":
+            await self.close()
+        return status, headers, payload
+
+    async def post_json(self, path: str, payload: dict) -> dict:
+        """Envia ``payload`` e devolve a resposta JSON, com uma nova tentativa se a conexão caiu."""
+        body = json.dumps(payload).encode("utf-8")
+        for attempt in (1, 2):
+            try:
+                status, _, data = await asyncio.wait_for(self._exchange(path, body), self.timeout)
+                break
+            except (ConnectionError, asyncio.IncompleteReadError, OSError):
+                await self.close()
+                if attempt == 2:
+                    raise
+            except asyncio.TimeoutError:
+                await self.close()
+                raise
+        if status >= 400:
+            raise RuntimeError(f"Ollama returned HTTP {status}: {data[:200]!r}")
+        return json.loads(data)
+
+
 class SentimentClassifier:
     """Encapsula a lógica de classificação de sentimento (real ou simulada)."""
 
-    def __init__(self, model: str, mock: bool = False) -> None:
-        """Configura o classificador indicando o modelo e se deve operar em modo mock."""
+    def __init__(self, model: str, mock: bool = False, concurrency: int = 4, max_chars: int = 4000,
+                 timeout: float = 120.0) -> None:
+        """Configura o classificador e o pool de conexões persistentes."""
         self.model = model
         self.mock = mock
-        if not mock and requests is None:
-            raise RuntimeError(
-                "The 'requests' package is required for live classification. Install it or use --mock."
+        self.max_chars = max_chars
+        self.requests = 0
+        self.pool: asyncio.Queue[OllamaConnection] = asyncio.Queue()
+        if not mock:
+            for _ in range(concurrency):
+                self.pool.put_nowait(OllamaConnection(OLLAMA_ENDPOINT, timeout))
+
+    async def close(self) -> None:
+        while not self.pool.empty():
+            await self.pool.get_nowait().close()
+
+    async def _generate(self, prompt: str) -> str:
+        connection = await self.pool.get()
+        try:
+            self.requests += 1
+            data = await connection.post_json(
+                "/api/generate", {"model": self.model, "prompt": prompt, "stream": False}
             )
+        finally:
+            self.pool.put_nowait(connection)
+        return data.get("response", "").strip()
 
-    def classify(self, lyrics: str) -> ClassificationResult:
-        """Retorna a classe prevista para a letra fornecida."""
-        lyrics = lyrics.strip()
-        if not lyrics:
-            return ClassificationResult("Neutral", 0.0)
+    async def classify_batch(self, lyrics: List[str]) -> List[ClassificationResult]:
+        """Classifica um lote de letras não vazias em uma única requisição.
+
+        Se a resposta não trouxer um rótulo para cada letra, o lote é
+        reclassificado letra a letra. A latência da requisição é dividida
+        entre as músicas do lote.
+        """
         if self.mock:
-            return self._mock_classify(lyrics)
-        return self._ollama_classify(lyrics)
-
-    def _mock_classify(self, lyrics: str) -> ClassificationResult:
-        """Aplica uma heurística simples baseada em palavras positivas e negativas."""
-        lowered = lyrics.lower()
-        score = 0
-        positive_keywords = ("love", "happy", "joy", "sunshine", "smile")
-        negative_keywords = ("cry", "sad", "pain", "lonely", "tears")
-        for word in positive_keywords:
-            if word in lowered:
-                score += 1
-        for word in negative_keywords:
-            if word in lowered:
-                score -= 1
-        label = "Neutral"
-        if score > 0:
-            label = "Positive"
-        elif score < 0:
-            label = "Negative"
-        return ClassificationResult(label, 0.0)
-
-    def _ollama_classify(self, lyrics: str) -> ClassificationResult:
-        """Realiza a chamada HTTP ao servidor Ollama para obter a predição real."""
-        assert requests is not None  # for type checkers
-        payload = {
-            "model": self.model,
-            "prompt": PROMPT_TEMPLATE.format(lyrics=lyrics[:4000]),
-            "stream": False,
-        }
+            return [ClassificationResult(mock_label(text), 0.0) for text in lyrics]
         start = time.perf_counter()
-        response = requests.post(f"{OLLAMA_ENDPOINT}/api/generate", json=payload, timeout=120)
-        elapsed = time.perf_counter() - start
-        response.raise_for_status()
-        data = response.json()
-        raw_output = data.get("response", "").strip()
-        label = self._normalise_label(raw_output)
-        return ClassificationResult(label, elapsed)
+        trimmed = [text.strip()[:self.max_chars] for text in lyrics]
+        labels: Optional[List[str]] = None
+        if len(trimmed) == 1:
+            labels = [normalise_label(await self._generate(PROMPT_TEMPLATE.format(lyrics=trimmed[0])))]
+        else:
+            songs = "\n".join(f"Song {i}:\n{text}\n" for i, text in enumerate(trimmed, 1))
+            answer = await self._generate(BATCH_PROMPT_TEMPLATE.format(count=len(trimmed), songs=songs))
+            labels = parse_batch_answer(answer, len(trimmed))
+            if labels is None:
+                singles = await asyncio.gather(*(self.classify_batch([text]) for text in trimmed))
+                return [result[0] for result in singles]
+        latency = (time.perf_counter() - start) / len(trimmed)
+        return [ClassificationResult(label, latency) for label in labels]
+
+
+class ResultCache:
+    """Rótulos já calculados, por modelo e hash da letra, em um arquivo JSON Lines.
+
+    Sem ``path`` (modo ``--mock``), os rótulos ficam apenas em memória.
+    """
+
+    def __init__(self, path: Optional[Path], model: str) -> None:
+        self.path = path
+        self.model = model
+        self.labels: Dict[str, str] = {}
+        self.fh = None
+        if path is None:
+            return
+        if path.exists():
+            with path.open(encoding="utf-8") as fh:
+                for line in fh:
+                    try:
+                        entry = json.loads(line)
+                    except json.JSONDecodeError:
+                        continue  # última linha truncada por uma interrupção
+                    if entry.get("model") == model and entry.get("label") in SUPPORTED_LABELS:
+                        self.labels[entry["hash"]] = entry["label"]
+        self.fh = path.open("a", encoding="utf-8")
+
+    def get(self, key: str) -> Optional[str]:
+        return self.labels.get(key)
+
+    def put(self, key: str, label: str) -> None:
+        if key not in self.labels:
+            self.labels[key] = label
+            if self.fh is not None:
+                self.fh.write(json.dumps({"model": self.model, "hash": key, "label": label}) + "\n")
+
+    def flush(self) -> None:
+        if self.fh is not None:
+            self.fh.flush()
+
+    def close(self) -> None:
+        if self.fh is not None:
+            self.fh.close()
+
+
+class DetailWriter:
+    """Grava ``sentiment_details.csv`` na ordem do dataset, mesmo com lotes fora de ordem.
+
+    A identidade da execução (``run_identity``) fica em
+    ``sentiment_details.run.json``; só se retoma um arquivo gravado com a mesma.
+    """
+
+    def __init__(self, path: Path, identity: Dict[str, object], resume: bool) -> None:
+        self.counts: Dict[str, int] = {label: 0 for label in SUPPORTED_LABELS}
+        self.done = 0
+        identity_path = path.with_suffix(".run.json")
+        if resume and path.exists():
+            self._check_identity(path, identity_path, identity)
+            self._recover(path)
+            self.fh = path.open("a", newline="", encoding="utf-8")
+        else:
+            self.fh = path.open("w", newline="", encoding="utf-8")
+            csv.writer(self.fh).writerow(DETAIL_FIELDS)
+            with identity_path.open("w", encoding="utf-8") as fh:
+                json.dump(identity, fh, indent=2)
+        self.writer = csv.writer(self.fh)
+        self.next_record = self.done
+        self.pending: Dict[int, Tuple[Song, ClassificationResult]] = {}
 
     @staticmethod
-    def _normalise_label(output: str) -> str:
-        """Normaliza a resposta do modelo garantindo que o rótulo seja suportado."""
-        cleaned = output.split()[0].strip().title()
-        if cleaned not in SUPPORTED_LABELS:
-            return "Neutral"
-        return cleaned
-
-
-def iter_lyrics(path: str, limit: int | None = None) -> Iterable[Tuple[str, str, str]]:
-    """Itera sobre o CSV retornando artista, música e letra (até o limite opcional)."""
+    def _check_identity(path: Path, identity_path: Path, identity: Dict[str, object]) -> None:
+        """Recusa retomar resultados de outro dataset, modelo ou configuração."""
+        try:
+            with identity_path.open(encoding="utf-8") as fh:
+                stored = json.load(fh)
+        except (OSError, json.JSONDecodeError):
+            stored = None
+        if stored != identity:
+            raise SystemExit(f"Cannot resume {path}: {identity_path} does not match this run "
+                             f"(expected {json.dumps(identity)}); run without --resume to start over")
+
+    def _recover(self, path: Path) -> None:
+        """Descarta uma última linha incompleta e contabiliza as linhas já gravadas."""
+        data = path.read_bytes()
+        if data and not data.endswith(b"\n"):
+            with path.open("r+b") as fh:
+                fh.truncate(data.rfind(b"\n") + 1)
+        with path.open(newline="", encoding="utf-8") as fh:
+            reader = csv.reader(fh)
+            header = next(reader, None)
+            if header != DETAIL_FIELDS:
+                raise SystemExit(f"Cannot resume {path}: unexpected header {header}")
+            for row in reader:
+                if len(row) == len(DETAIL_FIELDS) and row[2] in self.counts:
+                    self.counts[row[2]] += 1
+                    self.done += 1
+
+    def add(self, record: int, song: Song, result: ClassificationResult) -> None:
+        self.pending[record] = (song, result)
+        while self.next_record in self.pending:
+            song, result = self.pending.pop(self.next_record)
+            self.writer.writerow([song.artist, song.song, result.label, f"{result.latency:.4f}"])
+            self.counts[result.label] += 1
+            self.next_record += 1
+
+    def flush(self) -> None:
+        self.fh.flush()
+
+    def close(self) -> None:
+        self.fh.close()
+
+
+def iter_csv(path: str) -> Iterator[Song]:
+    """Itera sobre o CSV retornando artista, música e letra."""
+    csv.field_size_limit(sys.maxsize)
     with open(path, newline="", encoding="utf-8") as csv_file:
-        reader = csv.DictReader(csv_file)
-        for index, row in enumerate(reader):
-            if limit is not None and index >= limit:
-                break
-            yield row.get("artist", ""), row.get("song", ""), row.get("text", "")
+        for row in csv.DictReader(csv_file):
+            yield Song(row.get("artist", ""), row.get("song", ""), row.get("text", ""))
+
+
+def iter_dataset_cache(path: Path) -> Iterator[Song]:
+    """Itera sobre o cache colunar do executável MPI, sem parsing de CSV."""
+    with path.open("rb") as fh:
+        view = memoryview(fh.read())
+    (magic, version, _size, _mtime, _hash, records, artists, artist_blob_size,
+     song_blob_size, lyrics_blob_size) = CACHE_HEADER.unpack_from(view)
+    if magic != CACHE_MAGIC or version != CACHE_VERSION:
+        raise SystemExit(f"Cache do dataset inválido: {path}")
+    offset = CACHE_HEADER.size
+
+    def section(length: int, fmt: str | None = None) -> memoryview:
+        nonlocal offset
+        data = view[offset:offset + length]
+        offset = (offset + length + 7) & ~7
+        return data.cast(fmt) if fmt else data
+
+    artist_offsets = section((artists + 1) * 8, "Q")
+    artist_blob = section(artist_blob_size)
+    record_artists = section(records * 4, "I")
+    song_offsets = section((records + 1) * 8, "Q")
+    song_blob = section(song_blob_size)
+    lyrics_offsets = section((records + 1) * 8, "Q")
+    lyrics_blob = section(lyrics_blob_size)
+
+    def text(offsets: memoryview, blob: memoryview, index: int) -> str:
+        return bytes(blob[offsets[index]:offsets[index + 1]]).decode("utf-8", "replace")
+
+    names = [text(artist_offsets, artist_blob, i) for i in range(artists)]
+    for record in range(records):
+        artist_id = record_artists[record]
+        yield Song(names[artist_id] if artist_id != CACHE_NO_ARTIST and artist_id < artists else "",
+                   text(song_offsets, song_blob, record), text(lyrics_offsets, lyrics_blob, record))
+
+
+def iter_split_columns(directory: Path) -> Iterator[Song]:
+    """Itera sobre as colunas separadas por --split-columns; elas não guardam os títulos."""
+    csv.field_size_limit(sys.maxsize)
+    with (directory / "artist.csv").open(newline="", encoding="utf-8") as artist_fh, \
+            (directory / "text.csv").open(newline="", encoding="utf-8") as text_fh:
+        artists = csv.reader(artist_fh)
+        texts = csv.reader(text_fh)
+        next(artists, None)
+        next(texts, None)
+        for artist_row, text_row in zip(artists, texts):
+            yield Song(artist_row[0] if artist_row else "", "", text_row[0] if text_row else "")
+
+
+def open_source(args: argparse.Namespace) -> Iterator[Song]:
+    """Escolhe a fonte das letras: cache colunar, colunas separadas ou o próprio CSV."""
+    if args.columns:
+        return iter_split_columns(Path(args.columns))
+    if args.cache:
+        cache_path = Path(args.cache) / f"{Path(args.dataset).name}.pscache"
+        if cache_path.is_file():
+            with cache_path.open("rb") as fh:
+                header = CACHE_HEADER.unpack_from(fh.read(CACHE_HEADER.size))
+            stat = os.stat(args.dataset) if os.path.exists(args.dataset) else None
+            if stat is None or (header[2] == stat.st_size and header[3] == int(stat.st_mtime)):
+                return iter_dataset_cache(cache_path)
+            print(f"Cache {cache_path} is stale, reading the CSV instead", file=sys.stderr)
+        else:
+            print(f"Cache {cache_path} not found, reading the CSV instead", file=sys.stderr)
+    return iter_csv(args.dataset)
+
+
+def iter_prefilter(path: Path) -> Iterator[Tuple[str, str, bool]]:
+    """Itera sobre ``sentiment_scores.csv`` retornando artista, rótulo e se a música é ambígua."""
+    with path.open(newline="", encoding="utf-8") as fh:
+        reader = csv.DictReader(fh)
+        for row in reader:
+            yield row["artist"], row["label"], row["ambiguous"] == "1"
+
+
+def run_identity(args: argparse.Namespace) -> Dict[str, object]:
+    """Dataset, modelo e opções que determinam os rótulos de ``sentiment_details.csv``."""
+    stat = os.stat(args.dataset) if os.path.exists(args.dataset) else None
+    return {
+        "dataset_size": stat.st_size if stat else None,
+        "dataset_mtime": int(stat.st_mtime) if stat else None,
+        "model": "mock" if args.mock else args.model,
+        "max_chars": args.max_chars,
+        "prefilter": bool(args.prefilter),
+    }
 
 
 def ensure_output_dir(path: str) -> None:
@@ -123,6 +474,77 @@ def ensure_output_dir(path: str) -> None:
     os.makedirs(path, exist_ok=True)
 
 
+async def classify_dataset(args: argparse.Namespace, details: DetailWriter, cache: ResultCache) -> Dict[str, int]:
+    """Percorre as letras montando lotes e mantém até ``--concurrency`` deles em andamento."""
+    classifier = SentimentClassifier(args.model, mock=args.mock, concurrency=args.concurrency,
+                                     max_chars=args.max_chars, timeout=args.timeout)
+    slots = asyncio.Semaphore(args.concurrency)
+    tasks: set[asyncio.Task] = set()
+    stats = {"cached": 0, "classified": 0, "prefiltered": 0}
+    batch: List[Tuple[int, Song, str]] = []
+
+    async def run_batch(items: List[Tuple[int, Song, str]]) -> None:
+        try:
+            results = await classifier.classify_batch([song.lyrics for _, song, _ in items])
+            for (record, song, key), result in zip(items, results):
+                cache.put(key, result.label)
+                details.add(record, song, result)
+            stats["classified"] += len(items)
+            details.flush()
+            cache.flush()
+        finally:
+            slots.release()
+
+    async def submit() -> None:
+        nonlocal batch
+        await slots.acquire()
+        task = asyncio.create_task(run_batch(batch))
+        tasks.add(task)
+        task.add_done_callback(tasks.discard)
+        batch = []
+
+    stop = args.limit if args.limit is not None else None
+    records = islice(enumerate(open_source(args)), details.done, stop)
+    # As linhas do pré-filtro seguem a ordem do dataset, uma por registro.
+    prefilter = islice(iter_prefilter(Path(args.prefilter)), details.done, None) if args.prefilter else None
+    try:
+        for record, song in records:
+            if record > 0 and record % args.progress_every == 0:
+                print(f"  {record} songs scheduled ({stats['classified']} classified, "
+                      f"{stats['cached']} from cache)", file=sys.stderr, flush=True)
+            if prefilter is not None:
+                artist, label, ambiguous = next(prefilter, (None, "", True))
+                if artist != song.artist or label not in SUPPORTED_LABELS:
+                    raise SystemExit(f"{args.prefilter} does not match the dataset at record {record}")
+                if not ambiguous:
+                    stats["prefiltered"] += 1
+                    details.add(record, song, ClassificationResult(label, 0.0))
+                    continue
+            if not song.lyrics.strip():
+                details.add(record, song, ClassificationResult("Neutral", 0.0))
+                continue
+            key = lyric_hash(song.lyrics)
+            label = cache.get(key)
+            if label is not None:
+                stats["cached"] += 1
+                details.add(record, song, ClassificationResult(label, 0.0))
+                continue
+            batch.append((record, song, key))
+            if len(batch) >= args.batch_size:
+                await submit()
+        if batch:
+            await submit()
+        if tasks:
+            await asyncio.gather(*tasks)
+    finally:
+        for task in tasks:
+            task.cancel()
+        await classifier.close()
+        details.flush()
+    stats["requests"] = classifier.requests
+    return stats
+
+
 def main(argv: Iterable[str] | None = None) -> int:
     """Ponto de entrada do script para classificação de sentimentos."""
     parser = argparse.ArgumentParser(
@@ -133,39 +555,49 @@ def main(argv: Iterable[str] | None = None) -> int:
     parser.add_argument("--limit", type=int, default=None, help="Limit the number of songs to classify")
     parser.add_argument("--output-dir", default="output", help="Directory where results are stored")
     parser.add_argument("--mock", action="store_true", help="Use a simple keyword heuristic instead of calling the LLM")
+    parser.add_argument("--cache", metavar="DIR", help="Read lyrics from the MPI job's dataset cache directory (--cache)")
+    parser.add_argument("--columns", metavar="DIR", help="Read lyrics from the split_columns directory (--split-columns)")
+    parser.add_argument("--prefilter", metavar="CSV",
+                        help="sentiment_scores.csv from parallel_spotify --sentiment; only ambiguous songs reach the model")
+    parser.add_argument("--batch-size", type=int, default=4, help="Lyrics sent per prompt (default: 4)")
+    parser.add_argument("--concurrency", type=int, default=4, help="Requests in flight at once (default: 4)")
+    parser.add_argument("--max-chars", type=int, default=4000, help="Characters kept from each lyric (default: 4000)")
+    parser.add_argument("--timeout", type=float, default=120.0, help="Timeout per request in seconds (default: 120)")
+    parser.add_argument("--resume", action="store_true",
+                        help="Continue an interrupted run from the last complete line of sentiment_details.csv")
+    parser.add_argument("--progress-every", type=int, default=10000, help=argparse.SUPPRESS)
     args = parser.parse_args(list(argv) if argv is not None else None)
+    if args.batch_size < 1 or args.concurrency < 1 or args.max_chars < 1 or args.progress_every < 1:
+        parser.error("--batch-size, --concurrency and --max-chars must be positive")
 
     ensure_output_dir(args.output_dir)
+    output_dir = Path(args.output_dir)
+    detailed_path = output_dir / "sentiment_details.csv"
+    aggregated_path = output_dir / "sentiment_totals.json"
+
+    details = DetailWriter(detailed_path, run_identity(args), resume=args.resume)
+    if args.limit is not None and details.done > args.limit:
+        details.close()
+        raise SystemExit(f"Cannot resume {detailed_path}: it already has {details.done} songs, more than "
+                         f"--limit {args.limit}")
+    cache = ResultCache(None if args.mock else output_dir / "sentiment_cache.jsonl", args.model)
+    resumed = details.done
+    started = time.perf_counter()
+    try:
+        stats = asyncio.run(classify_dataset(args, details, cache))
+    finally:
+        details.close()
+        cache.close()
+    elapsed = time.perf_counter() - started
 
-    classifier = SentimentClassifier(args.model, mock=args.mock)
-    counts: Dict[str, int] = {label: 0 for label in SUPPORTED_LABELS}
-    per_song_rows = []
-
-    for artist, song, lyrics in iter_lyrics(args.dataset, args.limit):
-        result = classifier.classify(lyrics)
-        counts[result.label] += 1
-        per_song_rows.append(
-            {
-                "artist": artist,
-                "song": song,
-                "label": result.label,
-                "latency_seconds": f"{result.latency:.4f}",
-            }
-        )
-
-    aggregated_path = os.path.join(args.output_dir, "sentiment_totals.json")
     with open(aggregated_path, "w", encoding="utf-8") as fp:
-        json.dump(counts, fp, indent=2)
-
-    detailed_path = os.path.join(args.output_dir, "sentiment_details.csv")
-    with open(detailed_path, "w", newline="", encoding="utf-8") as fp:
-        writer = csv.DictWriter(fp, fieldnames=["artist", "song", "label", "latency_seconds"])
-        writer.writeheader()
-        writer.writerows(per_song_rows)
+        json.dump(details.counts, fp, indent=2)
 
     print("Sentiment summary:")
     for label in SUPPORTED_LABELS:
-        print(f"  {label}: {counts[label]}")
+        print(f"  {label}: {details.counts[label]}")
+    print(f"Resumed {resumed} songs, {stats['prefiltered']} labelled by the lexicon, {stats['cached']} from cache, "
+          f"{stats['classified']} classified with {stats['requests']} requests in {elapsed:.1f}s")
     print(f"Detailed results -> {detailed_path}")
     print(f"Aggregated counts -> {aggregated_path}")
 
@@ -10,7 +10,14 @@ threads para acelerar a contagem antes de registrar dois arquivos CSV:
 
 O processamento ocorre de forma independente do executável MPI para não
 interferir na coleta de métricas paralelas. Use quando precisar de uma visão
-serial e detalhada das letras.
+serial e detalhada das letras. As opções ``--min-length``, ``--stopwords`` e
+``--apostrophes`` seguem a mesma política de tokenização do executável
+(equivalente a ``parallel_spotify --utf8``).
+
+Com ``--index``, as contagens vêm do índice de tokens gerado por
+``parallel_spotify --index``: cada música já é uma sequência de ids inteiros,
+e a contagem se reduz a histogramas sobre o arquivo carregado, sem reler nem
+tokenizar o CSV. A política de tokenização é a usada na geração do índice.
 """
 
 from __future__ import annotations
@@ -19,23 +26,52 @@ import argparse
 import csv
 import os
 import re
+import struct
 from collections import Counter
 from concurrent.futures import ThreadPoolExecutor
 from pathlib import Path
 from typing import Iterable
 
 TOKEN_REGEX = re.compile(r"[0-9A-Za-zÀ-ÖØ-öø-ÿ']+", re.UNICODE)
+TOKEN_REGEX_SPLIT = re.compile(r"[0-9A-Za-zÀ-ÖØ-öø-ÿ]+", re.UNICODE)
+DEFAULT_STOPWORDS = Path(__file__).resolve().parent.parent / "src" / "stopwords_default.txt"
+
+# Cabeçalho do índice de tokens (IndexHeader em src/parallel_spotify.c).
+INDEX_MAGIC = b"PSINDEX1"
+INDEX_VERSION = 1
+INDEX_HEADER = struct.Struct("=8sQQqQQQQQQQQQ")
+
+# Política de tokenização, ajustada em main() a partir da linha de comando.
+token_regex = TOKEN_REGEX
+min_length = 3
+stopwords: frozenset[str] = frozenset()
+
+
+def load_stopwords(source: str | None) -> frozenset[str]:
+    """Carrega a lista de stop words (``default``, ``none`` ou caminho de arquivo)."""
+    if not source or source == "none":
+        return frozenset()
+    path = DEFAULT_STOPWORDS if source == "default" else Path(source)
+    words = set()
+    with open(path, "r", encoding="utf-8") as fh:
+        for line in fh:
+            word = line.strip().lower()
+            if word and not word.startswith("#"):
+                words.add(word)
+    return frozenset(words)
 
 
 def tokenize(text: str) -> Iterable[str]:
-    """Gera tokens com pelo menos 3 caracteres, preservando apóstrofos."""
-    for match in TOKEN_REGEX.finditer(text):
+    """Gera tokens com o comprimento mínimo configurado, preservando apóstrofos."""
+    for match in token_regex.finditer(text):
         token = match.group().lower()
-        if len(token) < 3:
+        if len(token) < min_length:
             continue
         # Evita registrar strings compostas apenas por apóstrofos
         if not any(ch.isalnum() for ch in token):
             continue
+        if token in stopwords:
+            continue
         yield token
 
 
@@ -53,7 +89,16 @@ def parse_args() -> argparse.Namespace:
     parser = argparse.ArgumentParser(
         description="Conta palavras globalmente e por música de forma independente do MPI.",
     )
-    parser.add_argument("csv_path", help="Caminho para o arquivo spotify_millsongdata.csv")
+    parser.add_argument(
+        "csv_path",
+        nargs="?",
+        help="Caminho para o arquivo spotify_millsongdata.csv (dispensável com --index)",
+    )
+    parser.add_argument(
+        "--index",
+        default=None,
+        help="Índice de tokens (.psindex) gerado por parallel_spotify --index",
+    )
     parser.add_argument(
         "--output-dir",
         default="output/serial_word_counts",
@@ -69,6 +114,23 @@ def parse_args() -> argparse.Namespace:
         default=None,
         help="Delimitador do CSV (detectado automaticamente se omitido)",
     )
+    parser.add_argument(
+        "--min-length",
+        type=int,
+        default=3,
+        help="Comprimento mínimo dos tokens, em caracteres (padrão: 3)",
+    )
+    parser.add_argument(
+        "--stopwords",
+        default=None,
+        help="Stop words a descartar: none (padrão), default ou caminho de arquivo",
+    )
+    parser.add_argument(
+        "--apostrophes",
+        choices=("keep", "split"),
+        default="keep",
+        help="Mantém o apóstrofo nas palavras (keep) ou o trata como separador (split)",
+    )
     parser.add_argument(
         "--workers",
         type=int,
@@ -99,17 +161,107 @@ def process_row(row: dict[str, str]) -> tuple[str, str, Counter[str]] | None:
     return artist, song, word_counter
 
 
+def count_from_index(index_path: Path, global_path: Path, per_song_path: Path) -> int:
+    """Gera os dois CSVs a partir do índice de tokens e retorna o número de músicas.
+
+    Os ids do vocabulário seguem a ordem de primeira ocorrência no dataset,
+    então ordenar por (-contagem, id) reproduz a ordem de ``most_common`` do
+    caminho que lê o CSV.
+    """
+    view = memoryview(index_path.read_bytes())
+    (magic, version, _size, _mtime, _hash, _policy, records, artists, artist_blob_size,
+     song_blob_size, vocab, vocab_blob_size, token_count) = INDEX_HEADER.unpack_from(view)
+    if magic != INDEX_MAGIC or version != INDEX_VERSION:
+        raise SystemExit(f"Índice de tokens inválido: {index_path}")
+
+    offset = INDEX_HEADER.size
+
+    def section(length: int, fmt: str | None = None) -> memoryview:
+        nonlocal offset
+        data = view[offset:offset + length]
+        offset = (offset + length + 7) & ~7
+        return data.cast(fmt) if fmt else data
+
+    artist_offsets = section((artists + 1) * 8, "Q")
+    artist_blob = section(artist_blob_size)
+    record_artists = section(records * 4, "I")
+    song_offsets = section((records + 1) * 8, "Q")
+    song_blob = section(song_blob_size)
+    vocab_offsets = section((vocab + 1) * 8, "Q")
+    vocab_blob = section(vocab_blob_size)
+    token_offsets = section((records + 1) * 8, "Q")
+    tokens = section(token_count * 4, "I")
+
+    def strings(offsets: memoryview, blob: memoryview, count: int) -> list[str]:
+        return [
+            bytes(blob[offsets[i]:offsets[i + 1]]).decode("utf-8", "replace")
+            for i in range(count)
+        ]
+
+    words = strings(vocab_offsets, vocab_blob, vocab)
+    artist_names = strings(artist_offsets, artist_blob, artists)
+    global_counts = [0] * vocab
+
+    with open(per_song_path, "w", encoding="utf-8", newline="") as per_song_fh:
+        per_song_writer = csv.writer(per_song_fh)
+        per_song_writer.writerow(["artist", "song", "word", "count"])
+        for record in range(records):
+            song_counter: Counter[int] = Counter(
+                tokens[token_offsets[record]:token_offsets[record + 1]]
+            )
+            if not song_counter:
+                continue
+            artist_id = record_artists[record]
+            artist = artist_names[artist_id] if artist_id < artists else ""
+            song = bytes(
+                song_blob[song_offsets[record]:song_offsets[record + 1]]
+            ).decode("utf-8", "replace")
+            for word_id, count in song_counter.items():
+                global_counts[word_id] += count
+                per_song_writer.writerow([artist, song, words[word_id], count])
+
+    with open(global_path, "w", encoding="utf-8", newline="") as global_fh:
+        writer = csv.writer(global_fh)
+        writer.writerow(["word", "count"])
+        for word_id in sorted(range(vocab), key=lambda i: (-global_counts[i], i)):
+            if global_counts[word_id] > 0:
+                writer.writerow([words[word_id], global_counts[word_id]])
+    return records
+
+
 def main() -> None:
+    global token_regex, min_length, stopwords
     args = parse_args()
-    csv_path = Path(args.csv_path)
-    if not csv_path.exists():
-        raise SystemExit(f"Arquivo não encontrado: {csv_path}")
+    token_regex = TOKEN_REGEX if args.apostrophes == "keep" else TOKEN_REGEX_SPLIT
+    min_length = max(1, args.min_length)
+    stopwords = load_stopwords(args.stopwords)
 
     output_dir = Path(args.output_dir)
     output_dir.mkdir(parents=True, exist_ok=True)
     global_path = output_dir / "word_counts_global.csv"
     per_song_path = output_dir / "word_counts_by_song.csv"
 
+    if args.index:
+        index_path = Path(args.index)
+        if not index_path.exists():
+            raise SystemExit(f"Arquivo não encontrado: {index_path}")
+        total_rows = count_from_index(index_path, global_path, per_song_path)
+        print(
+            "Concluído. Processadas",
+            total_rows,
+            "músicas do índice. Arquivos gerados em",
+            os.fspath(output_dir),
+        )
+        print(" -", os.fspath(global_path))
+        print(" -", os.fspath(per_song_path))
+        return
+
+    if not args.csv_path:
+        raise SystemExit("Informe o CSV de entrada ou --index.")
+    csv_path = Path(args.csv_path)
+    if not csv_path.exists():
+        raise SystemExit(f"Arquivo não encontrado: {csv_path}")
+
     with open(csv_path, "r", encoding=args.encoding, newline="") as fh:
         sample = fh.read(65536)
         fh.seek(0)
@@ -0,0 +1,248 @@
+/*
+ * Microbenchmarks dos núcleos de parallel_spotify.c sobre entradas fixas,
+ * sem MPI: hash_bytes, ht_put_len, process_lyrics (com a política padrão e
+ * com --utf8) e read_csv_record. As entradas são geradas por um gerador
+ * congruencial com semente fixa, de modo que execuções diferentes medem
+ * exatamente o mesmo trabalho e regressões nos núcleos aparecem sem o ruído
+ * do escalonamento entre processos.
+ *
+ * Uso: microbench [--repeat N] [--json arquivo]
+ */
+#define PARALLEL_SPOTIFY_NO_MAIN
+#pragma GCC diagnostic ignored "-Wunused-function"
+#include "parallel_spotify.c"
+
+#define BENCH_VOCABULARY 20000
+#define BENCH_WORDS 1000000
+#define BENCH_RECORDS 20000
+#define BENCH_REPEAT 5
+
+/* Gerador congruencial de 64 bits; a mesma semente gera sempre a mesma entrada. */
+static uint64_t bench_state = 0x9E3779B97F4A7C15ULL;
+
+static uint32_t bench_random(void) {
+    bench_state = bench_state * 6364136223846793005ULL + 1442695040888963407ULL;
+    return (uint32_t)(bench_state >> 33);
+}
+
+/* Entradas compartilhadas pelos microbenchmarks. */
+typedef struct {
+    char *vocabulary;
+    size_t *word_offsets;
+    StringView *words;
+    ByteBuffer lyrics;
+    FILE *csv;
+    long long csv_bytes;
+} BenchInput;
+
+/* Resultado de um microbenchmark: melhor e mediana das repetições. */
+typedef struct {
+    const char *name;
+    double best_seconds;
+    double median_seconds;
+    double operations;
+    const char *unit;
+} BenchResult;
+
+static int double_compare(const void *a, const void *b) {
+    double da = *(const double *)a;
+    double db = *(const double *)b;
+    return (da > db) - (da < db);
+}
+
+/* Palavras de 2 a 10 letras; algumas começam em maiúscula ou têm apóstrofo. */
+static void bench_input_init(BenchInput *input) {
+    input->vocabulary = (char *)malloc((size_t)BENCH_VOCABULARY * 12U);
+    input->word_offsets = (size_t *)malloc(((size_t)BENCH_VOCABULARY + 1U) * sizeof(size_t));
+    input->words = (StringView *)malloc((size_t)BENCH_WORDS * sizeof(StringView));
+    if (!input->vocabulary || !input->word_offsets || !input->words) {
+        fprintf(stderr, "Failed to allocate benchmark input\n");
+        exit(EXIT_FAILURE);
+    }
+    size_t cursor = 0;
+    for (size_t w = 0; w < BENCH_VOCABULARY; ++w) {
+        input->word_offsets[w] = cursor;
+        size_t length = 2U + bench_random() % 9U;
+        for (size_t c = 0; c < length; ++c) {
+            input->vocabulary[cursor++] = (char)('a' + bench_random() % 26U);
+        }
+        if (length > 4 && bench_random() % 16U == 0) {
+            input->vocabulary[cursor - 2] = '\'';
+        }
+    }
+    input->word_offsets[BENCH_VOCABULARY] = cursor;
+
+    /* O texto segue uma distribuição enviesada para as primeiras palavras,
+     * como em letras reais, com quebras de linha e pontuação. */
+    memset(&input->lyrics, 0, sizeof(input->lyrics));
+    for (size_t i = 0; i < BENCH_WORDS; ++i) {
+        uint32_t r = bench_random();
+        size_t w = (r % 4U == 0) ? r % BENCH_VOCABULARY : (r >> 8) % 256U;
+        size_t length = input->word_offsets[w + 1] - input->word_offsets[w];
+        input->words[i].data = input->vocabulary + input->word_offsets[w];
+        input->words[i].length = length;
+        size_t start = input->lyrics.size;
+        byte_buffer_append(&input->lyrics, input->words[i].data, length);
+        if (r % 7U == 0) {
+            input->lyrics.data[start] = (char)toupper((unsigned char)input->lyrics.data[start]);
+        }
+        const char *separator = (r % 11U == 0) ? ",\n" : (r % 5U == 0 ? "  " : " ");
+        byte_buffer_append(&input->lyrics, separator, strlen(separator));
+    }
+
+    input->csv = tmpfile();
+    if (!input->csv) {
+        fprintf(stderr, "Failed to create temporary CSV: %s\n", strerror(errno));
+        exit(EXIT_FAILURE);
+    }
+    fputs("artist,song,link,text\n", input->csv);
+    size_t lyrics_cursor = 0;
+    size_t chunk = input->lyrics.size / BENCH_RECORDS;
+    for (size_t r = 0; r < BENCH_RECORDS; ++r) {
+        const StringView *artist = &input->words[r % 512U];
+        fprintf(input->csv, "%.*s,\"Song %zu, \"\"live\"\"\",/%zu,\"", (int)artist->length, artist->data, r, r);
+        fwrite(input->lyrics.data + lyrics_cursor, 1U, chunk, input->csv);
+        lyrics_cursor += chunk;
+        fputs("\"\n", input->csv);
+    }
+    fflush(input->csv);
+    input->csv_bytes = ftello(input->csv);
+}
+
+static void bench_input_free(BenchInput *input) {
+    fclose(input->csv);
+    free(input->lyrics.data);
+    free(input->words);
+    free(input->word_offsets);
+    free(input->vocabulary);
+}
+
+static volatile uint64_t bench_sink;
+
+static double run_hash_bytes(const BenchInput *input) {
+    double started = phase_clock();
+    uint64_t combined = 0;
+    for (size_t i = 0; i < BENCH_WORDS; ++i) {
+        combined ^= hash_bytes(input->words[i].data, input->words[i].length);
+    }
+    bench_sink = combined;
+    return phase_clock() - started;
+}
+
+static double run_ht_put(const BenchInput *input) {
+    HashTable table;
+    ht_init(&table, 1024);
+    double started = phase_clock();
+    for (size_t i = 0; i < BENCH_WORDS; ++i) {
+        ht_put_len(&table, input->words[i].data, input->words[i].length, 1);
+    }
+    double elapsed = phase_clock() - started;
+    bench_sink = table.size;
+    ht_free(&table);
+    return elapsed;
+}
+
+static double run_process_lyrics(const BenchInput *input) {
+    HashTable table;
+    ht_init(&table, 65536);
+    CountType total = 0;
+    double started = phase_clock();
+    process_lyrics(&table, input->lyrics.data, input->lyrics.size, &total);
+    double elapsed = phase_clock() - started;
+    bench_sink = (uint64_t)total;
+    ht_free(&table);
+    return elapsed;
+}
+
+static double run_read_csv_record(const BenchInput *input) {
+    char *line = NULL;
+    size_t capacity = 0;
+    uint64_t records = 0;
+    rewind(input->csv);
+    double started = phase_clock();
+    while (read_csv_record(input->csv, &line, &capacity) > 0) {
+        records++;
+    }
+    double elapsed = phase_clock() - started;
+    bench_sink = records;
+    free(line);
+    return elapsed;
+}
+
+static BenchResult measure(const char *name, double (*run)(const BenchInput *), const BenchInput *input,
+                           int repeat, double operations, const char *unit) {
+    double *samples = (double *)malloc((size_t)repeat * sizeof(double));
+    if (!samples) {
+        fprintf(stderr, "Failed to allocate benchmark samples\n");
+        exit(EXIT_FAILURE);
+    }
+    run(input);
+    for (int r = 0; r < repeat; ++r) {
+        samples[r] = run(input);
+    }
+    qsort(samples, (size_t)repeat, sizeof(double), double_compare);
+    BenchResult result = {name, samples[0], samples[repeat / 2], operations, unit};
+    free(samples);
+    return result;
+}
+
+int main(int argc, char **argv) {
+    int repeat = BENCH_REPEAT;
+    const char *json_path = NULL;
+    for (int i = 1; i < argc; ++i) {
+        const char *value = NULL;
+        if ((value = option_value(argc, argv, &i, "--repeat")) != NULL) {
+            repeat = atoi(value) > 0 ? atoi(value) : 1;
+        } else if ((value = option_value(argc, argv, &i, "--json")) != NULL) {
+            json_path = value;
+        } else {
+            fprintf(stderr, "Usage: %s [--repeat N] [--json FILE]\n", argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    BenchInput input;
+    bench_input_init(&input);
+    TokenPolicy policy = {3, APOSTROPHE_KEEP, 0, NULL};
+    const char *kernel = tokenizer_init(&policy);
+
+    BenchResult results[5];
+    size_t count = 0;
+    results[count++] = measure("hash_bytes", run_hash_bytes, &input, repeat, BENCH_WORDS, "keys");
+    results[count++] = measure("ht_put", run_ht_put, &input, repeat, BENCH_WORDS, "keys");
+    results[count++] = measure("process_lyrics", run_process_lyrics, &input, repeat, (double)input.lyrics.size,
+                               "bytes");
+    policy.utf8_letters = 1;
+    tokenizer_init(&policy);
+    results[count++] = measure("process_lyrics_utf8", run_process_lyrics, &input, repeat,
+                               (double)input.lyrics.size, "bytes");
+    results[count++] = measure("read_csv_record", run_read_csv_record, &input, repeat, (double)input.csv_bytes,
+                               "bytes");
+
+    printf("%-20s %12s %12s %16s\n", "benchmark", "best_ms", "median_ms", "ns_per_unit");
+    for (size_t i = 0; i < count; ++i) {
+        printf("%-20s %12.3f %12.3f %12.3f/%s\n", results[i].name, results[i].best_seconds * 1e3,
+               results[i].median_seconds * 1e3, results[i].best_seconds * 1e9 / results[i].operations,
+               results[i].unit);
+    }
+    if (json_path) {
+        FILE *fp = fopen(json_path, "w");
+        if (!fp) {
+            fprintf(stderr, "Failed to write %s: %s\n", json_path, strerror(errno));
+            bench_input_free(&input);
+            return EXIT_FAILURE;
+        }
+        fprintf(fp, "{\n  \"tokenizer_kernel\": \"%s\",\n  \"repeat\": %d,\n  \"benchmarks\": [\n", kernel, repeat);
+        for (size_t i = 0; i < count; ++i) {
+            fprintf(fp, "    {\"name\": \"%s\", \"best_seconds\": %.9f, \"median_seconds\": %.9f, "
+                        "\"units\": %.0f, \"unit\": \"%s\", \"ns_per_unit\": %.4f}%s\n",
+                    results[i].name, results[i].best_seconds, results[i].median_seconds, results[i].operations,
+                    results[i].unit, results[i].best_seconds * 1e9 / results[i].operations,
+                    i + 1 < count ? "," : "");
+        }
+        fprintf(fp, "  ]\n}\n");
+        fclose(fp);
+    }
+    bench_input_free(&input);
+    return EXIT_SUCCESS;
+}
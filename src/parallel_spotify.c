@@ -20,36 +20,216 @@
 #include <string.h>
 #include <sys/stat.h>
 #include <limits.h>
+#include <math.h>
+#include <time.h>
 
 #ifdef _WIN32
 #include <direct.h>
 #define MKDIR(path) _mkdir(path)
 #else
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/mman.h>
 #include <unistd.h>
 #define MKDIR(path) mkdir(path, 0777)
+#define HAVE_MMAP 1
+#define HAVE_PTHREADS 1
 #endif
 
 #define DEFAULT_WORD_LIMIT 0
 #define DEFAULT_ARTIST_LIMIT 0
+#define PREVIEW_ITEMS 10
 
 typedef long long CountType;
 
-/* Estrutura chave-valor usada para armazenar entradas de tabelas de hash. */
+/*
+ * Estrutura chave-valor usada para armazenar entradas de tabelas de hash. O
+ * hash e o comprimento da chave ficam guardados no próprio registro: uma
+ * sondagem só lê os bytes da chave quando ambos coincidem, e o
+ * redimensionamento nunca precisa recalcular o hash.
+ */
 typedef struct {
     char *key;
     CountType value;
+    uint64_t hash;
+    size_t length;
 } Entry;
 
+/* Bloco de memória de uma arena; os bytes ficam logo após o cabeçalho. */
+typedef struct ArenaBlock {
+    struct ArenaBlock *next;
+    size_t used;
+    size_t capacity;
+    char data[];
+} ArenaBlock;
+
+/*
+ * Alocador sequencial (bump allocator) para as chaves das tabelas: as cópias
+ * são empilhadas em blocos grandes e liberadas de uma só vez, em vez de um
+ * malloc/free por chave.
+ */
+typedef struct {
+    ArenaBlock *head;
+    size_t reserved_bytes;
+} KeyArena;
+
+#define ARENA_BLOCK_SIZE ((size_t)64 * 1024)
+
 /*
  * Implementação simples de tabela de hash com endereçamento aberto, usada
- * tanto para a contagem de palavras quanto para a contagem de artistas.
+ * tanto para a contagem de palavras quanto para a contagem de artistas. As
+ * chaves pertencem à arena da própria tabela. `probes` e `resizes` contam as
+ * posições visitadas nas inserções e os redimensionamentos, somados às
+ * métricas quando a tabela é liberada.
  */
 typedef struct {
     Entry *entries;
     size_t capacity;
     size_t size;
+    size_t grow_threshold;
+    KeyArena keys;
+    uint64_t probes;
+    uint64_t resizes;
 } HashTable;
 
+/* Fator de carga máximo (70%) expresso como fração inteira da capacidade. */
+#define HT_LOAD_NUMERATOR 7U
+#define HT_LOAD_DENOMINATOR 10U
+
+/*
+ * Buffer de bytes crescente usado para montar as colunas do cache e do índice
+ * e as linhas das saídas detalhadas.
+ */
+typedef struct {
+    char *data;
+    size_t size;
+    size_t capacity;
+} ByteBuffer;
+
+/* Fases cronometradas em performance_metrics.json, na ordem de phase_names. */
+typedef enum {
+    PHASE_PREPARE,
+    PHASE_READ,
+    PHASE_TOKENIZE,
+    PHASE_ARTISTS,
+    PHASE_MERGE,
+    PHASE_SERIALIZE,
+    PHASE_COMMUNICATE,
+    PHASE_SORT,
+    PHASE_WRITE,
+    PHASE_COUNT
+} Phase;
+
+static const char *const phase_names[PHASE_COUNT] = {
+    "prepare", "read", "tokenize", "artists", "merge", "serialize", "communicate", "sort", "write",
+};
+
+/* Contadores do caminho crítico, na ordem de counter_names. */
+typedef enum {
+    COUNTER_BYTES_READ,
+    COUNTER_RECORDS,
+    COUNTER_TOKENS,
+    COUNTER_HASH_PROBES,
+    COUNTER_HASH_RESIZES,
+    COUNTER_MESSAGES,
+    COUNTER_COUNT
+} Counter;
+
+static const char *const counter_names[COUNTER_COUNT] = {
+    "bytes_read", "records_parsed", "tokens_emitted", "hash_probes", "hash_resizes", "messages_sent",
+};
+
+/*
+ * Rótulos do classificador de sentimento (--sentiment), na ordem de
+ * sentiment_totals.json. SENTIMENT_AMBIGUOUS conta, à parte, as músicas
+ * encaminhadas à classificação pelo LLM.
+ */
+typedef enum {
+    SENTIMENT_POSITIVE,
+    SENTIMENT_NEUTRAL,
+    SENTIMENT_NEGATIVE,
+    SENTIMENT_AMBIGUOUS,
+    SENTIMENT_TOTALS
+} SentimentTotal;
+
+/* Nomes dos rótulos, como em scripts/sentiment_classifier.py. */
+static const char *const sentiment_labels[] = {"Positive", "Neutral", "Negative"};
+
+/* Tempos por fase, em segundos, e contadores de um processo ou thread. */
+typedef struct {
+    double seconds[PHASE_COUNT];
+    long long counters[COUNTER_COUNT];
+} PhaseProfile;
+
+/*
+ * Perfil do processo. Só a thread principal o altera: as threads de análise
+ * acumulam no perfil do próprio LocalStats, somado a este ao final.
+ */
+static PhaseProfile rank_profile;
+
+/*
+ * Contagens parciais acumuladas por um processo durante a análise. Os campos
+ * das saídas detalhadas (--per-song, --per-artist) só são usados quando elas
+ * estão ativas: `song_rows` recebe as linhas de word_counts_by_song.csv na
+ * ordem do dataset e `artist_words` conta pares artista/palavra. Com
+ * --sentiment, `sentiment_rows` recebe as linhas de sentiment_scores.csv,
+ * `artist_sentiment` conta as músicas de cada artista por rótulo e
+ * `sentiment_totals` as do processo. Com --approx, `approx` aponta para os
+ * resumos de palavras e de artistas, que substituem `word_counts` e
+ * `artist_counts`.
+ */
+typedef struct {
+    HashTable word_counts;
+    HashTable artist_counts;
+    CountType word_total;
+    CountType song_total;
+    ByteBuffer song_rows;
+    HashTable artist_words;
+    ByteBuffer sentiment_rows;
+    HashTable artist_sentiment;
+    CountType sentiment_totals[SENTIMENT_TOTALS];
+    struct SongCounter *song_words;
+    struct ApproxSketch *approx;
+    PhaseProfile profile;
+} LocalStats;
+
+/*
+ * Visão (ponteiro + comprimento) sobre bytes que pertencem a outro buffer,
+ * como o mapeamento do dataset em memória. Não é terminada em '\0'.
+ */
+typedef struct {
+    const char *data;
+    size_t length;
+} StringView;
+
+/* Mecanismos de leitura do dataset disponíveis via --io. */
+typedef enum {
+    IO_STDIO,
+    IO_MMAP
+} IoEngine;
+
+/* Relógio monotônico dos cronômetros de fase; pode ser usado pelas threads. */
+static double phase_clock(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (double)now.tv_sec + (double)now.tv_nsec * 1e-9;
+}
+
+/* Soma ao perfil do processo o tempo decorrido desde `started` na fase indicada. */
+static void profile_add(Phase phase, double started) {
+    rank_profile.seconds[phase] += phase_clock() - started;
+}
+
+/* Acumula um perfil em outro. */
+static void profile_merge(PhaseProfile *dest, const PhaseProfile *src) {
+    for (int p = 0; p < PHASE_COUNT; ++p) {
+        dest->seconds[p] += src->seconds[p];
+    }
+    for (int c = 0; c < COUNTER_COUNT; ++c) {
+        dest->counters[c] += src->counters[c];
+    }
+}
+
 /* Retorna a próxima potência de dois maior ou igual ao valor solicitado. */
 static size_t next_power_of_two(size_t value) {
     size_t power = 1;
@@ -59,21 +239,98 @@ static size_t next_power_of_two(size_t value) {
     return power < 8 ? 8 : power;
 }
 
-/* Calcula o hash FNV-1a para strings, garantindo boa distribuição. */
-static uint64_t hash_string(const char *str) {
-    const uint64_t fnv_prime = 1099511628211ULL;
-    uint64_t hash = 1469598103934665603ULL;
-    for (const unsigned char *p = (const unsigned char *)str; *p; ++p) {
-        hash ^= (uint64_t)(*p);
-        hash *= fnv_prime;
+#define HASH_OFFSET_BASIS 1469598103934665603ULL
+#define HASH_PRIME 1099511628211ULL
+
+/* Acrescenta um byte a um hash FNV-1a em construção. */
+static inline uint64_t hash_step(uint64_t hash, unsigned char byte) {
+    return (hash ^ (uint64_t)byte) * HASH_PRIME;
+}
+
+/*
+ * Calcula o hash FNV-1a de uma sequência de bytes com comprimento explícito,
+ * garantindo boa distribuição.
+ */
+static uint64_t hash_bytes(const char *data, size_t length) {
+    uint64_t hash = HASH_OFFSET_BASIS;
+    const unsigned char *p = (const unsigned char *)data;
+    for (size_t i = 0; i < length; ++i) {
+        hash = hash_step(hash, p[i]);
     }
     return hash;
 }
 
+/*
+ * Finalizador do splitmix64: espalha os bits de um valor de 64 bits, seja o
+ * hash FNV-1a de uma chave (--approx) ou uma chave inteira (--ngrams).
+ */
+static inline uint64_t mix_hash64(uint64_t hash) {
+    hash ^= hash >> 30;
+    hash *= 0xbf58476d1ce4e5b9ULL;
+    hash ^= hash >> 27;
+    hash *= 0x94d049bb133111ebULL;
+    return hash ^ (hash >> 31);
+}
+
+/* Copia `length` bytes para a arena, acrescentando o terminador '\0'. */
+static char *arena_store(KeyArena *arena, const char *data, size_t length) {
+    size_t needed = length + 1U;
+    ArenaBlock *block = arena->head;
+    if (!block || block->capacity - block->used < needed) {
+        size_t capacity = needed > ARENA_BLOCK_SIZE ? needed : ARENA_BLOCK_SIZE;
+        block = (ArenaBlock *)malloc(sizeof(ArenaBlock) + capacity);
+        if (!block) {
+            fprintf(stderr, "Failed to allocate %zu bytes for key arena\n", capacity);
+            MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
+        }
+        block->next = arena->head;
+        block->used = 0;
+        block->capacity = capacity;
+        arena->head = block;
+        arena->reserved_bytes += capacity;
+    }
+    char *copy = block->data + block->used;
+    memcpy(copy, data, length);
+    copy[length] = '\0';
+    block->used += needed;
+    return copy;
+}
+
+/* Libera todos os blocos da arena de uma só vez. */
+static void arena_free(KeyArena *arena) {
+    ArenaBlock *block = arena->head;
+    while (block) {
+        ArenaBlock *next = block->next;
+        free(block);
+        block = next;
+    }
+    arena->head = NULL;
+    arena->reserved_bytes = 0;
+}
+
+/* Descarta as chaves da arena, mantendo apenas o bloco mais recente para reuso. */
+static void arena_reset(KeyArena *arena) {
+    ArenaBlock *keep = arena->head;
+    if (!keep) {
+        return;
+    }
+    arena->head = keep->next;
+    arena_free(arena);
+    keep->next = NULL;
+    keep->used = 0;
+    arena->head = keep;
+    arena->reserved_bytes = keep->capacity;
+}
+
 /* Inicializa a tabela de hash com a capacidade solicitada. */
 static void ht_init(HashTable *ht, size_t initial_capacity) {
     ht->capacity = next_power_of_two(initial_capacity);
     ht->size = 0;
+    ht->grow_threshold = ht->capacity / HT_LOAD_DENOMINATOR * HT_LOAD_NUMERATOR;
+    ht->keys.head = NULL;
+    ht->keys.reserved_bytes = 0;
+    ht->probes = 0;
+    ht->resizes = 0;
     ht->entries = (Entry *)calloc(ht->capacity, sizeof(Entry));
     if (!ht->entries) {
         fprintf(stderr, "Failed to allocate hash table with capacity %zu\n", ht->capacity);
@@ -81,85 +338,180 @@ static void ht_init(HashTable *ht, size_t initial_capacity) {
     }
 }
 
-/* Libera os recursos associados à tabela de hash. */
+/*
+ * Libera os recursos associados à tabela de hash, somando os seus contadores
+ * ao perfil do processo. As tabelas só são liberadas pela thread principal.
+ */
 static void ht_free(HashTable *ht) {
     if (!ht || !ht->entries) {
         return;
     }
-    for (size_t i = 0; i < ht->capacity; ++i) {
-        if (ht->entries[i].key) {
-            free(ht->entries[i].key);
-        }
-    }
+    rank_profile.counters[COUNTER_HASH_PROBES] += (long long)ht->probes;
+    rank_profile.counters[COUNTER_HASH_RESIZES] += (long long)ht->resizes;
+    ht->probes = 0;
+    ht->resizes = 0;
     free(ht->entries);
+    arena_free(&ht->keys);
     ht->entries = NULL;
     ht->capacity = 0;
     ht->size = 0;
 }
 
-/* Duplica a tabela de hash quando o fator de carga fica elevado. */
+/* Esvazia a tabela sem liberar os registros nem o bloco atual da arena. */
+static void ht_clear(HashTable *ht) {
+    memset(ht->entries, 0, ht->capacity * sizeof(Entry));
+    ht->size = 0;
+    arena_reset(&ht->keys);
+}
+
+/*
+ * Duplica a tabela de hash quando o fator de carga fica elevado. As chaves
+ * continuam na arena; apenas os registros mudam de posição, usando o hash já
+ * armazenado em cada um.
+ */
 static void ht_resize(HashTable *ht, size_t new_capacity) {
-    HashTable resized;
-    ht_init(&resized, new_capacity);
+    size_t capacity = next_power_of_two(new_capacity);
+    Entry *entries = (Entry *)calloc(capacity, sizeof(Entry));
+    if (!entries) {
+        fprintf(stderr, "Failed to allocate hash table with capacity %zu\n", capacity);
+        MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
+    }
+    const size_t mask = capacity - 1U;
     for (size_t i = 0; i < ht->capacity; ++i) {
         if (ht->entries[i].key) {
-            Entry *entry = &ht->entries[i];
-            const size_t mask = resized.capacity - 1U;
-            size_t index = hash_string(entry->key) & mask;
-            while (resized.entries[index].key) {
+            size_t index = ht->entries[i].hash & mask;
+            while (entries[index].key) {
                 index = (index + 1U) & mask;
             }
-            resized.entries[index].key = strdup(entry->key);
-            if (!resized.entries[index].key) {
-                fprintf(stderr, "Failed to duplicate key during resize\n");
-                MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
-            }
-            resized.entries[index].value = entry->value;
-            resized.size++;
+            entries[index] = ht->entries[i];
+        }
+    }
+    free(ht->entries);
+    ht->entries = entries;
+    ht->capacity = capacity;
+    ht->grow_threshold = capacity / HT_LOAD_DENOMINATOR * HT_LOAD_NUMERATOR;
+    ht->resizes++;
+}
+
+/*
+ * Localiza a entrada de uma chave cujo hash FNV-1a já é conhecido, criando-a
+ * com valor 0 se ainda não existir. As chaves são comparadas por hash,
+ * comprimento e memcmp; a cópia para a arena só acontece quando a chave ainda
+ * não existe. O ponteiro devolvido vale até a próxima inserção na tabela.
+ */
+static inline Entry *ht_upsert_hashed(HashTable *ht, const char *key, size_t length, uint64_t hash) {
+    if (ht->size > ht->grow_threshold) {
+        ht_resize(ht, ht->capacity << 1U);
+    }
+    const size_t mask = ht->capacity - 1U;
+    size_t index = hash & mask;
+    ht->probes++;
+    while (ht->entries[index].key) {
+        Entry *existing = &ht->entries[index];
+        if (existing->hash == hash && existing->length == length && memcmp(existing->key, key, length) == 0) {
+            return existing;
         }
+        index = (index + 1U) & mask;
+        ht->probes++;
     }
-    ht_free(ht);
-    *ht = resized;
+    Entry *created = &ht->entries[index];
+    created->key = arena_store(&ht->keys, key, length);
+    created->value = 0;
+    created->hash = hash;
+    created->length = length;
+    ht->size++;
+    return created;
 }
 
-/* Insere ou atualiza uma chave na tabela de hash. */
-static void ht_put(HashTable *ht, const char *key, CountType delta) {
+/*
+ * Insere ou atualiza uma chave informada como sequência de bytes (sem '\0'
+ * final) cujo hash FNV-1a já é conhecido, como os calculados pelo tokenizador
+ * ou guardados em outra tabela.
+ */
+static void ht_put_hashed(HashTable *ht, const char *key, size_t length, uint64_t hash, CountType delta) {
     if (delta == 0) {
         return;
     }
-    if ((double)ht->size / (double)ht->capacity > 0.7) {
-        ht_resize(ht, ht->capacity << 1U);
-    }
+    ht_upsert_hashed(ht, key, length, hash)->value += delta;
+}
+
+/*
+ * Insere ou atualiza uma chave informada como sequência de bytes, permitindo
+ * usar visões diretamente sobre o buffer de entrada.
+ */
+static void ht_put_len(HashTable *ht, const char *key, size_t length, CountType delta) {
+    ht_put_hashed(ht, key, length, hash_bytes(key, length), delta);
+}
+
+/* Procura uma chave cujo hash FNV-1a já é conhecido; devolve NULL se ausente. */
+static const Entry *ht_lookup_hashed(const HashTable *ht, const char *key, size_t length, uint64_t hash) {
     const size_t mask = ht->capacity - 1U;
-    size_t index = hash_string(key) & mask;
+    size_t index = hash & mask;
     while (ht->entries[index].key) {
-        if (strcmp(ht->entries[index].key, key) == 0) {
-            ht->entries[index].value += delta;
-            return;
+        const Entry *existing = &ht->entries[index];
+        if (existing->hash == hash && existing->length == length && memcmp(existing->key, key, length) == 0) {
+            return existing;
         }
         index = (index + 1U) & mask;
     }
-    ht->entries[index].key = strdup(key);
-    if (!ht->entries[index].key) {
-        fprintf(stderr, "Failed to duplicate key '%s'\n", key);
-        MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
+    return NULL;
+}
+
+/* Procura uma chave informada como sequência de bytes; devolve NULL se ausente. */
+static const Entry *ht_lookup(const HashTable *ht, const char *key, size_t length) {
+    return ht_lookup_hashed(ht, key, length, hash_bytes(key, length));
+}
+
+/*
+ * Garante capacidade para `expected` chaves antes de uma mesclagem. As
+ * entradas de outra tabela chegam na ordem das suas posições, isto é, por
+ * bits baixos do hash; inseridas em uma tabela menor, elas formariam longas
+ * sequências contíguas e cada sondagem linear percorreria todo o bloco.
+ */
+static void ht_reserve(HashTable *ht, size_t expected) {
+    if (expected > ht->grow_threshold) {
+        ht_resize(ht, expected / HT_LOAD_NUMERATOR * HT_LOAD_DENOMINATOR + 1U);
     }
-    ht->entries[index].value = delta;
-    ht->size++;
 }
 
 /* Mescla todas as entradas de uma tabela de hash em outra. */
 static void ht_merge(HashTable *dest, const HashTable *src) {
+    ht_reserve(dest, dest->size + src->size);
     for (size_t i = 0; i < src->capacity; ++i) {
         if (src->entries[i].key) {
-            ht_put(dest, src->entries[i].key, src->entries[i].value);
+            const Entry *entry = &src->entries[i];
+            ht_put_hashed(dest, entry->key, entry->length, entry->hash, entry->value);
+        }
+    }
+}
+
+static void byte_buffer_append(ByteBuffer *buffer, const void *data, size_t length) {
+    if (buffer->size + length > buffer->capacity) {
+        size_t new_capacity = buffer->capacity ? buffer->capacity : 4096;
+        while (new_capacity < buffer->size + length) {
+            new_capacity *= 2U;
         }
+        char *tmp = (char *)realloc(buffer->data, new_capacity);
+        if (!tmp) {
+            fprintf(stderr, "Failed to grow byte buffer\n");
+            MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
+        }
+        buffer->data = tmp;
+        buffer->capacity = new_capacity;
+    }
+    if (length > 0) {
+        memcpy(buffer->data + buffer->size, data, length);
     }
+    buffer->size += length;
+}
+
+static void byte_buffer_append_u64(ByteBuffer *buffer, uint64_t value) {
+    byte_buffer_append(buffer, &value, sizeof(value));
 }
 
 /* Converte o conteúdo da tabela para um vetor denso de entradas. */
 static Entry *ht_to_array(const HashTable *ht, size_t *out_size) {
-    Entry *array = (Entry *)malloc(sizeof(Entry) * ht->size);
+    Entry *array = (Entry *)malloc(sizeof(Entry) * (ht->size ? ht->size : 1U));
     if (!array) {
         fprintf(stderr, "Failed to allocate array for hash table export\n");
         MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
@@ -187,6 +539,75 @@ static int entry_compare_desc(const void *a, const void *b) {
     return strcmp(ea->key, eb->key);
 }
 
+/* Restaura a propriedade do heap a partir de `index` (raiz = pior entrada mantida). */
+static void top_heap_sift_down(Entry *heap, size_t size, size_t index) {
+    while (1) {
+        size_t left = 2U * index + 1U;
+        size_t right = left + 1U;
+        size_t worst = index;
+        if (left < size && entry_compare_desc(&heap[left], &heap[worst]) > 0) {
+            worst = left;
+        }
+        if (right < size && entry_compare_desc(&heap[right], &heap[worst]) > 0) {
+            worst = right;
+        }
+        if (worst == index) {
+            return;
+        }
+        Entry tmp = heap[index];
+        heap[index] = heap[worst];
+        heap[worst] = tmp;
+        index = worst;
+    }
+}
+
+/*
+ * Seleciona as `k` maiores entradas da tabela (ou todas, quando `k` é 0) e as
+ * devolve ordenadas por entry_compare_desc. Com limite, um heap limitado a k
+ * posições evita ordenar o vocabulário inteiro: o custo cai de O(n log n)
+ * para O(n log k). O chamador libera o vetor retornado.
+ */
+static Entry *select_top_entries(const HashTable *ht, size_t k, size_t *out_size) {
+    if (k == 0 || k >= ht->size) {
+        Entry *all = ht_to_array(ht, out_size);
+        qsort(all, *out_size, sizeof(Entry), entry_compare_desc);
+        return all;
+    }
+    Entry *heap = (Entry *)malloc(sizeof(Entry) * k);
+    if (!heap) {
+        fprintf(stderr, "Failed to allocate top-%zu selection heap\n", k);
+        MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
+    }
+    size_t size = 0;
+    for (size_t i = 0; i < ht->capacity; ++i) {
+        const Entry *entry = &ht->entries[i];
+        if (!entry->key) {
+            continue;
+        }
+        if (size < k) {
+            /* Inserção com subida: o pior elemento permanece na raiz. */
+            size_t child = size++;
+            heap[child] = *entry;
+            while (child > 0) {
+                size_t parent = (child - 1U) / 2U;
+                if (entry_compare_desc(&heap[child], &heap[parent]) <= 0) {
+                    break;
+                }
+                Entry tmp = heap[child];
+                heap[child] = heap[parent];
+                heap[parent] = tmp;
+                child = parent;
+            }
+        } else if (entry_compare_desc(entry, &heap[0]) < 0) {
+            heap[0] = *entry;
+            top_heap_sift_down(heap, size, 0);
+        }
+    }
+    qsort(heap, size, sizeof(Entry), entry_compare_desc);
+    *out_size = size;
+    return heap;
+}
+
 /* Remove espaços em branco no início e fim da string modificando-a in place. */
 static void trim_inplace(char *value) {
     if (!value) {
@@ -254,8 +675,11 @@ static char *duplicate_field(const char *field, int preserve_outer_quotes) {
     return result;
 }
 
-/* Extrai artista e letra a partir de uma linha CSV, respeitando as aspas originais. */
-static int parse_csv_line(const char *line, char **artist_out, char **lyrics_out,
+/*
+ * Extrai artista e letra a partir de uma linha CSV, respeitando as aspas
+ * originais. Com `song_out` não nulo, extrai também o título, sem aspas.
+ */
+static int parse_csv_line(const char *line, char **artist_out, char **lyrics_out, char **song_out,
                           int preserve_artist_quotes, int preserve_lyrics_quotes) {
     if (!line || !artist_out || !lyrics_out) {
         return 0;
@@ -299,430 +723,5358 @@ static int parse_csv_line(const char *line, char **artist_out, char **lyrics_out
     fields[3] = token_start;
     *artist_out = duplicate_field(fields[0], preserve_artist_quotes);
     *lyrics_out = duplicate_field(fields[3], preserve_lyrics_quotes);
+    if (song_out) {
+        *song_out = duplicate_field(fields[1], 0);
+    }
     free(buffer);
     return *artist_out && *lyrics_out;
 }
 
-/* Escreve uma linha CSV escapando aspas para o campo textual. */
-static void write_csv_entry(FILE *fp, const char *key, CountType value) {
-    fputc('"', fp);
-    for (const char *p = key; *p; ++p) {
-        if (*p == '"') {
-            fputc('"', fp);
-            fputc('"', fp);
-        } else {
-            fputc(*p, fp);
+/* Acrescenta a representação decimal de `value` seguida do terminador `suffix`. */
+static void append_decimal(ByteBuffer *out, CountType value, const char *suffix, size_t suffix_length) {
+    char digits[32];
+    size_t pos = sizeof(digits) - suffix_length;
+    memcpy(digits + pos, suffix, suffix_length);
+    unsigned long long magnitude = value < 0 ? 0ULL - (unsigned long long)value : (unsigned long long)value;
+    do {
+        digits[--pos] = (char)('0' + magnitude % 10U);
+        magnitude /= 10U;
+    } while (magnitude > 0);
+    if (value < 0) {
+        digits[--pos] = '-';
+    }
+    byte_buffer_append(out, digits + pos, sizeof(digits) - pos);
+}
+
+/*
+ * Acrescenta uma linha "chave",contagem de word_counts.csv/top_artists.csv,
+ * duplicando as aspas da chave. Os trechos sem aspas são copiados de uma vez.
+ */
+static void append_quoted_entry(ByteBuffer *out, const char *key, size_t length, CountType value) {
+    byte_buffer_append(out, "\"", 1);
+    const char *end = key + length;
+    while (key < end) {
+        const char *quote = (const char *)memchr(key, '"', (size_t)(end - key));
+        size_t span = quote ? (size_t)(quote - key) + 1U : (size_t)(end - key);
+        byte_buffer_append(out, key, span);
+        if (quote) {
+            byte_buffer_append(out, "\"", 1);
         }
+        key += span;
     }
-    fputc('"', fp);
-    fprintf(fp, ",%lld\n", value);
+    byte_buffer_append(out, "\",", 2);
+    append_decimal(out, value, "\n", 1);
+}
+
+/* Quantidade de entradas exportadas depois de aplicado o limite. */
+static size_t limited_count(size_t count, int limit) {
+    return limit > 0 && (size_t)limit < count ? (size_t)limit : count;
 }
 
 /*
- * Exporta os resultados agregados para um arquivo CSV, ordenando os itens
- * pelos maiores valores e respeitando o limite solicitado.
+ * Exporta os resultados agregados para um arquivo CSV. Recebe as entradas já
+ * ordenadas por select_top_entries e respeita o limite solicitado. As linhas
+ * são formatadas em memória e gravadas com um único fwrite.
  */
-static void write_table_csv(const HashTable *ht, const char *filepath, const char *key_header, int limit) {
+static void write_table_csv(const Entry *entries, size_t count, const char *filepath,
+                            const char *key_header, int limit) {
     FILE *fp = fopen(filepath, "w");
     if (!fp) {
         fprintf(stderr, "Failed to open output file %s: %s\n", filepath, strerror(errno));
         return;
     }
-    fprintf(fp, "%s,count\n", key_header);
-    size_t array_size = 0;
-    Entry *entries = ht_to_array(ht, &array_size);
-    qsort(entries, array_size, sizeof(Entry), entry_compare_desc);
-    size_t max_items = array_size;
-    if (limit > 0 && (size_t)limit < array_size) {
-        max_items = (size_t)limit;
-    }
+    size_t max_items = limited_count(count, limit);
+    ByteBuffer rows = {0};
+    byte_buffer_append(&rows, key_header, strlen(key_header));
+    byte_buffer_append(&rows, ",count\n", 7);
     for (size_t i = 0; i < max_items; ++i) {
-        write_csv_entry(fp, entries[i].key, entries[i].value);
+        append_quoted_entry(&rows, entries[i].key, entries[i].length, entries[i].value);
     }
-    free(entries);
+    if (fwrite(rows.data, 1U, rows.size, fp) != rows.size) {
+        fprintf(stderr, "Failed to write output file %s: %s\n", filepath, strerror(errno));
+    }
+    free(rows.data);
     fclose(fp);
 }
 
+static uint64_t align8(uint64_t value) {
+    return (value + 7U) & ~(uint64_t)7U;
+}
+
+/* Grava um bloco seguido do preenchimento até o próximo múltiplo de 8. */
+static int write_padded(FILE *fp, const void *data, size_t length) {
+    static const char padding[8] = {0};
+    if (length > 0 && fwrite(data, 1, length, fp) != length) {
+        return 0;
+    }
+    size_t pad = (size_t)(align8(length) - length);
+    return pad == 0 || fwrite(padding, 1, pad, fp) == pad;
+}
+
 /*
- * Tokeniza as letras, acumula contagem por palavra e atualiza o total geral,
- * preservando apóstrofos para não descaracterizar contrações e variações.
+ * Grava o cabeçalho e as seções, cada uma alinhada a 8 bytes, em `path` via
+ * arquivo temporário e rename, para que uma execução interrompida nunca
+ * deixe um arquivo parcial. `label` identifica o arquivo nas mensagens de
+ * erro. Retorna 1 em sucesso e 0 em falha.
  */
-static void process_lyrics(HashTable *word_counts, const char *lyrics, CountType *total_words) {
-    size_t capacity = 64;
-    char *buffer = (char *)malloc(capacity);
-    if (!buffer) {
-        fprintf(stderr, "Failed to allocate buffer for tokenisation\n");
-        MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
+static int write_sections_atomically(const char *path, const char *label, const void *header, size_t header_size,
+                                     const StringView *sections, size_t section_count) {
+    char temp_path[PATH_MAX];
+    int ok = snprintf(temp_path, sizeof(temp_path), "%s.tmp", path) < (int)sizeof(temp_path);
+    FILE *fp = ok ? fopen(temp_path, "wb") : NULL;
+    if (!fp) {
+        fprintf(stderr, "Failed to create %s %s: %s\n", label, path, strerror(errno));
+        return 0;
     }
-    size_t length = 0;
-    for (const unsigned char *p = (const unsigned char *)lyrics; *p; ++p) {
-        if (isalnum(*p) || *p == '\'') {
-            if (length + 1 >= capacity) {
-                capacity *= 2U;
-                char *tmp = (char *)realloc(buffer, capacity);
-                if (!tmp) {
-                    free(buffer);
-                    fprintf(stderr, "Failed to grow token buffer\n");
-                    MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
-                }
-                buffer = tmp;
-            }
-            if (isalnum(*p)) {
-                buffer[length++] = (char)tolower(*p);
-            } else {
-                buffer[length++] = (char)*p;
-            }
-        } else {
-            if (length > 0) {
-                buffer[length] = '\0';
-                if (length >= 3) {
-                    ht_put(word_counts, buffer, 1);
-                    (*total_words)++;
-                }
-                length = 0;
-            }
-        }
+    ok = fwrite(header, header_size, 1, fp) == 1;
+    for (size_t i = 0; ok && i < section_count; ++i) {
+        ok = write_padded(fp, sections[i].data, sections[i].length);
     }
-    if (length > 0) {
-        buffer[length] = '\0';
-        if (length >= 3) {
-            ht_put(word_counts, buffer, 1);
-            (*total_words)++;
-        }
+    ok = fclose(fp) == 0 && ok;
+    if (ok && rename(temp_path, path) != 0) {
+        ok = 0;
     }
-    free(buffer);
+    if (!ok) {
+        fprintf(stderr, "Failed to write %s %s: %s\n", label, path, strerror(errno));
+        remove(temp_path);
+    }
+    return ok;
 }
 
-/* Envia todas as entradas de uma tabela de hash para outro processo MPI. */
-static void send_hash_table(const HashTable *ht, int dest, int tag_base, MPI_Comm comm) {
-    int entry_count = (int)ht->size;
-    MPI_Send(&entry_count, 1, MPI_INT, dest, tag_base, comm);
-    for (size_t i = 0; i < ht->capacity; ++i) {
-        if (!ht->entries[i].key) {
-            continue;
+#define RESULT_MAGIC "PSRESULT"
+#define RESULT_VERSION 1
+
+/*
+ * Cabeçalho do formato binário dos resultados (--binary). Depois dele vêm,
+ * cada seção alinhada a 8 bytes e na ordem de bytes nativa:
+ *   offsets[count + 1] (uint32), posições das chaves no bloco de texto;
+ *   runs[run_count], as contagens codificadas por sequência: como as entradas
+ *   estão ordenadas por contagem decrescente, cada CountRun diz que as
+ *   entradas até `end` (exclusivo) têm contagem `value`;
+ *   o bloco com as chaves concatenadas, sem separadores.
+ * As entradas seguem a mesma ordem do CSV correspondente.
+ */
+typedef struct {
+    char magic[8];
+    uint64_t version;
+    uint64_t count;
+    uint64_t blob_size;
+    uint64_t run_count;
+} ResultHeader;
+
+typedef struct {
+    CountType value;
+    uint64_t end;
+} CountRun;
+
+/*
+ * Exporta as mesmas entradas de write_table_csv no formato binário, que pode
+ * ser carregado com um único mmap, sem análise de CSV.
+ */
+static void write_table_binary(const Entry *entries, size_t count, const char *filepath, int limit) {
+    size_t items = limited_count(count, limit);
+    uint32_t *offsets = (uint32_t *)malloc((items + 1U) * sizeof(uint32_t));
+    ByteBuffer runs = {0};
+    ByteBuffer blob = {0};
+    if (!offsets) {
+        fprintf(stderr, "Failed to allocate binary output for %s\n", filepath);
+        MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
+    }
+    for (size_t i = 0; i < items; ++i) {
+        if (blob.size + entries[i].length > (size_t)UINT32_MAX) {
+            fprintf(stderr, "Keys do not fit the binary output format, skipping %s\n", filepath);
+            free(offsets);
+            free(blob.data);
+            free(runs.data);
+            return;
+        }
+        offsets[i] = (uint32_t)blob.size;
+        byte_buffer_append(&blob, entries[i].key, entries[i].length);
+        if (i + 1U == items || entries[i + 1U].value != entries[i].value) {
+            CountRun run = {entries[i].value, (uint64_t)i + 1U};
+            byte_buffer_append(&runs, &run, sizeof(run));
         }
-        int len = (int)strlen(ht->entries[i].key);
-        CountType value = ht->entries[i].value;
-        MPI_Send(&len, 1, MPI_INT, dest, tag_base + 1, comm);
-        MPI_Send(ht->entries[i].key, len, MPI_CHAR, dest, tag_base + 2, comm);
-        MPI_Send(&value, 1, MPI_LONG_LONG, dest, tag_base + 3, comm);
     }
+    offsets[items] = (uint32_t)blob.size;
+
+    ResultHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, RESULT_MAGIC, sizeof(header.magic));
+    header.version = RESULT_VERSION;
+    header.count = items;
+    header.blob_size = blob.size;
+    header.run_count = runs.size / sizeof(CountRun);
+    const StringView sections[] = {
+        {(const char *)offsets, (items + 1U) * sizeof(uint32_t)},
+        {runs.data, runs.size},
+        {blob.data, blob.size},
+    };
+    write_sections_atomically(filepath, "binary output", &header, sizeof(header), sections,
+                              sizeof(sections) / sizeof(sections[0]));
+    free(blob.data);
+    free(runs.data);
+    free(offsets);
 }
 
-/* Recebe uma tabela de hash serializada e mescla os valores no destino. */
-static void receive_hash_table(HashTable *dest, int source, int tag_base, MPI_Comm comm) {
-    MPI_Status status;
-    int entry_count = 0;
-    MPI_Recv(&entry_count, 1, MPI_INT, source, tag_base, comm, &status);
-    for (int i = 0; i < entry_count; ++i) {
-        int len = 0;
-        MPI_Recv(&len, 1, MPI_INT, source, tag_base + 1, comm, &status);
-        char *buffer = (char *)malloc(len + 1);
-        if (!buffer) {
-            fprintf(stderr, "Failed to allocate buffer for received key\n");
-            MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
+/*
+ * Acrescenta um campo CSV com as regras de csv.writer do Python: aspas só
+ * quando o campo contém vírgula, aspas ou quebra de linha.
+ */
+static void append_csv_field(ByteBuffer *out, const char *data, size_t length) {
+    int quoted = 0;
+    for (size_t i = 0; i < length && !quoted; ++i) {
+        quoted = data[i] == ',' || data[i] == '"' || data[i] == '\r' || data[i] == '\n';
+    }
+    if (!quoted) {
+        byte_buffer_append(out, data, length);
+        return;
+    }
+    byte_buffer_append(out, "\"", 1);
+    for (size_t i = 0; i < length; ++i) {
+        byte_buffer_append(out, &data[i], 1);
+        if (data[i] == '"') {
+            byte_buffer_append(out, "\"", 1);
         }
-        MPI_Recv(buffer, len, MPI_CHAR, source, tag_base + 2, comm, &status);
-        buffer[len] = '\0';
-        CountType value = 0;
-        MPI_Recv(&value, 1, MPI_LONG_LONG, source, tag_base + 3, comm, &status);
-        ht_put(dest, buffer, value);
-        free(buffer);
     }
+    byte_buffer_append(out, "\"", 1);
 }
 
-/* Obtém o tamanho do arquivo de entrada em bytes. */
-static long long get_file_size(const char *path) {
-    struct stat st;
-    if (stat(path, &st) != 0) {
-        return -1;
-    }
-    return (long long)st.st_size;
+/* Acrescenta a contagem e o fim de linha (\r\n, como csv.writer) de uma linha CSV. */
+static void append_csv_count(ByteBuffer *out, CountType value) {
+    byte_buffer_append(out, ",", 1);
+    append_decimal(out, value, "\r\n", 2);
 }
 
-/* Mede o comprimento da linha de cabeçalho para permitir o fatiamento do CSV. */
-static long long compute_header_length(const char *path) {
-    FILE *fp = fopen(path, "r");
-    if (!fp) {
-        return -1;
-    }
-    char *line = NULL;
-    size_t n = 0;
-    ssize_t read = getline(&line, &n, fp);
-    long long header_len = -1;
-    if (read >= 0) {
-        header_len = (long long)ftell(fp);
-    }
-    free(line);
-    fclose(fp);
-    return header_len;
+/* Monta o início "artist,song," comum às linhas de uma música. */
+static void format_song_prefix(ByteBuffer *prefix, StringView artist, StringView song) {
+    prefix->size = 0;
+    append_csv_field(prefix, artist.data, artist.length);
+    byte_buffer_append(prefix, ",", 1);
+    append_csv_field(prefix, song.data, song.length);
+    byte_buffer_append(prefix, ",", 1);
 }
 
-/* Cria o diretório de saída caso ele não exista. */
-static void ensure_output_dir(const char *path) {
-    struct stat st;
-    if (stat(path, &st) == 0) {
-        return;
+/* Acrescenta uma linha artist,song,word,count de word_counts_by_song.csv. */
+static void append_song_row(ByteBuffer *out, const ByteBuffer *prefix, const char *word, size_t word_length,
+                            CountType count) {
+    byte_buffer_append(out, prefix->data, prefix->size);
+    append_csv_field(out, word, word_length);
+    append_csv_count(out, count);
+}
+
+/* Maior bloco gravado por chamada de MPI_File_write_at_all. */
+#define PARALLEL_WRITE_CHUNK ((size_t)1 << 30)
+
+/*
+ * Grava em `path` o cabeçalho, pelo rank 0, seguido das linhas de cada
+ * processo na ordem dos ranks, com MPI-IO: o deslocamento de cada rank vem de
+ * um MPI_Exscan dos tamanhos e todos escrevem ao mesmo tempo com
+ * MPI_File_write_at_all, em blocos de até PARALLEL_WRITE_CHUNK bytes.
+ */
+static void write_rows_parallel(const char *path, const char *header, const ByteBuffer *rows, int rank,
+                                MPI_Comm comm) {
+    long long local_size = (long long)rows->size;
+    long long offset = 0;
+    long long total = 0;
+    MPI_Exscan(&local_size, &offset, 1, MPI_LONG_LONG, MPI_SUM, comm);
+    MPI_Allreduce(&local_size, &total, 1, MPI_LONG_LONG, MPI_SUM, comm);
+    if (rank == 0) {
+        offset = 0;
     }
-    if (MKDIR(path) != 0 && errno != EEXIST) {
-        fprintf(stderr, "Failed to create directory %s: %s\n", path, strerror(errno));
+    long long header_size = (long long)strlen(header);
+    long long rounds = (local_size + (long long)PARALLEL_WRITE_CHUNK - 1) / (long long)PARALLEL_WRITE_CHUNK;
+    long long max_rounds = 0;
+    MPI_Allreduce(&rounds, &max_rounds, 1, MPI_LONG_LONG, MPI_MAX, comm);
+
+    MPI_File file;
+    if (MPI_File_open(comm, path, MPI_MODE_CREATE | MPI_MODE_WRONLY, MPI_INFO_NULL, &file) != MPI_SUCCESS ||
+        MPI_File_set_size(file, (MPI_Offset)(header_size + total)) != MPI_SUCCESS) {
+        fprintf(stderr, "Rank %d failed to open output file %s\n", rank, path);
+        MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
+    }
+    int ok = 1;
+    if (rank == 0) {
+        ok = MPI_File_write_at(file, 0, header, (int)header_size, MPI_BYTE, MPI_STATUS_IGNORE) == MPI_SUCCESS;
+    }
+    size_t written = 0;
+    for (long long round = 0; round < max_rounds; ++round) {
+        size_t chunk = rows->size - written < PARALLEL_WRITE_CHUNK ? rows->size - written : PARALLEL_WRITE_CHUNK;
+        MPI_Offset position = (MPI_Offset)(header_size + offset + (long long)written);
+        ok = MPI_File_write_at_all(file, position, rows->data + written, (int)chunk, MPI_BYTE,
+                                   MPI_STATUS_IGNORE) == MPI_SUCCESS && ok;
+        written += chunk;
+    }
+    if (MPI_File_close(&file) != MPI_SUCCESS || !ok) {
+        fprintf(stderr, "Rank %d failed to write output file %s\n", rank, path);
+        MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
     }
 }
 
+/* Trecho de um buffer de linhas produzido pelo bloco de trabalho `chunk`. */
+typedef struct {
+    uint64_t chunk;
+    size_t begin;
+    size_t end;
+} RowSpan;
+
 /*
- * Cria diretórios recursivamente, garantindo que todos os níveis do caminho
- * existam antes do uso. Retorna 0 em sucesso e -1 em caso de erro.
+ * Variante de write_rows_parallel para blocos distribuídos dinamicamente:
+ * cada rank guarda as linhas de vários blocos não contíguos, e o arquivo deve
+ * seguir a ordem dos blocos. Os tamanhos de todos os blocos são somados com
+ * MPI_Allreduce, o que dá o deslocamento de cada um, e cada trecho é gravado
+ * com MPI_File_write_at independente.
  */
-static int ensure_directory_recursive(const char *path) {
-    if (!path || !*path) {
-        return 0;
+static void write_row_spans_parallel(const char *path, const char *header, const ByteBuffer *rows,
+                                     const RowSpan *spans, size_t span_count, size_t chunk_count, int rank,
+                                     MPI_Comm comm) {
+    long long *offsets = (long long *)calloc(chunk_count + 1U, sizeof(long long));
+    if (!offsets) {
+        fprintf(stderr, "Rank %d failed to allocate output offsets\n", rank);
+        MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
     }
-    size_t len = strlen(path);
-    if (len >= PATH_MAX) {
-        errno = ENAMETOOLONG;
+    for (size_t i = 0; i < span_count; ++i) {
+        offsets[spans[i].chunk + 1U] = (long long)(spans[i].end - spans[i].begin);
+    }
+    MPI_Allreduce(MPI_IN_PLACE, offsets, (int)(chunk_count + 1U), MPI_LONG_LONG, MPI_SUM, comm);
+    long long header_size = (long long)strlen(header);
+    offsets[0] = header_size;
+    for (size_t c = 0; c < chunk_count; ++c) {
+        offsets[c + 1U] += offsets[c];
+    }
+
+    MPI_File file;
+    if (MPI_File_open(comm, path, MPI_MODE_CREATE | MPI_MODE_WRONLY, MPI_INFO_NULL, &file) != MPI_SUCCESS ||
+        MPI_File_set_size(file, (MPI_Offset)offsets[chunk_count]) != MPI_SUCCESS) {
+        fprintf(stderr, "Rank %d failed to open output file %s\n", rank, path);
+        MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
+    }
+    int ok = 1;
+    if (rank == 0) {
+        ok = MPI_File_write_at(file, 0, header, (int)header_size, MPI_BYTE, MPI_STATUS_IGNORE) == MPI_SUCCESS;
+    }
+    for (size_t i = 0; ok && i < span_count; ++i) {
+        for (size_t written = spans[i].begin; ok && written < spans[i].end; written += PARALLEL_WRITE_CHUNK) {
+            size_t left = spans[i].end - written;
+            size_t chunk = left < PARALLEL_WRITE_CHUNK ? left : PARALLEL_WRITE_CHUNK;
+            MPI_Offset position = (MPI_Offset)(offsets[spans[i].chunk] + (long long)(written - spans[i].begin));
+            ok = MPI_File_write_at(file, position, rows->data + written, (int)chunk, MPI_BYTE,
+                                   MPI_STATUS_IGNORE) == MPI_SUCCESS;
+        }
+    }
+    if (MPI_File_close(&file) != MPI_SUCCESS || !ok) {
+        fprintf(stderr, "Rank %d failed to write output file %s\n", rank, path);
+        MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
+    }
+    free(offsets);
+}
+
+/* Par artista/palavra pronto para ordenação e escrita. */
+typedef struct {
+    const char *artist;
+    size_t artist_length;
+    const char *word;
+    size_t word_length;
+    CountType count;
+} ArtistWordRow;
+
+static int artist_name_compare(const void *a, const void *b) {
+    return strcmp(((const Entry *)a)->key, ((const Entry *)b)->key);
+}
+
+/* Comprimento do nome do artista em uma chave "artista\0palavra". */
+static size_t artist_key_length(const char *key, size_t length) {
+    const char *separator = (const char *)memchr(key, '\0', length);
+    return separator ? (size_t)(separator - key) : length;
+}
+
+/*
+ * Remove as marcas de música ("artista\0", sem palavra) que --artist-stats
+ * acrescenta à tabela de pares. Retorna quantas entradas restaram.
+ */
+static size_t drop_song_markers(Entry *entries, size_t count) {
+    size_t kept = 0;
+    for (size_t i = 0; i < count; ++i) {
+        if (entries[i].length > 0 && entries[i].key[entries[i].length - 1] != '\0') {
+            entries[kept++] = entries[i];
+        }
+    }
+    return kept;
+}
+
+/* Ordena as linhas de um mesmo artista por contagem decrescente e palavra. */
+static int artist_word_row_compare(const void *a, const void *b) {
+    const ArtistWordRow *ra = (const ArtistWordRow *)a;
+    const ArtistWordRow *rb = (const ArtistWordRow *)b;
+    if (ra->count != rb->count) {
+        return ra->count < rb->count ? 1 : -1;
+    }
+    size_t common = ra->word_length < rb->word_length ? ra->word_length : rb->word_length;
+    int order = memcmp(ra->word, rb->word, common);
+    if (order != 0) {
+        return order;
+    }
+    return ra->word_length < rb->word_length ? -1 : (ra->word_length > rb->word_length ? 1 : 0);
+}
+
+/*
+ * Grava word_counts_by_artist.csv (artist,word,count) a partir da tabela
+ * global de pares, ordenada por artista e, dentro de cada artista, pelas
+ * palavras mais frequentes. Os artistas distintos são ordenados uma única vez;
+ * as linhas são distribuídas por artista com uma ordenação por contagem e só
+ * então ordenadas dentro de cada artista, em grupos pequenos que cabem no
+ * cache. As linhas são montadas em memória e gravadas com uma única escrita.
+ */
+static void write_artist_words_csv(const HashTable *artist_words, const char *filepath) {
+    size_t count = 0;
+    Entry *entries = ht_to_array(artist_words, &count);
+    count = drop_song_markers(entries, count);
+    ArtistWordRow *rows = (ArtistWordRow *)malloc((count ? count : 1U) * sizeof(ArtistWordRow));
+    uint32_t *row_artists = (uint32_t *)malloc((count ? count : 1U) * sizeof(uint32_t));
+    if (!rows || !row_artists) {
+        fprintf(stderr, "Failed to allocate artist word rows\n");
+        MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
+    }
+    HashTable names;
+    ht_init(&names, 8192);
+    for (size_t i = 0; i < count; ++i) {
+        ht_put_len(&names, entries[i].key, artist_key_length(entries[i].key, entries[i].length), 1);
+    }
+    size_t name_count = 0;
+    Entry *sorted_names = ht_to_array(&names, &name_count);
+    qsort(sorted_names, name_count, sizeof(Entry), artist_name_compare);
+    size_t *bucket_starts = (size_t *)calloc(name_count + 1U, sizeof(size_t));
+    if (!bucket_starts) {
+        fprintf(stderr, "Failed to allocate artist word buckets\n");
+        MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
+    }
+    for (size_t i = 0; i < name_count; ++i) {
+        Entry *name = ht_upsert_hashed(&names, sorted_names[i].key, sorted_names[i].length, sorted_names[i].hash);
+        bucket_starts[i + 1] = (size_t)name->value;
+        name->value = (CountType)i;
+    }
+    for (size_t i = 0; i < name_count; ++i) {
+        bucket_starts[i + 1] += bucket_starts[i];
+    }
+    for (size_t i = 0; i < count; ++i) {
+        size_t artist_length = artist_key_length(entries[i].key, entries[i].length);
+        row_artists[i] = (uint32_t)ht_lookup(&names, entries[i].key, artist_length)->value;
+    }
+    size_t *fill = (size_t *)malloc((name_count ? name_count : 1U) * sizeof(size_t));
+    if (!fill) {
+        fprintf(stderr, "Failed to allocate artist word buckets\n");
+        MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
+    }
+    memcpy(fill, bucket_starts, name_count * sizeof(size_t));
+    for (size_t i = 0; i < count; ++i) {
+        const Entry *name = &sorted_names[row_artists[i]];
+        size_t word_start = name->length < entries[i].length ? name->length + 1U : name->length;
+        ArtistWordRow *row = &rows[fill[row_artists[i]]++];
+        row->artist = name->key;
+        row->artist_length = name->length;
+        row->word = entries[i].key + word_start;
+        row->word_length = entries[i].length - word_start;
+        row->count = entries[i].value;
+    }
+    for (size_t i = 0; i < name_count; ++i) {
+        qsort(rows + bucket_starts[i], bucket_starts[i + 1] - bucket_starts[i], sizeof(ArtistWordRow),
+              artist_word_row_compare);
+    }
+    free(fill);
+    free(bucket_starts);
+    free(row_artists);
+
+    ByteBuffer out = {0};
+    byte_buffer_append(&out, "artist,word,count\r\n", 19);
+    for (size_t i = 0; i < count; ++i) {
+        append_csv_field(&out, rows[i].artist, rows[i].artist_length);
+        byte_buffer_append(&out, ",", 1);
+        append_csv_field(&out, rows[i].word, rows[i].word_length);
+        append_csv_count(&out, rows[i].count);
+    }
+    FILE *fp = fopen(filepath, "wb");
+    if (!fp || fwrite(out.data, 1, out.size, fp) != out.size) {
+        fprintf(stderr, "Failed to write output file %s: %s\n", filepath, strerror(errno));
+    }
+    if (fp) {
+        fclose(fp);
+    }
+    free(out.data);
+    free(sorted_names);
+    ht_free(&names);
+    free(rows);
+    free(entries);
+}
+
+#define TOKEN_STACK_CAPACITY 256
+
+/* Quantidade de bytes classificados por vez pelos núcleos vetoriais. */
+#define TOKEN_BLOCK 32
+
+/*
+ * Janela de letra processada por chamada ao núcleo: os bytes minúsculos são
+ * gravados em um espelho na pilha e os tokens são inseridos diretamente a
+ * partir dele.
+ */
+#define TOKEN_WINDOW 4096
+
+/* Tratamento do apóstrofo: parte da palavra (contrações) ou separador. */
+typedef enum {
+    APOSTROPHE_KEEP,
+    APOSTROPHE_SPLIT
+} ApostropheMode;
+
+/*
+ * Política de tokenização definida pela linha de comando. É aplicada uma
+ * única vez em tokenizer_init, que escolhe o núcleo especializado e a tabela
+ * de classificação correspondentes; por byte não há nenhum teste de opção.
+ */
+typedef struct {
+    size_t min_length;
+    ApostropheMode apostrophes;
+    int utf8_letters;
+    int (*is_stopword)(const char *key, size_t length, uint64_t hash);
+} TokenPolicy;
+
+static TokenPolicy token_policy = {3, APOSTROPHE_KEEP, 0, NULL};
+
+/*
+ * Tabela de classificação de bytes: guarda a forma minúscula dos bytes que
+ * compõem palavras (letras e dígitos ASCII e, conforme a política, o
+ * apóstrofo) e 0 para separadores. Equivale a isalnum/tolower no locale "C",
+ * o único usado pelo programa, sem chamadas de função por byte.
+ */
+static unsigned char token_fold[256];
+
+/* Classifica `count` bytes (até TOKEN_BLOCK) pela tabela, sem instruções vetoriais. */
+static uint32_t classify_bytes_scalar(const unsigned char *src, size_t count, unsigned char *dst) {
+    uint32_t mask = 0;
+    for (size_t i = 0; i < count; ++i) {
+        unsigned char folded = token_fold[src[i]];
+        dst[i] = folded;
+        mask |= (uint32_t)(folded != 0) << i;
+    }
+    return mask;
+}
+
+static uint32_t classify_block_scalar(const unsigned char *src, unsigned char *dst) {
+    return classify_bytes_scalar(src, TOKEN_BLOCK, dst);
+}
+
+#if defined(__GNUC__) && (defined(__x86_64__) || (defined(__i386__) && defined(__SSE2__)))
+#include <immintrin.h>
+#define HAVE_X86_SIMD 1
+
+/* Marca os bytes cujo valor sem sinal está em [low, low + count). */
+static inline __m128i sse2_in_range(__m128i v, int low, int count) {
+    __m128i shifted = _mm_add_epi8(v, _mm_set1_epi8((char)(0x80 - low)));
+    return _mm_cmplt_epi8(shifted, _mm_set1_epi8((char)(count - 0x80)));
+}
+
+/*
+ * Classifica 16 bytes e grava sua forma minúscula em `dst`. `apostrophes` é
+ * constante em cada chamador, de modo que o compilador gera uma variante
+ * especializada por política.
+ */
+static inline uint32_t classify_half_sse2(const unsigned char *src, unsigned char *dst, int apostrophes) {
+    __m128i v = _mm_loadu_si128((const __m128i *)src);
+    __m128i upper = sse2_in_range(v, 'A', 26);
+    __m128i letter = sse2_in_range(_mm_or_si128(v, _mm_set1_epi8(0x20)), 'a', 26);
+    __m128i digit = sse2_in_range(v, '0', 10);
+    __m128i word = _mm_or_si128(letter, digit);
+    if (apostrophes) {
+        word = _mm_or_si128(word, _mm_cmpeq_epi8(v, _mm_set1_epi8('\'')));
+    }
+    _mm_storeu_si128((__m128i *)dst, _mm_add_epi8(v, _mm_and_si128(upper, _mm_set1_epi8(0x20))));
+    return (uint32_t)_mm_movemask_epi8(word);
+}
+
+static uint32_t classify_block_sse2(const unsigned char *src, unsigned char *dst) {
+    uint32_t low = classify_half_sse2(src, dst, 1);
+    uint32_t high = classify_half_sse2(src + 16, dst + 16, 1);
+    return low | (high << 16);
+}
+
+static uint32_t classify_block_sse2_split(const unsigned char *src, unsigned char *dst) {
+    uint32_t low = classify_half_sse2(src, dst, 0);
+    uint32_t high = classify_half_sse2(src + 16, dst + 16, 0);
+    return low | (high << 16);
+}
+
+__attribute__((target("avx2"))) static inline __m256i avx2_in_range(__m256i v, int low, int count) {
+    __m256i shifted = _mm256_add_epi8(v, _mm256_set1_epi8((char)(0x80 - low)));
+    return _mm256_cmpgt_epi8(_mm256_set1_epi8((char)(count - 0x80)), shifted);
+}
+
+/* Mesma classificação de classify_half_sse2, em um único registrador de 32 bytes. */
+__attribute__((target("avx2"))) static inline uint32_t classify_avx2(const unsigned char *src, unsigned char *dst,
+                                                                      int apostrophes) {
+    __m256i v = _mm256_loadu_si256((const __m256i *)src);
+    __m256i upper = avx2_in_range(v, 'A', 26);
+    __m256i letter = avx2_in_range(_mm256_or_si256(v, _mm256_set1_epi8(0x20)), 'a', 26);
+    __m256i digit = avx2_in_range(v, '0', 10);
+    __m256i word = _mm256_or_si256(letter, digit);
+    if (apostrophes) {
+        word = _mm256_or_si256(word, _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\'')));
+    }
+    _mm256_storeu_si256((__m256i *)dst, _mm256_add_epi8(v, _mm256_and_si256(upper, _mm256_set1_epi8(0x20))));
+    return (uint32_t)_mm256_movemask_epi8(word);
+}
+
+__attribute__((target("avx2"))) static uint32_t classify_block_avx2(const unsigned char *src, unsigned char *dst) {
+    return classify_avx2(src, dst, 1);
+}
+
+__attribute__((target("avx2"))) static uint32_t classify_block_avx2_split(const unsigned char *src,
+                                                                           unsigned char *dst) {
+    return classify_avx2(src, dst, 0);
+}
+#endif
+
+/* Núcleo de classificação escolhido em tokenizer_init conforme a CPU e a política. */
+static uint32_t (*classify_block)(const unsigned char *src, unsigned char *dst) = classify_block_scalar;
+
+/*
+ * Dicionário que atribui ids sequenciais a chaves, usado para os artistas do
+ * cache e para o vocabulário do índice de tokens (--index). O id de cada
+ * chave fica na tabela como id + 1; `offsets` e `blob` guardam os nomes na
+ * ordem dos ids e `ids` recebe o id de cada ocorrência registrada.
+ */
+typedef struct {
+    HashTable table;
+    ByteBuffer offsets;
+    ByteBuffer blob;
+    ByteBuffer ids;
+    uint32_t count;
+} Interner;
+
+static void interner_init(Interner *interner, size_t initial_capacity) {
+    memset(interner, 0, sizeof(*interner));
+    ht_init(&interner->table, initial_capacity);
+    byte_buffer_append_u64(&interner->offsets, 0);
+}
+
+static void interner_free(Interner *interner) {
+    ht_free(&interner->table);
+    free(interner->offsets.data);
+    free(interner->blob.data);
+    free(interner->ids.data);
+}
+
+/* Registra uma ocorrência da chave, criando um id para ela se for nova. */
+static void intern_key(Interner *interner, const char *key, size_t length, uint64_t hash) {
+    Entry *slot = ht_upsert_hashed(&interner->table, key, length, hash);
+    if (slot->value == 0) {
+        slot->value = (CountType)++interner->count;
+        byte_buffer_append(&interner->blob, key, length);
+        byte_buffer_append_u64(&interner->offsets, interner->blob.size);
+    }
+    uint32_t id = (uint32_t)(slot->value - 1);
+    byte_buffer_append(&interner->ids, &id, sizeof(id));
+}
+
+/* Capacidade inicial da tabela de uma música; tabelas muito maiores são refeitas. */
+#define SONG_TABLE_CAPACITY 512
+#define SONG_TABLE_LIMIT 4096
+
+/*
+ * Contagem das palavras de uma única música para as saídas detalhadas, na
+ * ordem da primeira ocorrência (a mesma de collections.Counter em
+ * scripts/word_count_per_song.py). A tabela guarda a posição de cada palavra
+ * em `words` + 1; as chaves de `words` apontam para a arena da tabela.
+ */
+typedef struct SongCounter {
+    HashTable table;
+    Entry *words;
+    size_t count;
+    size_t capacity;
+    ByteBuffer scratch;
+    ByteBuffer prefix;
+} SongCounter;
+
+static void song_counter_add(SongCounter *counter, const char *key, size_t length, uint64_t hash) {
+    Entry *slot = ht_upsert_hashed(&counter->table, key, length, hash);
+    if (slot->value > 0) {
+        counter->words[slot->value - 1].value++;
+        return;
+    }
+    if (counter->count == counter->capacity) {
+        size_t capacity = counter->capacity ? counter->capacity * 2U : 256U;
+        Entry *words = (Entry *)realloc(counter->words, capacity * sizeof(Entry));
+        if (!words) {
+            fprintf(stderr, "Failed to grow song word list\n");
+            MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
+        }
+        counter->words = words;
+        counter->capacity = capacity;
+    }
+    slot->value = (CountType)(counter->count + 1U);
+    Entry *word = &counter->words[counter->count++];
+    word->key = slot->key;
+    word->value = 1;
+    word->hash = hash;
+    word->length = length;
+}
+
+/* Prepara o contador para a próxima música. */
+static void song_counter_clear(SongCounter *counter) {
+    if (counter->table.capacity > SONG_TABLE_LIMIT) {
+        ht_free(&counter->table);
+        ht_init(&counter->table, SONG_TABLE_CAPACITY);
+    } else {
+        ht_clear(&counter->table);
+    }
+    counter->count = 0;
+}
+
+/*
+ * Resumo aproximado de um fluxo de chaves (--approx), de tamanho fixo e
+ * independente do vocabulário: um Count-Min Sketch com APPROX_DEPTH linhas
+ * de APPROX_WIDTH contadores, os APPROX_HEAVY candidatos a mais frequentes
+ * do algoritmo Space-Saving e os registradores de um HyperLogLog. Por não
+ * conter ponteiros, o resumo inteiro é somado entre os processos por um
+ * único MPI_Reduce (approx_reduce_op).
+ *
+ * Os candidatos ficam em `slots`, com ids estáveis; `heap` é um heap de
+ * mínimo dos ids por contagem (`heap_pos` é a posição de cada id nele) e
+ * `index`, uma tabela de endereçamento aberto com id + 1 por hash da chave.
+ * Chaves com mais de APPROX_KEY_MAX bytes entram no sketch e no HyperLogLog,
+ * mas não concorrem aos candidatos.
+ */
+#define APPROX_DEPTH 4
+#define APPROX_WIDTH ((size_t)1 << 16)
+#define APPROX_HEAVY 4096U
+#define APPROX_INDEX_SIZE (2U * APPROX_HEAVY)
+#define APPROX_HLL_BITS 14
+#define APPROX_HLL_REGISTERS ((size_t)1 << APPROX_HLL_BITS)
+#define APPROX_KEY_MAX 44
+
+/* Resumos de cada LocalStats com --approx: palavras e artistas. */
+enum { APPROX_WORDS, APPROX_ARTISTS, APPROX_SKETCHES };
+
+typedef struct {
+    CountType count;
+    uint64_t hash;
+    uint32_t length;
+    char key[APPROX_KEY_MAX];
+} HeavySlot;
+
+typedef struct ApproxSketch {
+    CountType cms[APPROX_DEPTH][APPROX_WIDTH];
+    HeavySlot slots[APPROX_HEAVY];
+    uint32_t heap[APPROX_HEAVY];
+    uint32_t heap_pos[APPROX_HEAVY];
+    uint32_t index[APPROX_INDEX_SIZE];
+    uint32_t heavy_count;
+    unsigned char hll[APPROX_HLL_REGISTERS];
+} ApproxSketch;
+
+/* Contagem aproximada ativa (--approx); vale para todos os LocalStats. */
+static int approx_counting = 0;
+
+/* Coluna da linha `row` do sketch (hash duplo de Kirsch e Mitzenmacher). */
+static inline size_t approx_column(uint64_t mixed, unsigned row) {
+    uint32_t h1 = (uint32_t)mixed;
+    uint32_t h2 = (uint32_t)(mixed >> 32) | 1U;
+    return (size_t)(h1 + row * h2) & (APPROX_WIDTH - 1U);
+}
+
+static inline int heavy_slot_matches(const HeavySlot *slot, const char *key, size_t length, uint64_t hash) {
+    return slot->hash == hash && slot->length == length && memcmp(slot->key, key, length) == 0;
+}
+
+/* Posição de `index` com o id da chave ou, se ausente, a vaga onde ela entraria. */
+static size_t heavy_index_find(const ApproxSketch *sketch, const char *key, size_t length, uint64_t hash) {
+    size_t position = (size_t)mix_hash64(hash) & (APPROX_INDEX_SIZE - 1U);
+    while (sketch->index[position] != 0 &&
+           !heavy_slot_matches(&sketch->slots[sketch->index[position] - 1U], key, length, hash)) {
+        position = (position + 1U) & (APPROX_INDEX_SIZE - 1U);
+    }
+    return position;
+}
+
+/* Remove a entrada `position` de `index`, recuando as que vêm depois dela. */
+static void heavy_index_remove(ApproxSketch *sketch, size_t position) {
+    size_t hole = position;
+    size_t next = position;
+    for (;;) {
+        next = (next + 1U) & (APPROX_INDEX_SIZE - 1U);
+        if (sketch->index[next] == 0) {
+            break;
+        }
+        size_t home = (size_t)mix_hash64(sketch->slots[sketch->index[next] - 1U].hash) & (APPROX_INDEX_SIZE - 1U);
+        /* A entrada pode ocupar o buraco se a sua posição ideal não estiver em (hole, next]. */
+        int stays = hole <= next ? (home > hole && home <= next) : (home > hole || home <= next);
+        if (!stays) {
+            sketch->index[hole] = sketch->index[next];
+            hole = next;
+        }
+    }
+    sketch->index[hole] = 0;
+}
+
+static inline void heavy_heap_swap(ApproxSketch *sketch, size_t a, size_t b) {
+    uint32_t id = sketch->heap[a];
+    sketch->heap[a] = sketch->heap[b];
+    sketch->heap[b] = id;
+    sketch->heap_pos[sketch->heap[a]] = (uint32_t)a;
+    sketch->heap_pos[sketch->heap[b]] = (uint32_t)b;
+}
+
+static void heavy_sift_up(ApproxSketch *sketch, size_t position) {
+    while (position > 0) {
+        size_t parent = (position - 1U) / 2U;
+        if (sketch->slots[sketch->heap[parent]].count <= sketch->slots[sketch->heap[position]].count) {
+            break;
+        }
+        heavy_heap_swap(sketch, parent, position);
+        position = parent;
+    }
+}
+
+static void heavy_sift_down(ApproxSketch *sketch, size_t position) {
+    size_t size = sketch->heavy_count;
+    for (;;) {
+        size_t smallest = position;
+        size_t left = 2U * position + 1U;
+        size_t right = left + 1U;
+        if (left < size && sketch->slots[sketch->heap[left]].count < sketch->slots[sketch->heap[smallest]].count) {
+            smallest = left;
+        }
+        if (right < size && sketch->slots[sketch->heap[right]].count < sketch->slots[sketch->heap[smallest]].count) {
+            smallest = right;
+        }
+        if (smallest == position) {
+            return;
+        }
+        heavy_heap_swap(sketch, position, smallest);
+        position = smallest;
+    }
+}
+
+/*
+ * Passo do Space-Saving: a chave presente soma `count`; com vagas livres ela
+ * entra com `count`; caso contrário substitui o candidato de menor contagem
+ * e herda essa contagem, que passa a ser um limite superior da sua.
+ */
+static void heavy_add(ApproxSketch *sketch, const char *key, size_t length, uint64_t hash, CountType count) {
+    if (length > APPROX_KEY_MAX) {
+        return;
+    }
+    size_t position = heavy_index_find(sketch, key, length, hash);
+    uint32_t id = sketch->index[position];
+    if (id != 0) {
+        sketch->slots[id - 1U].count += count;
+        heavy_sift_down(sketch, sketch->heap_pos[id - 1U]);
+        return;
+    }
+    int evicting = sketch->heavy_count == APPROX_HEAVY;
+    if (!evicting) {
+        id = sketch->heavy_count++;
+        sketch->slots[id].count = count;
+        sketch->heap[id] = id;
+        sketch->heap_pos[id] = id;
+    } else {
+        id = sketch->heap[0];
+        const HeavySlot *evicted = &sketch->slots[id];
+        heavy_index_remove(sketch, heavy_index_find(sketch, evicted->key, evicted->length, evicted->hash));
+        position = heavy_index_find(sketch, key, length, hash);
+        sketch->slots[id].count += count;
+    }
+    HeavySlot *slot = &sketch->slots[id];
+    slot->hash = hash;
+    slot->length = (uint32_t)length;
+    memcpy(slot->key, key, length);
+    sketch->index[position] = id + 1U;
+    if (evicting) {
+        heavy_sift_down(sketch, 0);
+    } else {
+        heavy_sift_up(sketch, id);
+    }
+}
+
+/* Contagem de um candidato de `sketch`, ou `floor` se a chave não estiver lá. */
+static CountType heavy_count_or(const ApproxSketch *sketch, const HeavySlot *slot, CountType floor) {
+    uint32_t id = sketch->index[heavy_index_find(sketch, slot->key, slot->length, slot->hash)];
+    return id != 0 ? sketch->slots[id - 1U].count : floor;
+}
+
+/* Menor contagem que uma chave ausente pode ter: a do mínimo, se os candidatos estão cheios. */
+static CountType heavy_floor(const ApproxSketch *sketch) {
+    return sketch->heavy_count == APPROX_HEAVY ? sketch->slots[sketch->heap[0]].count : 0;
+}
+
+static int heavy_slot_compare(const void *a, const void *b) {
+    const HeavySlot *sa = (const HeavySlot *)a;
+    const HeavySlot *sb = (const HeavySlot *)b;
+    if (sa->count != sb->count) {
+        return sa->count < sb->count ? 1 : -1;
+    }
+    size_t common = sa->length < sb->length ? sa->length : sb->length;
+    int order = memcmp(sa->key, sb->key, common);
+    if (order != 0) {
+        return order;
+    }
+    return sa->length < sb->length ? -1 : (sa->length > sb->length ? 1 : 0);
+}
+
+/*
+ * Une os candidatos de dois resumos (Space-Saving mesclável): cada chave soma
+ * as duas contagens, valendo heavy_floor para o lado que não a tem, e ficam
+ * as APPROX_HEAVY maiores, sem perder a garantia de limite superior.
+ */
+static void heavy_merge(ApproxSketch *dest, const ApproxSketch *src) {
+    HeavySlot *merged = (HeavySlot *)malloc(2U * APPROX_HEAVY * sizeof(HeavySlot));
+    if (!merged) {
+        fprintf(stderr, "Failed to allocate approximate counting candidates\n");
+        MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
+    }
+    CountType dest_floor = heavy_floor(dest);
+    CountType src_floor = heavy_floor(src);
+    size_t count = 0;
+    for (uint32_t id = 0; id < dest->heavy_count; ++id) {
+        merged[count] = dest->slots[id];
+        merged[count++].count += heavy_count_or(src, &dest->slots[id], src_floor);
+    }
+    for (uint32_t id = 0; id < src->heavy_count; ++id) {
+        if (heavy_count_or(dest, &src->slots[id], -1) < 0) {
+            merged[count] = src->slots[id];
+            merged[count++].count += dest_floor;
+        }
+    }
+    qsort(merged, count, sizeof(HeavySlot), heavy_slot_compare);
+    if (count > APPROX_HEAVY) {
+        count = APPROX_HEAVY;
+    }
+    /* Em ordem crescente de contagem, o vetor já é um heap de mínimo. */
+    memset(dest->index, 0, sizeof(dest->index));
+    dest->heavy_count = (uint32_t)count;
+    for (size_t id = 0; id < count; ++id) {
+        dest->slots[id] = merged[id];
+        dest->heap[count - 1U - id] = (uint32_t)id;
+        dest->heap_pos[id] = (uint32_t)(count - 1U - id);
+        dest->index[heavy_index_find(dest, merged[id].key, merged[id].length, merged[id].hash)] = (uint32_t)id + 1U;
+    }
+    free(merged);
+}
+
+static ApproxSketch *approx_alloc(size_t count) {
+    ApproxSketch *sketches = (ApproxSketch *)calloc(count, sizeof(ApproxSketch));
+    if (!sketches) {
+        fprintf(stderr, "Failed to allocate approximate counting sketches\n");
+        MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
+    }
+    return sketches;
+}
+
+/* Registra `count` ocorrências de uma chave nas três estruturas do resumo. */
+static inline void approx_add(ApproxSketch *sketch, const char *key, size_t length, uint64_t hash, CountType count) {
+    uint64_t mixed = mix_hash64(hash);
+    for (unsigned row = 0; row < APPROX_DEPTH; ++row) {
+        sketch->cms[row][approx_column(mixed, row)] += count;
+    }
+    uint64_t hll_hash = mix_hash64(mixed ^ 0x9e3779b97f4a7c15ULL);
+    size_t reg = (size_t)(hll_hash >> (64 - APPROX_HLL_BITS));
+    uint64_t rest = hll_hash << APPROX_HLL_BITS;
+    unsigned char rank = 1;
+    while (rank <= 64 - APPROX_HLL_BITS && !(rest & (1ULL << 63))) {
+        rest <<= 1;
+        rank++;
+    }
+    if (sketch->hll[reg] < rank) {
+        sketch->hll[reg] = rank;
+    }
+    heavy_add(sketch, key, length, hash, count);
+}
+
+/* Estimativa do Count-Min Sketch: o menor contador entre as linhas. */
+static CountType approx_estimate(const ApproxSketch *sketch, uint64_t hash) {
+    uint64_t mixed = mix_hash64(hash);
+    CountType estimate = sketch->cms[0][approx_column(mixed, 0)];
+    for (unsigned row = 1; row < APPROX_DEPTH; ++row) {
+        CountType value = sketch->cms[row][approx_column(mixed, row)];
+        if (value < estimate) {
+            estimate = value;
+        }
+    }
+    return estimate;
+}
+
+/* Quantidade de chaves distintas estimada pelo HyperLogLog, com contagem linear para poucas chaves. */
+static double approx_distinct(const ApproxSketch *sketch) {
+    double registers = (double)APPROX_HLL_REGISTERS;
+    double sum = 0.0;
+    size_t zeros = 0;
+    for (size_t i = 0; i < APPROX_HLL_REGISTERS; ++i) {
+        sum += 1.0 / (double)(1ULL << sketch->hll[i]);
+        zeros += sketch->hll[i] == 0;
+    }
+    double estimate = 0.7213 / (1.0 + 1.079 / registers) * registers * registers / sum;
+    if (estimate <= 2.5 * registers && zeros > 0) {
+        estimate = registers * log(registers / (double)zeros);
+    }
+    return estimate;
+}
+
+/* Soma `src` em `dest`: contadores somados, registradores pelo máximo, candidatos mesclados. */
+static void approx_merge(ApproxSketch *dest, const ApproxSketch *src) {
+    for (unsigned row = 0; row < APPROX_DEPTH; ++row) {
+        for (size_t column = 0; column < APPROX_WIDTH; ++column) {
+            dest->cms[row][column] += src->cms[row][column];
+        }
+    }
+    for (size_t i = 0; i < APPROX_HLL_REGISTERS; ++i) {
+        if (dest->hll[i] < src->hll[i]) {
+            dest->hll[i] = src->hll[i];
+        }
+    }
+    heavy_merge(dest, src);
+}
+
+/*
+ * Converte os candidatos em contagens de `table`, cada uma estimada pelo
+ * menor dos dois limites superiores: o do Space-Saving e o do Count-Min.
+ */
+static void approx_to_table(const ApproxSketch *sketch, HashTable *table) {
+    for (uint32_t id = 0; id < sketch->heavy_count; ++id) {
+        const HeavySlot *slot = &sketch->slots[id];
+        CountType estimate = approx_estimate(sketch, slot->hash);
+        ht_put_hashed(table, slot->key, slot->length, slot->hash, estimate < slot->count ? estimate : slot->count);
+    }
+}
+
+/*
+ * Destino dos tokens aceitos pelo tokenizador. Na análise comum cada token
+ * incrementa `counts`; com `interner` não nulo ele é convertido em id do
+ * vocabulário do índice e, com `song`, contado na música corrente; com
+ * `approx`, entra no resumo aproximado de palavras.
+ */
+typedef struct {
+    HashTable *counts;
+    CountType *total;
+    Interner *interner;
+    SongCounter *song;
+    ApproxSketch *approx;
+} TokenSink;
+
+static inline void sink_token(TokenSink *sink, const char *key, size_t length, uint64_t hash) {
+    (*sink->total)++;
+    if (sink->interner) {
+        intern_key(sink->interner, key, length, hash);
+    } else if (sink->song) {
+        song_counter_add(sink->song, key, length, hash);
+    } else if (sink->approx) {
+        approx_add(sink->approx, key, length, hash, 1);
+    } else {
+        ht_put_hashed(sink->counts, key, length, hash, 1);
+    }
+}
+
+/* Tokenizador de letras escolhido em tokenizer_init (ASCII vetorial ou UTF-8). */
+static void (*tokenize_lyrics)(TokenSink *sink, const char *lyrics, size_t lyrics_len);
+
+/*
+ * Decide se um token delimitado entra na contagem: comprimento mínimo, em
+ * caracteres, e lista de stop words. É avaliado uma vez por token, e a lista
+ * recebe o mesmo hash FNV-1a que segue depois para sink_token.
+ */
+static inline int token_accepted(const char *key, size_t length, size_t characters, uint64_t hash) {
+    if (characters < token_policy.min_length) {
+        return 0;
+    }
+    return !token_policy.is_stopword || !token_policy.is_stopword(key, length, hash);
+}
+
+static inline unsigned lowest_bit_index(uint64_t bits) {
+#ifdef __GNUC__
+    return (unsigned)__builtin_ctzll(bits);
+#else
+    unsigned index = 0;
+    while (!(bits & 1U)) {
+        bits >>= 1;
+        ++index;
+    }
+    return index;
+#endif
+}
+
+/*
+ * Garante espaço para mais um byte no buffer de token, que começa na pilha
+ * (`stack_buffer`) e só migra para o heap quando surge uma palavra
+ * excepcionalmente longa.
+ */
+static void token_buffer_reserve(char **buffer, size_t *capacity, size_t length, char *stack_buffer) {
+    if (length < *capacity) {
+        return;
+    }
+    size_t new_capacity = *capacity * 2U;
+    char *tmp = (char *)malloc(new_capacity);
+    if (!tmp) {
+        fprintf(stderr, "Failed to grow token buffer\n");
+        MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
+    }
+    memcpy(tmp, *buffer, length);
+    if (*buffer != stack_buffer) {
+        free(*buffer);
+    }
+    *buffer = tmp;
+    *capacity = new_capacity;
+}
+
+/*
+ * Caminho escalar da tokenização, usado para trechos com palavras maiores
+ * que a janela do núcleo vetorial.
+ */
+static void process_lyrics_scalar(TokenSink *sink, const unsigned char *p, const unsigned char *end) {
+    char stack_buffer[TOKEN_STACK_CAPACITY];
+    char *buffer = stack_buffer;
+    size_t capacity = sizeof(stack_buffer);
+    size_t length = 0;
+    uint64_t hash = HASH_OFFSET_BASIS;
+    for (;; ++p) {
+        unsigned char folded = p < end ? token_fold[*p] : 0;
+        if (folded) {
+            token_buffer_reserve(&buffer, &capacity, length, stack_buffer);
+            buffer[length++] = (char)folded;
+            hash = hash_step(hash, folded);
+            continue;
+        }
+        if (length > 0 && token_accepted(buffer, length, length, hash)) {
+            sink_token(sink, buffer, length, hash);
+        }
+        length = 0;
+        hash = HASH_OFFSET_BASIS;
+        if (p >= end) {
+            break;
+        }
+    }
+    if (buffer != stack_buffer) {
+        free(buffer);
+    }
+}
+
+/*
+ * Tokeniza uma janela que não corta palavras ao meio. Cada bloco de 32 bytes
+ * vira uma máscara de bytes de palavra; as bordas (início e fim de token) são
+ * os bits de mask ^ (mask << 1) e são percorridas com ctz. Cada token é
+ * entregue direto do espelho minúsculo, ainda no cache, onde seu hash é
+ * calculado uma única vez; não há cópia para um buffer intermediário
+ * nem terminador.
+ */
+static void tokenize_window(TokenSink *sink, const unsigned char *src, size_t window_len,
+                            unsigned char *lowered) {
+    uint64_t previous = 0;
+    size_t token_start = 0;
+    for (size_t base = 0; base < window_len; base += TOKEN_BLOCK) {
+        size_t count = window_len - base;
+        uint64_t mask;
+        if (count >= TOKEN_BLOCK) {
+            count = TOKEN_BLOCK;
+            mask = classify_block(src + base, lowered + base);
+        } else {
+            mask = classify_bytes_scalar(src + base, count, lowered + base);
+        }
+        uint64_t edges = mask ^ ((mask << 1) | previous);
+        /*
+         * Em blocos completos a borda final fica para o próximo bloco; no bloco
+         * parcial o bit `count` fecha um token que termine no fim da janela.
+         */
+        edges &= ((uint64_t)1 << (count < TOKEN_BLOCK ? count + 1 : TOKEN_BLOCK)) - 1U;
+        while (edges) {
+            unsigned bit = lowest_bit_index(edges);
+            edges &= edges - 1U;
+            if ((mask >> bit) & 1U) {
+                token_start = base + bit;
+            } else {
+                const char *key = (const char *)lowered + token_start;
+                size_t length = base + bit - token_start;
+                uint64_t hash = hash_bytes(key, length);
+                if (token_accepted(key, length, length, hash)) {
+                    sink_token(sink, key, length, hash);
+                }
+            }
+        }
+        previous = (mask >> (TOKEN_BLOCK - 1)) & 1U;
+    }
+    if (window_len % TOKEN_BLOCK == 0 && previous) {
+        const char *key = (const char *)lowered + token_start;
+        size_t length = window_len - token_start;
+        uint64_t hash = hash_bytes(key, length);
+        if (token_accepted(key, length, length, hash)) {
+            sink_token(sink, key, length, hash);
+        }
+    }
+}
+
+/*
+ * Tokenizador ASCII: percorre a letra em janelas de até TOKEN_WINDOW bytes
+ * terminadas em separador, classificadas pelo núcleo vetorial selecionado em
+ * tokenizer_init. Bytes fora do ASCII são separadores.
+ */
+static void tokenize_lyrics_ascii(TokenSink *sink, const char *lyrics, size_t lyrics_len) {
+    unsigned char lowered[TOKEN_WINDOW];
+    const unsigned char *src = (const unsigned char *)lyrics;
+    size_t pos = 0;
+    while (pos < lyrics_len) {
+        size_t window = lyrics_len - pos;
+        if (window > TOKEN_WINDOW) {
+            window = TOKEN_WINDOW;
+            while (window > 0 && token_fold[src[pos + window]]) {
+                --window;
+            }
+            if (window == 0) {
+                /* Palavra maior que a janela: segue pelo caminho escalar. */
+                size_t run_end = pos + TOKEN_WINDOW;
+                while (run_end < lyrics_len && token_fold[src[run_end]]) {
+                    ++run_end;
+                }
+                process_lyrics_scalar(sink, src + pos, src + run_end);
+                pos = run_end;
+                continue;
+            }
+        }
+        tokenize_window(sink, src + pos, window, lowered);
+        pos += window;
+    }
+}
+
+/*
+ * Tokenizador com letras acentuadas em UTF-8: além das classes ASCII, aceita
+ * as letras do bloco Latin-1 (U+00C0 a U+00FF, exceto × e ÷), codificadas
+ * como 0xC3 seguido de 0x80..0xBF, e converte as maiúsculas (U+00C0 a
+ * U+00DE) para minúsculas. É o mesmo conjunto da expressão regular de
+ * scripts/word_count_per_song.py; o comprimento mínimo conta caracteres, não
+ * bytes.
+ */
+static void tokenize_lyrics_utf8(TokenSink *sink, const char *lyrics, size_t lyrics_len) {
+    char stack_buffer[TOKEN_STACK_CAPACITY];
+    char *buffer = stack_buffer;
+    size_t capacity = sizeof(stack_buffer);
+    size_t length = 0;
+    size_t characters = 0;
+    uint64_t hash = HASH_OFFSET_BASIS;
+    const unsigned char *p = (const unsigned char *)lyrics;
+    size_t i = 0;
+    for (;;) {
+        if (i < lyrics_len) {
+            unsigned char folded = token_fold[p[i]];
+            if (folded) {
+                token_buffer_reserve(&buffer, &capacity, length, stack_buffer);
+                buffer[length++] = (char)folded;
+                hash = hash_step(hash, folded);
+                characters++;
+                i++;
+                continue;
+            }
+            if (p[i] == 0xC3 && i + 1 < lyrics_len && p[i + 1] >= 0x80 && p[i + 1] <= 0xBF && p[i + 1] != 0x97 &&
+                p[i + 1] != 0xB7) {
+                unsigned char second = p[i + 1] <= 0x9E ? (unsigned char)(p[i + 1] + 0x20) : p[i + 1];
+                token_buffer_reserve(&buffer, &capacity, length + 1, stack_buffer);
+                buffer[length++] = (char)0xC3;
+                buffer[length++] = (char)second;
+                hash = hash_step(hash_step(hash, 0xC3), second);
+                characters++;
+                i += 2;
+                continue;
+            }
+        }
+        if (length > 0 && token_accepted(buffer, length, characters, hash)) {
+            sink_token(sink, buffer, length, hash);
+        }
+        length = 0;
+        characters = 0;
+        hash = HASH_OFFSET_BASIS;
+        if (i >= lyrics_len) {
+            break;
+        }
+        i++;
+    }
+    if (buffer != stack_buffer) {
+        free(buffer);
+    }
+}
+
+#include "stopwords_default.h"
+
+/*
+ * Consulta a lista padrão de stop words, compilada em stopwords_default.h
+ * como uma tabela de hash perfeito: o hash FNV-1a escolhe um balde, cuja
+ * semente leva a uma posição exclusiva, e basta uma comparação. `hash` é o
+ * hash FNV-1a do token, já calculado pelo tokenizador.
+ */
+static int default_stopword(const char *key, size_t length, uint64_t hash) {
+    if (length > STOPWORD_MAX_LENGTH) {
+        return 0;
+    }
+    uint64_t mixed = (hash ^ stopword_seeds[hash % STOPWORD_BUCKETS]) * 0x9E3779B97F4A7C15ULL;
+    const StringView *candidate = &stopword_table[mixed >> (64 - STOPWORD_TABLE_BITS)];
+    return candidate->length == length && candidate->data && memcmp(candidate->data, key, length) == 0;
+}
+
+/* Stop words carregadas de um arquivo informado em --stopwords. */
+static HashTable custom_stopwords;
+
+static int custom_stopword(const char *key, size_t length, uint64_t hash) {
+    return ht_lookup_hashed(&custom_stopwords, key, length, hash) != NULL;
+}
+
+/*
+ * Carrega uma lista de stop words (uma por linha, '#' para comentários),
+ * normalizando-as com a mesma tabela de classificação dos tokens. Retorna 1
+ * em sucesso e 0 se o arquivo não puder ser lido.
+ */
+static int load_stopwords(const char *path) {
+    FILE *fp = fopen(path, "r");
+    if (!fp) {
+        return 0;
+    }
+    ht_init(&custom_stopwords, 1024);
+    char *line = NULL;
+    size_t line_cap = 0;
+    ssize_t read;
+    while ((read = getline(&line, &line_cap, fp)) >= 0) {
+        size_t length = 0;
+        for (ssize_t i = 0; i < read; ++i) {
+            unsigned char ch = (unsigned char)line[i];
+            if (ch == '\n' || ch == '\r' || ch == ' ' || ch == '\t') {
+                continue;
+            }
+            line[length++] = token_fold[ch] ? (char)token_fold[ch] : (char)ch;
+        }
+        if (length > 0 && line[0] != '#') {
+            ht_put_len(&custom_stopwords, line, length, 1);
+        }
+    }
+    free(line);
+    fclose(fp);
+    return 1;
+}
+
+/*
+ * Aplica a política de tokenização: monta a tabela de classificação e
+ * seleciona o núcleo especializado suportado pela CPU (AVX2, SSE2 ou escalar)
+ * e pela política. Deve ser chamada antes de qualquer tokenização e antes de
+ * criar threads. Retorna o nome do núcleo escolhido.
+ */
+static const char *tokenizer_init(const TokenPolicy *policy) {
+    token_policy = *policy;
+    int apostrophes = policy->apostrophes == APOSTROPHE_KEEP;
+    for (int c = 0; c < 256; ++c) {
+        unsigned char folded = 0;
+        if ((c >= 'a' && c <= 'z') || (c >= '0' && c <= '9') || (c == '\'' && apostrophes)) {
+            folded = (unsigned char)c;
+        } else if (c >= 'A' && c <= 'Z') {
+            folded = (unsigned char)(c - 'A' + 'a');
+        }
+        token_fold[c] = folded;
+    }
+    if (policy->utf8_letters) {
+        tokenize_lyrics = tokenize_lyrics_utf8;
+        return "utf8-scalar";
+    }
+    tokenize_lyrics = tokenize_lyrics_ascii;
+#ifdef HAVE_X86_SIMD
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        classify_block = apostrophes ? classify_block_avx2 : classify_block_avx2_split;
+        return "avx2";
+    }
+    classify_block = apostrophes ? classify_block_sse2 : classify_block_sse2_split;
+    return "sse2";
+#else
+    classify_block = classify_block_scalar;
+    return "scalar";
+#endif
+}
+
+/*
+ * Tokeniza as letras, acumula contagem por palavra e atualiza o total geral
+ * segundo a política escolhida em tokenizer_init. A letra é recebida como
+ * intervalo de bytes.
+ */
+static void process_lyrics(HashTable *word_counts, const char *lyrics, size_t lyrics_len, CountType *total_words) {
+    TokenSink sink = {word_counts, total_words, NULL, NULL, NULL};
+    tokenize_lyrics(&sink, lyrics, lyrics_len);
+}
+
+/* Variante de process_lyrics que grava os ids dos tokens em vez de contá-los. */
+static void process_lyrics_ids(Interner *interner, const char *lyrics, size_t lyrics_len,
+                               CountType *total_words) {
+    TokenSink sink = {NULL, total_words, interner, NULL, NULL};
+    tokenize_lyrics(&sink, lyrics, lyrics_len);
+}
+
+/*
+ * Formato compacto de uma tabela de hash para envio via MPI: cabeçalho com a
+ * quantidade de entradas e o tamanho do bloco de chaves, seguido do vetor de
+ * deslocamentos (n + 1 posições), do vetor de contagens e das chaves
+ * concatenadas sem terminador.
+ */
+typedef struct {
+    char *data;
+    size_t size;
+} PackedTable;
+
+/* Maior mensagem individual usada para transferir uma tabela compactada. */
+#define PACKED_MESSAGE_LIMIT ((size_t)1 << 30)
+
+#define PACKED_HEADER_SIZE (2 * sizeof(uint64_t))
+
+/*
+ * Calcula quantos bytes um vetor de entradas ocupa no formato compacto. O
+ * total é arredondado para múltiplo de 8 para que buffers concatenados (como
+ * no MPI_Alltoallv do modo particionado) mantenham os vetores alinhados.
+ */
+static size_t packed_entries_size(const Entry *entries, size_t count) {
+    size_t blob_size = 0;
+    for (size_t i = 0; i < count; ++i) {
+        blob_size += entries[i].length;
+    }
+    size_t size = PACKED_HEADER_SIZE + (count + 1U) * sizeof(uint64_t) + count * sizeof(CountType) + blob_size;
+    return (size + 7U) & ~(size_t)7U;
+}
+
+/* Serializa um vetor de entradas em `dst`, que deve ter packed_entries_size bytes. */
+static void pack_entries(const Entry *entries, size_t count, char *dst) {
+    size_t offsets_size = (count + 1U) * sizeof(uint64_t);
+    size_t counts_size = count * sizeof(CountType);
+    uint64_t *offsets = (uint64_t *)(dst + PACKED_HEADER_SIZE);
+    CountType *counts = (CountType *)(dst + PACKED_HEADER_SIZE + offsets_size);
+    char *blob = dst + PACKED_HEADER_SIZE + offsets_size + counts_size;
+    uint64_t cursor = 0;
+    for (size_t i = 0; i < count; ++i) {
+        offsets[i] = cursor;
+        counts[i] = entries[i].value;
+        memcpy(blob + cursor, entries[i].key, entries[i].length);
+        cursor += entries[i].length;
+    }
+    offsets[count] = cursor;
+    uint64_t header[2] = {(uint64_t)count, cursor};
+    memcpy(dst, header, sizeof(header));
+}
+
+/* Serializa um vetor de entradas em um novo buffer. O chamador libera `out->data`. */
+static void pack_entry_array(const Entry *entries, size_t count, PackedTable *out) {
+    out->size = packed_entries_size(entries, count);
+    out->data = (char *)calloc(out->size, 1U);
+    if (!out->data) {
+        fprintf(stderr, "Failed to allocate %zu bytes for packed table\n", out->size);
+        MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
+    }
+    pack_entries(entries, count, out->data);
+}
+
+/* Serializa a tabela no formato compacto. O chamador libera `out->data`. */
+static void ht_pack(const HashTable *ht, PackedTable *out) {
+    size_t count = 0;
+    Entry *entries = ht_to_array(ht, &count);
+    pack_entry_array(entries, count, out);
+    free(entries);
+}
+
+/* Visão sobre as seções de uma tabela no formato compacto. */
+typedef struct {
+    uint64_t count;
+    const uint64_t *offsets;
+    const CountType *counts;
+    const char *blob;
+} PackedView;
+
+/* Localiza as seções de um buffer compacto, abortando se estiver truncado. */
+static PackedView packed_view(const char *data, size_t size) {
+    PackedView view = {0, NULL, NULL, NULL};
+    if (size < PACKED_HEADER_SIZE) {
+        return view;
+    }
+    uint64_t header[2];
+    memcpy(header, data, sizeof(header));
+    size_t offsets_size = (size_t)(header[0] + 1U) * sizeof(uint64_t);
+    size_t counts_size = (size_t)header[0] * sizeof(CountType);
+    if (PACKED_HEADER_SIZE + offsets_size + counts_size + header[1] > size) {
+        fprintf(stderr, "Received a truncated packed table\n");
+        MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
+    }
+    view.count = header[0];
+    view.offsets = (const uint64_t *)(data + PACKED_HEADER_SIZE);
+    view.counts = (const CountType *)(data + PACKED_HEADER_SIZE + offsets_size);
+    view.blob = data + PACKED_HEADER_SIZE + offsets_size + counts_size;
+    return view;
+}
+
+/* Mescla no destino as entradas de uma tabela recebida no formato compacto. */
+static void ht_merge_packed(HashTable *dest, const char *data, size_t size) {
+    PackedView view = packed_view(data, size);
+    ht_reserve(dest, dest->size + (size_t)view.count);
+    for (uint64_t i = 0; i < view.count; ++i) {
+        ht_put_len(dest, view.blob + view.offsets[i], (size_t)(view.offsets[i + 1] - view.offsets[i]),
+                   view.counts[i]);
+    }
+}
+
+/* Envia um buffer em uma ou mais mensagens de até PACKED_MESSAGE_LIMIT bytes. */
+static void send_packed(const PackedTable *packed, int dest, int tag, MPI_Comm comm) {
+    size_t sent = 0;
+    do {
+        size_t chunk = packed->size - sent;
+        if (chunk > PACKED_MESSAGE_LIMIT) {
+            chunk = PACKED_MESSAGE_LIMIT;
+        }
+        MPI_Send(packed->data + sent, (int)chunk, MPI_BYTE, dest, tag, comm);
+        rank_profile.counters[COUNTER_MESSAGES]++;
+        sent += chunk;
+    } while (sent < packed->size);
+}
+
+/*
+ * Recebe um buffer enviado por send_packed. O tamanho de cada mensagem é
+ * obtido com MPI_Probe/MPI_Get_count e o total vem do cabeçalho do formato.
+ */
+static void receive_packed(PackedTable *packed, int source, int tag, MPI_Comm comm) {
+    MPI_Status status;
+    int chunk = 0;
+    MPI_Probe(source, tag, comm, &status);
+    MPI_Get_count(&status, MPI_BYTE, &chunk);
+    packed->data = (char *)malloc(chunk > 0 ? (size_t)chunk : 1U);
+    if (!packed->data) {
+        fprintf(stderr, "Failed to allocate buffer for received table\n");
+        MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
+    }
+    MPI_Recv(packed->data, chunk, MPI_BYTE, source, tag, comm, MPI_STATUS_IGNORE);
+    packed->size = (size_t)chunk;
+    if ((size_t)chunk < PACKED_MESSAGE_LIMIT || packed->size < PACKED_HEADER_SIZE) {
+        return;
+    }
+    uint64_t header[2];
+    memcpy(header, packed->data, sizeof(header));
+    size_t total = PACKED_HEADER_SIZE + (size_t)(header[0] + 1U) * sizeof(uint64_t) +
+                   (size_t)header[0] * sizeof(CountType) + (size_t)header[1];
+    total = (total + 7U) & ~(size_t)7U;
+    char *tmp = (char *)realloc(packed->data, total);
+    if (!tmp) {
+        fprintf(stderr, "Failed to grow buffer for received table\n");
+        MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
+    }
+    packed->data = tmp;
+    while (packed->size < total) {
+        MPI_Probe(source, tag, comm, &status);
+        MPI_Get_count(&status, MPI_BYTE, &chunk);
+        MPI_Recv(packed->data + packed->size, chunk, MPI_BYTE, source, tag, comm, MPI_STATUS_IGNORE);
+        packed->size += (size_t)chunk;
+    }
+}
+
+/*
+ * Envia todas as entradas de uma tabela de hash para outro processo MPI em
+ * formato compacto. Retorna a quantidade de bytes transmitidos.
+ */
+static size_t send_hash_table(const HashTable *ht, int dest, int tag, MPI_Comm comm) {
+    PackedTable packed;
+    double started = phase_clock();
+    ht_pack(ht, &packed);
+    profile_add(PHASE_SERIALIZE, started);
+    started = phase_clock();
+    send_packed(&packed, dest, tag, comm);
+    profile_add(PHASE_COMMUNICATE, started);
+    size_t bytes = packed.size;
+    free(packed.data);
+    return bytes;
+}
+
+/*
+ * Recebe uma tabela de hash serializada e mescla os valores no destino.
+ * Retorna a quantidade de bytes recebidos.
+ */
+static size_t receive_hash_table(HashTable *dest, int source, int tag, MPI_Comm comm) {
+    PackedTable packed;
+    double started = phase_clock();
+    receive_packed(&packed, source, tag, comm);
+    profile_add(PHASE_COMMUNICATE, started);
+    started = phase_clock();
+    ht_merge_packed(dest, packed.data, packed.size);
+    profile_add(PHASE_MERGE, started);
+    size_t bytes = packed.size;
+    free(packed.data);
+    return bytes;
+}
+
+/* Estratégias de agregação das tabelas locais disponíveis via --reduce. */
+typedef enum {
+    REDUCE_TREE,
+    REDUCE_GATHER,
+    REDUCE_SHARD,
+    REDUCE_PIPELINE
+} ReduceMode;
+
+/*
+ * Agregação serial: o rank 0 recebe e mescla a tabela de cada processo, um
+ * de cada vez. Mantida para comparação com a redução em árvore. Os ranks que
+ * enviam suas tabelas as liberam em seguida. Retorna os bytes enviados.
+ */
+static long long reduce_tables_gather(LocalStats *stats, int rank, int world_size, MPI_Comm comm) {
+    long long bytes_sent = 0;
+    if (rank == 0) {
+        for (int source = 1; source < world_size; ++source) {
+            receive_hash_table(&stats->word_counts, source, 100, comm);
+            receive_hash_table(&stats->artist_counts, source, 200, comm);
+        }
+    } else {
+        bytes_sent += (long long)send_hash_table(&stats->word_counts, 0, 100, comm);
+        bytes_sent += (long long)send_hash_table(&stats->artist_counts, 0, 200, comm);
+        ht_free(&stats->word_counts);
+        ht_free(&stats->artist_counts);
+    }
+    return bytes_sent;
+}
+
+/*
+ * Redução em árvore binomial de uma única tabela, descrita em
+ * reduce_tables_tree. Ao final o rank 0 tem a tabela global. Retorna os
+ * bytes enviados.
+ */
+static long long reduce_table_tree(HashTable *table, int tag, int rank, int world_size, MPI_Comm comm) {
+    long long bytes_sent = 0;
+    for (int step = 1; step < world_size; step <<= 1) {
+        if (rank & step) {
+            bytes_sent += (long long)send_hash_table(table, rank - step, tag, comm);
+            ht_free(table);
+            break;
+        }
+        if (rank + step < world_size) {
+            receive_hash_table(table, rank + step, tag, comm);
+        }
+    }
+    return bytes_sent;
+}
+
+/*
+ * Redução em árvore binomial: na rodada k, cada rank com o bit k ligado envia
+ * suas tabelas (já contendo as dos seus filhos) para rank - 2^k e encerra sua
+ * participação. Assim o rank 0 termina com o resultado global após
+ * ceil(log2 P) rodadas, e o custo de mesclagem se distribui entre os
+ * processos em vez de se acumular no mestre. Retorna os bytes enviados.
+ */
+static long long reduce_tables_tree(LocalStats *stats, int rank, int world_size, MPI_Comm comm) {
+    long long bytes_sent = reduce_table_tree(&stats->word_counts, 100, rank, world_size, comm);
+    bytes_sent += reduce_table_tree(&stats->artist_counts, 200, rank, world_size, comm);
+    return bytes_sent;
+}
+
+/*
+ * Define o rank dono de uma chave no modo particionado. Usa os bits altos do
+ * hash porque os bits baixos indexam a tabela: se o dono viesse deles, todas
+ * as chaves de um fragmento cairiam nas mesmas posições da tabela de destino.
+ */
+static int shard_owner(uint64_t hash, int world_size) {
+    return (int)((hash >> 32) % (uint64_t)world_size);
+}
+
+/*
+ * Redistribui uma tabela local entre os processos: cada entrada é agrupada
+ * pelo rank dono da chave, os grupos são serializados no formato compacto e
+ * trocados com um único MPI_Alltoallv. Ao final, `table` contém apenas as
+ * chaves deste rank, já com as contagens globais. Com `by_artist`, as chaves
+ * são pares "artista\0palavra" e o dono é o do artista, de modo que todo o
+ * vocabulário de um artista fica no mesmo rank. Retorna os bytes enviados a
+ * outros processos.
+ */
+static long long shard_exchange(HashTable *table, int by_artist, int rank, int world_size, MPI_Comm comm) {
+    double started = phase_clock();
+    size_t count = 0;
+    Entry *entries = ht_to_array(table, &count);
+    int *owners = (int *)malloc((count ? count : 1U) * sizeof(int));
+    Entry *grouped = (Entry *)malloc((count ? count : 1U) * sizeof(Entry));
+    size_t *bucket_sizes = (size_t *)calloc((size_t)world_size, sizeof(size_t));
+    size_t *bucket_starts = (size_t *)calloc((size_t)world_size + 1U, sizeof(size_t));
+    int *send_counts = (int *)calloc((size_t)world_size, sizeof(int));
+    int *send_displs = (int *)calloc((size_t)world_size, sizeof(int));
+    int *recv_counts = (int *)calloc((size_t)world_size, sizeof(int));
+    int *recv_displs = (int *)calloc((size_t)world_size, sizeof(int));
+    if (!owners || !grouped || !bucket_sizes || !bucket_starts || !send_counts || !send_displs ||
+        !recv_counts || !recv_displs) {
+        fprintf(stderr, "Failed to allocate shard exchange buffers\n");
+        MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
+    }
+    for (size_t i = 0; i < count; ++i) {
+        uint64_t hash = by_artist ? hash_bytes(entries[i].key, artist_key_length(entries[i].key, entries[i].length))
+                                  : entries[i].hash;
+        owners[i] = shard_owner(hash, world_size);
+        bucket_sizes[owners[i]]++;
+    }
+    for (int r = 0; r < world_size; ++r) {
+        bucket_starts[r + 1] = bucket_starts[r] + bucket_sizes[r];
+        bucket_sizes[r] = 0;
+    }
+    for (size_t i = 0; i < count; ++i) {
+        int owner = owners[i];
+        grouped[bucket_starts[owner] + bucket_sizes[owner]++] = entries[i];
+    }
+
+    size_t send_total = 0;
+    for (int r = 0; r < world_size; ++r) {
+        size_t bytes = packed_entries_size(grouped + bucket_starts[r], bucket_sizes[r]);
+        if (send_total + bytes > (size_t)INT_MAX) {
+            fprintf(stderr, "Rank %d shard exchange exceeds the MPI message size limit\n", rank);
+            MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
+        }
+        send_displs[r] = (int)send_total;
+        send_counts[r] = (int)bytes;
+        send_total += bytes;
+    }
+    char *send_buf = (char *)calloc(send_total ? send_total : 1U, 1U);
+    if (!send_buf) {
+        fprintf(stderr, "Failed to allocate shard send buffer\n");
+        MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
+    }
+    for (int r = 0; r < world_size; ++r) {
+        pack_entries(grouped + bucket_starts[r], bucket_sizes[r], send_buf + send_displs[r]);
+    }
+    free(owners);
+    free(grouped);
+    free(entries);
+    ht_free(table);
+    profile_add(PHASE_SERIALIZE, started);
+
+    started = phase_clock();
+    MPI_Alltoall(send_counts, 1, MPI_INT, recv_counts, 1, MPI_INT, comm);
+    size_t recv_total = 0;
+    for (int r = 0; r < world_size; ++r) {
+        if (recv_total + (size_t)recv_counts[r] > (size_t)INT_MAX) {
+            fprintf(stderr, "Rank %d shard exchange exceeds the MPI message size limit\n", rank);
+            MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
+        }
+        recv_displs[r] = (int)recv_total;
+        recv_total += (size_t)recv_counts[r];
+    }
+    char *recv_buf = (char *)malloc(recv_total);
+    if (!recv_buf) {
+        fprintf(stderr, "Failed to allocate shard receive buffer\n");
+        MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
+    }
+    MPI_Alltoallv(send_buf, send_counts, send_displs, MPI_BYTE,
+                  recv_buf, recv_counts, recv_displs, MPI_BYTE, comm);
+    long long bytes_sent = (long long)(send_total - (size_t)send_counts[rank]);
+    rank_profile.counters[COUNTER_MESSAGES] += world_size - 1;
+    free(send_buf);
+    profile_add(PHASE_COMMUNICATE, started);
+
+    started = phase_clock();
+    ht_init(table, count);
+    for (int r = 0; r < world_size; ++r) {
+        ht_merge_packed(table, recv_buf + recv_displs[r], (size_t)recv_counts[r]);
+    }
+    profile_add(PHASE_MERGE, started);
+    free(recv_buf);
+    free(bucket_sizes);
+    free(bucket_starts);
+    free(send_counts);
+    free(send_displs);
+    free(recv_counts);
+    free(recv_displs);
+    return bytes_sent;
+}
+
+/*
+ * Envia ao rank 0 os candidatos de cada fragmento: todas as entradas quando
+ * `candidates` é 0 ou apenas as `candidates` maiores, o que basta porque o
+ * top-K global está contido na união dos top-K de fragmentos disjuntos.
+ * Retorna os bytes enviados.
+ */
+static long long collect_shard_candidates(HashTable *shard, size_t candidates, int tag,
+                                          int rank, int world_size, MPI_Comm comm) {
+    size_t count = 0;
+    double started = phase_clock();
+    Entry *entries = select_top_entries(shard, candidates, &count);
+    profile_add(PHASE_SORT, started);
+    if (rank == 0) {
+        /* O fragmento do mestre também é reduzido aos seus candidatos, de modo
+         * que o rank 0 só mescla P x K entradas. */
+        if (candidates > 0) {
+            HashTable kept;
+            ht_init(&kept, count * 2U);
+            for (size_t i = 0; i < count; ++i) {
+                ht_put_hashed(&kept, entries[i].key, entries[i].length, entries[i].hash, entries[i].value);
+            }
+            free(entries);
+            ht_free(shard);
+            *shard = kept;
+        } else {
+            free(entries);
+        }
+        for (int source = 1; source < world_size; ++source) {
+            receive_hash_table(shard, source, tag, comm);
+        }
+        return 0;
+    }
+    PackedTable packed;
+    started = phase_clock();
+    pack_entry_array(entries, count, &packed);
+    free(entries);
+    profile_add(PHASE_SERIALIZE, started);
+    started = phase_clock();
+    send_packed(&packed, 0, tag, comm);
+    profile_add(PHASE_COMMUNICATE, started);
+    long long bytes_sent = (long long)packed.size;
+    free(packed.data);
+    ht_free(shard);
+    return bytes_sent;
+}
+
+/*
+ * Agregação particionada por hash: cada palavra e cada artista passam a ter
+ * um rank dono, que acumula as contagens globais do seu fragmento após um
+ * MPI_Alltoallv. Somente os candidatos ao ranking seguem para o rank 0, o que
+ * limita a memória do mestre quando há limite de itens. Retorna os bytes
+ * enviados.
+ */
+static long long reduce_tables_shard(LocalStats *stats, size_t word_candidates, size_t artist_candidates,
+                                     int rank, int world_size, MPI_Comm comm) {
+    long long bytes_sent = 0;
+    bytes_sent += shard_exchange(&stats->word_counts, 0, rank, world_size, comm);
+    bytes_sent += shard_exchange(&stats->artist_counts, 0, rank, world_size, comm);
+    bytes_sent += collect_shard_candidates(&stats->word_counts, word_candidates, 100, rank, world_size, comm);
+    bytes_sent += collect_shard_candidates(&stats->artist_counts, artist_candidates, 200, rank, world_size, comm);
+    return bytes_sent;
+}
+
+#define PIPELINE_TAG 500
+#define PIPELINE_PREFIX_SIZE (2 * sizeof(uint64_t))
+
+/*
+ * Agregação em pipeline (--reduce pipeline): ao fim de cada bloco de trabalho
+ * os ranks serializam as tabelas locais de palavras e artistas em um
+ * fragmento, enviado ao rank 0 com MPI_Isend, e as esvaziam para seguir
+ * contando; entre os seus próprios blocos o rank 0 mescla os fragmentos que
+ * já chegaram. Assim a comunicação e a mesclagem se sobrepõem à leitura, e ao
+ * fim do cômputo resta apenas o último fragmento de cada rank. Um fragmento
+ * começa com dois uint64, o seu tamanho total e o da tabela de palavras,
+ * seguidos das duas tabelas no formato compacto; uma mensagem vazia marca o
+ * fim dos envios de um rank.
+ */
+typedef struct {
+    int active;
+    int rank;
+    int finished_ranks;
+    MPI_Comm comm;
+    ByteBuffer requests;
+    ByteBuffer fragments;
+    long long bytes_sent;
+} ReducePipeline;
+
+static ReducePipeline reduce_pipeline;
+
+static void pipeline_begin(int rank, MPI_Comm comm) {
+    memset(&reduce_pipeline, 0, sizeof(reduce_pipeline));
+    reduce_pipeline.active = 1;
+    reduce_pipeline.rank = rank;
+    reduce_pipeline.comm = comm;
+}
+
+/* Libera os fragmentos já entregues; com `wait`, aguarda todos os envios. */
+static void pipeline_release(int wait) {
+    ReducePipeline *pipeline = &reduce_pipeline;
+    int count = (int)(pipeline->requests.size / sizeof(MPI_Request));
+    int done = 1;
+    if (wait) {
+        MPI_Waitall(count, (MPI_Request *)pipeline->requests.data, MPI_STATUSES_IGNORE);
+    } else if (count > 0) {
+        MPI_Testall(count, (MPI_Request *)pipeline->requests.data, &done, MPI_STATUSES_IGNORE);
+    }
+    if (!done) {
+        return;
+    }
+    char **fragments = (char **)pipeline->fragments.data;
+    for (size_t i = 0; i < pipeline->fragments.size / sizeof(char *); ++i) {
+        free(fragments[i]);
+    }
+    pipeline->requests.size = 0;
+    pipeline->fragments.size = 0;
+}
+
+/* Serializa as tabelas locais em um fragmento, inicia o envio e as esvazia. */
+static void pipeline_send(LocalStats *stats) {
+    ReducePipeline *pipeline = &reduce_pipeline;
+    double started = phase_clock();
+    size_t word_count = 0;
+    size_t artist_count = 0;
+    Entry *words = ht_to_array(&stats->word_counts, &word_count);
+    Entry *artists = ht_to_array(&stats->artist_counts, &artist_count);
+    uint64_t prefix[2] = {0, packed_entries_size(words, word_count)};
+    prefix[0] = PIPELINE_PREFIX_SIZE + prefix[1] + packed_entries_size(artists, artist_count);
+    char *fragment = (char *)calloc((size_t)prefix[0], 1U);
+    if (!fragment) {
+        fprintf(stderr, "Failed to allocate %llu bytes for a pipeline fragment\n", (unsigned long long)prefix[0]);
+        MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
+    }
+    memcpy(fragment, prefix, sizeof(prefix));
+    pack_entries(words, word_count, fragment + PIPELINE_PREFIX_SIZE);
+    pack_entries(artists, artist_count, fragment + PIPELINE_PREFIX_SIZE + prefix[1]);
+    free(words);
+    free(artists);
+    ht_clear(&stats->word_counts);
+    ht_clear(&stats->artist_counts);
+    profile_add(PHASE_SERIALIZE, started);
+
+    started = phase_clock();
+    size_t sent = 0;
+    while (sent < prefix[0]) {
+        size_t chunk = (size_t)prefix[0] - sent;
+        if (chunk > PACKED_MESSAGE_LIMIT) {
+            chunk = PACKED_MESSAGE_LIMIT;
+        }
+        MPI_Request request;
+        MPI_Isend(fragment + sent, (int)chunk, MPI_BYTE, 0, PIPELINE_TAG, pipeline->comm, &request);
+        byte_buffer_append(&pipeline->requests, &request, sizeof(request));
+        rank_profile.counters[COUNTER_MESSAGES]++;
+        sent += chunk;
+    }
+    byte_buffer_append(&pipeline->fragments, &fragment, sizeof(fragment));
+    pipeline->bytes_sent += (long long)prefix[0];
+    profile_add(PHASE_COMMUNICATE, started);
+}
+
+/*
+ * Rank 0: recebe a mensagem de `source` já detectada por `status` e mescla o
+ * fragmento nas tabelas locais, ou registra o fim dos envios do rank.
+ */
+static void pipeline_receive(LocalStats *stats, const MPI_Status *status) {
+    ReducePipeline *pipeline = &reduce_pipeline;
+    int source = status->MPI_SOURCE;
+    int chunk = 0;
+    MPI_Get_count(status, MPI_BYTE, &chunk);
+    double started = phase_clock();
+    char *fragment = (char *)malloc(chunk > 0 ? (size_t)chunk : 1U);
+    if (!fragment) {
+        fprintf(stderr, "Failed to allocate buffer for a pipeline fragment\n");
+        MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
+    }
+    MPI_Recv(fragment, chunk, MPI_BYTE, source, PIPELINE_TAG, pipeline->comm, MPI_STATUS_IGNORE);
+    if (chunk == 0) {
+        pipeline->finished_ranks++;
+        free(fragment);
+        profile_add(PHASE_COMMUNICATE, started);
+        return;
+    }
+    uint64_t prefix[2];
+    memcpy(prefix, fragment, sizeof(prefix));
+    size_t received = (size_t)chunk;
+    if (received < prefix[0]) {
+        char *tmp = (char *)realloc(fragment, (size_t)prefix[0]);
+        if (!tmp) {
+            fprintf(stderr, "Failed to grow buffer for a pipeline fragment\n");
+            MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
+        }
+        fragment = tmp;
+    }
+    /* As partes seguintes vêm da mesma origem, que não ultrapassa a ordem. */
+    while (received < prefix[0]) {
+        MPI_Status part;
+        MPI_Probe(source, PIPELINE_TAG, pipeline->comm, &part);
+        MPI_Get_count(&part, MPI_BYTE, &chunk);
+        MPI_Recv(fragment + received, chunk, MPI_BYTE, source, PIPELINE_TAG, pipeline->comm, MPI_STATUS_IGNORE);
+        received += (size_t)chunk;
+    }
+    profile_add(PHASE_COMMUNICATE, started);
+    started = phase_clock();
+    ht_merge_packed(&stats->word_counts, fragment + PIPELINE_PREFIX_SIZE, (size_t)prefix[1]);
+    ht_merge_packed(&stats->artist_counts, fragment + PIPELINE_PREFIX_SIZE + prefix[1],
+                    (size_t)(prefix[0] - PIPELINE_PREFIX_SIZE - prefix[1]));
+    profile_add(PHASE_MERGE, started);
+    free(fragment);
+}
+
+/*
+ * Chamado pela thread principal após cada bloco de trabalho: os demais ranks
+ * enviam o que contaram no bloco e o rank 0 mescla os fragmentos pendentes.
+ */
+static void pipeline_flush(LocalStats *stats) {
+    ReducePipeline *pipeline = &reduce_pipeline;
+    if (!pipeline->active) {
+        return;
+    }
+    if (pipeline->rank != 0) {
+        if (stats->word_counts.size > 0 || stats->artist_counts.size > 0) {
+            pipeline_send(stats);
+        }
+        pipeline_release(0);
+        return;
+    }
+    int pending = 1;
+    while (pending) {
+        MPI_Status status;
+        MPI_Iprobe(MPI_ANY_SOURCE, PIPELINE_TAG, pipeline->comm, &pending, &status);
+        if (pending) {
+            pipeline_receive(stats, &status);
+        }
+    }
+}
+
+/*
+ * Conclui a agregação em pipeline: cada rank envia o último fragmento e a
+ * marca de fim, e o rank 0 mescla o que falta até receber a marca de todos.
+ * Retorna os bytes enviados ao longo da execução.
+ */
+static long long reduce_tables_pipeline(LocalStats *stats, int rank, int world_size, MPI_Comm comm) {
+    ReducePipeline *pipeline = &reduce_pipeline;
+    if (rank != 0) {
+        pipeline_flush(stats);
+        double started = phase_clock();
+        MPI_Send(NULL, 0, MPI_BYTE, 0, PIPELINE_TAG, comm);
+        rank_profile.counters[COUNTER_MESSAGES]++;
+        pipeline_release(1);
+        profile_add(PHASE_COMMUNICATE, started);
+    } else {
+        while (pipeline->finished_ranks < world_size - 1) {
+            MPI_Status status;
+            MPI_Probe(MPI_ANY_SOURCE, PIPELINE_TAG, comm, &status);
+            pipeline_receive(stats, &status);
+        }
+    }
+    free(pipeline->requests.data);
+    free(pipeline->fragments.data);
+    pipeline->active = 0;
+    return pipeline->bytes_sent;
+}
+
+/* Operação do MPI_Reduce de --approx: soma cada par de resumos com approx_merge. */
+static void approx_reduce_op(void *in, void *inout, int *len, MPI_Datatype *datatype) {
+    (void)datatype;
+    ApproxSketch *src = (ApproxSketch *)in;
+    ApproxSketch *dest = (ApproxSketch *)inout;
+    for (int i = 0; i < *len; ++i) {
+        approx_merge(&dest[i], &src[i]);
+    }
+}
+
+/*
+ * Redução de --approx: os resumos de palavras e de artistas, de tamanho fixo,
+ * seguem juntos em um único MPI_Reduce com uma operação própria, no lugar da
+ * troca de tabelas de tamanho variável. No rank 0, os candidatos resultantes
+ * preenchem `word_counts` e `artist_counts` com as contagens estimadas.
+ * Retorna os bytes enviados, contando o envio do resumo uma vez por rank.
+ */
+static long long reduce_tables_approx(LocalStats *stats, int rank, MPI_Comm comm) {
+    double started = phase_clock();
+    MPI_Datatype sketch_type;
+    MPI_Op merge_op;
+    MPI_Type_contiguous((int)sizeof(ApproxSketch), MPI_BYTE, &sketch_type);
+    MPI_Type_commit(&sketch_type);
+    MPI_Op_create(approx_reduce_op, 1, &merge_op);
+    MPI_Reduce(rank == 0 ? MPI_IN_PLACE : stats->approx, stats->approx, APPROX_SKETCHES, sketch_type, merge_op, 0,
+               comm);
+    MPI_Op_free(&merge_op);
+    MPI_Type_free(&sketch_type);
+    profile_add(PHASE_COMMUNICATE, started);
+    if (rank != 0) {
+        rank_profile.counters[COUNTER_MESSAGES]++;
+        return (long long)(APPROX_SKETCHES * sizeof(ApproxSketch));
+    }
+    started = phase_clock();
+    approx_to_table(&stats->approx[APPROX_WORDS], &stats->word_counts);
+    approx_to_table(&stats->approx[APPROX_ARTISTS], &stats->artist_counts);
+    profile_add(PHASE_MERGE, started);
+    return 0;
+}
+
+/* Ordena pares por artista e, dentro de cada artista, como artist_word_row_compare. */
+static int artist_pair_compare(const void *a, const void *b) {
+    const ArtistWordRow *ra = (const ArtistWordRow *)a;
+    const ArtistWordRow *rb = (const ArtistWordRow *)b;
+    size_t common = ra->artist_length < rb->artist_length ? ra->artist_length : rb->artist_length;
+    int order = memcmp(ra->artist, rb->artist, common);
+    if (order != 0) {
+        return order;
+    }
+    if (ra->artist_length != rb->artist_length) {
+        return ra->artist_length < rb->artist_length ? -1 : 1;
+    }
+    return artist_word_row_compare(a, b);
+}
+
+/*
+ * Rank dono: resume o vocabulário de cada artista da tabela de pares já
+ * particionada em uma entrada de `rows` com a chave "artista\0" seguida do
+ * restante da linha de artist_stats.csv: músicas (das marcas de música),
+ * total de palavras, palavras distintas e as `top_words` mais frequentes.
+ */
+static void artist_stats_rows(const HashTable *artist_words, size_t top_words, HashTable *rows) {
+    size_t count = 0;
+    Entry *entries = ht_to_array(artist_words, &count);
+    ArtistWordRow *pairs = (ArtistWordRow *)malloc((count ? count : 1U) * sizeof(ArtistWordRow));
+    if (!pairs) {
+        fprintf(stderr, "Failed to allocate artist statistics rows\n");
+        MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
+    }
+    for (size_t i = 0; i < count; ++i) {
+        size_t artist_length = artist_key_length(entries[i].key, entries[i].length);
+        size_t word_start = artist_length < entries[i].length ? artist_length + 1U : artist_length;
+        pairs[i].artist = entries[i].key;
+        pairs[i].artist_length = artist_length;
+        pairs[i].word = entries[i].key + word_start;
+        pairs[i].word_length = entries[i].length - word_start;
+        pairs[i].count = entries[i].value;
+    }
+    qsort(pairs, count, sizeof(ArtistWordRow), artist_pair_compare);
+
+    ByteBuffer line = {0};
+    ByteBuffer top = {0};
+    size_t begin = 0;
+    while (begin < count) {
+        const ArtistWordRow *first = &pairs[begin];
+        CountType songs = 0;
+        CountType total = 0;
+        CountType distinct = 0;
+        size_t listed = 0;
+        size_t end = begin;
+        top.size = 0;
+        for (; end < count && pairs[end].artist_length == first->artist_length &&
+               memcmp(pairs[end].artist, first->artist, first->artist_length) == 0;
+             ++end) {
+            if (pairs[end].word_length == 0) {
+                songs += pairs[end].count;
+                continue;
+            }
+            total += pairs[end].count;
+            distinct++;
+            if (listed++ < top_words) {
+                if (top.size > 0) {
+                    byte_buffer_append(&top, " ", 1);
+                }
+                byte_buffer_append(&top, pairs[end].word, pairs[end].word_length);
+                byte_buffer_append(&top, ":", 1);
+                append_decimal(&top, pairs[end].count, "", 0);
+            }
+        }
+        line.size = 0;
+        byte_buffer_append(&line, first->artist, first->artist_length);
+        byte_buffer_append(&line, "\0,", 2);
+        append_decimal(&line, songs, ",", 1);
+        append_decimal(&line, total, ",", 1);
+        append_decimal(&line, distinct, ",", 1);
+        append_csv_field(&line, top.data, top.size);
+        byte_buffer_append(&line, "\r\n", 2);
+        ht_put_len(rows, line.data, line.size, 1);
+        begin = end;
+    }
+    free(line.data);
+    free(top.data);
+    free(pairs);
+    free(entries);
+}
+
+/*
+ * Estatísticas de vocabulário por artista (--artist-stats): os pares
+ * artista/palavra vão para o rank dono de cada artista com um MPI_Alltoallv,
+ * cada dono resume os seus artistas e as linhas resumidas, uma por artista,
+ * seguem para o rank 0 em árvore. Assim o mestre guarda apenas as linhas, e
+ * não o vocabulário de todos os artistas. Depois da troca, `artist_words`
+ * contém o fragmento do rank, que --per-artist ainda pode reduzir. Retorna os
+ * bytes enviados.
+ */
+static long long reduce_artist_stats(LocalStats *stats, size_t top_words, HashTable *rows, int rank, int world_size,
+                                     MPI_Comm comm) {
+    long long bytes_sent = shard_exchange(&stats->artist_words, 1, rank, world_size, comm);
+    double started = phase_clock();
+    ht_init(rows, 1024);
+    artist_stats_rows(&stats->artist_words, top_words, rows);
+    profile_add(PHASE_SORT, started);
+    bytes_sent += reduce_table_tree(rows, 700, rank, world_size, comm);
+    return bytes_sent;
+}
+
+/* Ordena as linhas de artist_stats.csv pelo nome do artista, como strcmp. */
+static int artist_stats_row_compare(const void *a, const void *b) {
+    const Entry *ea = (const Entry *)a;
+    const Entry *eb = (const Entry *)b;
+    return strcmp(ea->key, eb->key);
+}
+
+/* Grava artist_stats.csv a partir das linhas reunidas no rank 0. */
+static void write_artist_stats_csv(const HashTable *rows, const char *filepath) {
+    size_t count = 0;
+    Entry *entries = ht_to_array(rows, &count);
+    qsort(entries, count, sizeof(Entry), artist_stats_row_compare);
+    ByteBuffer out = {0};
+    const char header[] = "artist,songs,total_words,distinct_words,top_words\r\n";
+    byte_buffer_append(&out, header, sizeof(header) - 1U);
+    for (size_t i = 0; i < count; ++i) {
+        size_t artist_length = artist_key_length(entries[i].key, entries[i].length);
+        append_csv_field(&out, entries[i].key, artist_length);
+        byte_buffer_append(&out, entries[i].key + artist_length + 1U, entries[i].length - artist_length - 1U);
+    }
+    FILE *fp = fopen(filepath, "wb");
+    if (!fp || fwrite(out.data, 1, out.size, fp) != out.size) {
+        fprintf(stderr, "Failed to write output file %s: %s\n", filepath, strerror(errno));
+    }
+    if (fp) {
+        fclose(fp);
+    }
+    free(out.data);
+    free(entries);
+}
+
+/* Ordena as chaves "artista\0d" de --sentiment pelo artista, como strcmp, e pelo rótulo. */
+static int artist_sentiment_compare(const void *a, const void *b) {
+    const Entry *ea = (const Entry *)a;
+    const Entry *eb = (const Entry *)b;
+    int order = strcmp(ea->key, eb->key);
+    if (order != 0) {
+        return order;
+    }
+    return (unsigned char)ea->key[ea->length - 1U] - (unsigned char)eb->key[eb->length - 1U];
+}
+
+/*
+ * Grava sentiment_by_artist.csv (artist,positive,neutral,negative) a partir
+ * das contagens por artista e rótulo reunidas no rank 0.
+ */
+static void write_sentiment_by_artist_csv(const HashTable *artist_sentiment, const char *filepath) {
+    size_t count = 0;
+    Entry *entries = ht_to_array(artist_sentiment, &count);
+    qsort(entries, count, sizeof(Entry), artist_sentiment_compare);
+    ByteBuffer out = {0};
+    const char header[] = "artist,positive,neutral,negative\r\n";
+    byte_buffer_append(&out, header, sizeof(header) - 1U);
+    size_t begin = 0;
+    while (begin < count) {
+        size_t artist_length = entries[begin].length - 2U;
+        CountType labels[SENTIMENT_AMBIGUOUS] = {0, 0, 0};
+        size_t end = begin;
+        for (; end < count && entries[end].length == entries[begin].length &&
+               memcmp(entries[end].key, entries[begin].key, artist_length) == 0;
+             ++end) {
+            labels[entries[end].key[artist_length + 1U] - '0'] = entries[end].value;
+        }
+        append_csv_field(&out, entries[begin].key, artist_length);
+        byte_buffer_append(&out, ",", 1);
+        append_decimal(&out, labels[SENTIMENT_POSITIVE], ",", 1);
+        append_decimal(&out, labels[SENTIMENT_NEUTRAL], ",", 1);
+        append_decimal(&out, labels[SENTIMENT_NEGATIVE], "\r\n", 2);
+        begin = end;
+    }
+    FILE *fp = fopen(filepath, "wb");
+    if (!fp || fwrite(out.data, 1, out.size, fp) != out.size) {
+        fprintf(stderr, "Failed to write output file %s: %s\n", filepath, strerror(errno));
+    }
+    if (fp) {
+        fclose(fp);
+    }
+    free(out.data);
+    free(entries);
+}
+
+/*
+ * Grava sentiment_totals.json com os mesmos bytes de json.dump(..., indent=2)
+ * em scripts/sentiment_classifier.py, sem quebra de linha final.
+ */
+static void write_sentiment_totals_json(const CountType *totals, const char *filepath) {
+    FILE *fp = fopen(filepath, "wb");
+    if (!fp) {
+        fprintf(stderr, "Failed to write output file %s: %s\n", filepath, strerror(errno));
+        return;
+    }
+    fprintf(fp, "{\n");
+    for (int label = 0; label < SENTIMENT_AMBIGUOUS; ++label) {
+        fprintf(fp, "  \"%s\": %lld%s\n", sentiment_labels[label], (long long)totals[label],
+                label + 1 < SENTIMENT_AMBIGUOUS ? "," : "");
+    }
+    fprintf(fp, "}");
+    fclose(fp);
+}
+
+/* Estratégia de gravação de word_counts.csv e top_artists.csv. */
+typedef enum {
+    WRITE_SERIAL,
+    WRITE_MPIIO
+} WriteMode;
+
+/*
+ * Grava uma tabela ordenada com todos os processos: o rank 0 divide as
+ * entradas em P fatias contíguas de tamanho parecido, distribui cada uma no
+ * formato compacto com MPI_Scatterv, e cada rank formata a sua fatia e a
+ * grava no deslocamento correspondente com write_rows_parallel, preservando
+ * a ordem global. Só o rank 0 precisa fornecer `entries`. Retorna os bytes
+ * enviados.
+ */
+static long long write_table_parallel(const Entry *entries, size_t count, const char *filepath,
+                                      const char *key_header, int limit, int rank, int world_size,
+                                      MPI_Comm comm) {
+    int *sizes = NULL;
+    int *displs = NULL;
+    char *packed = NULL;
+    size_t first[2] = {0, 0};
+    long long bytes_sent = 0;
+    if (rank == 0) {
+        size_t items = limited_count(count, limit);
+        size_t total_bytes = 0;
+        for (size_t i = 0; i < items; ++i) {
+            total_bytes += entries[i].length + 8U;
+        }
+        sizes = (int *)calloc((size_t)world_size, sizeof(int));
+        displs = (int *)calloc((size_t)world_size, sizeof(int));
+        size_t *bounds = (size_t *)calloc((size_t)world_size + 1U, sizeof(size_t));
+        if (!sizes || !displs || !bounds) {
+            fprintf(stderr, "Failed to allocate output partition\n");
+            MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
+        }
+        /* Fronteiras escolhidas pelo volume aproximado de bytes de cada fatia. */
+        size_t cursor = 0;
+        size_t accumulated = 0;
+        for (int part = 1; part < world_size; ++part) {
+            size_t target = total_bytes / (size_t)world_size * (size_t)part;
+            while (cursor < items && accumulated < target) {
+                accumulated += entries[cursor++].length + 8U;
+            }
+            bounds[part] = cursor;
+        }
+        bounds[world_size] = items;
+        size_t packed_total = 0;
+        for (int part = 1; part < world_size; ++part) {
+            packed_total += packed_entries_size(entries + bounds[part], bounds[part + 1] - bounds[part]);
+        }
+        if (packed_total > (size_t)INT_MAX) {
+            fprintf(stderr, "Output table is too large to distribute (%zu bytes)\n", packed_total);
+            MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
+        }
+        packed = (char *)calloc(packed_total > 0 ? packed_total : 1U, 1U);
+        if (!packed) {
+            fprintf(stderr, "Failed to allocate %zu bytes for output partition\n", packed_total);
+            MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
+        }
+        size_t offset = 0;
+        for (int part = 1; part < world_size; ++part) {
+            size_t part_count = bounds[part + 1] - bounds[part];
+            size_t part_size = packed_entries_size(entries + bounds[part], part_count);
+            pack_entries(entries + bounds[part], part_count, packed + offset);
+            sizes[part] = (int)part_size;
+            displs[part] = (int)offset;
+            offset += part_size;
+        }
+        first[1] = bounds[1];
+        bytes_sent = (long long)packed_total;
+        free(bounds);
+    }
+
+    int local_size = 0;
+    MPI_Scatter(sizes, 1, MPI_INT, &local_size, 1, MPI_INT, 0, comm);
+    char *local = (char *)malloc(local_size > 0 ? (size_t)local_size : 1U);
+    if (!local) {
+        fprintf(stderr, "Rank %d failed to allocate %d bytes for output rows\n", rank, local_size);
+        MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
+    }
+    MPI_Scatterv(packed, sizes, displs, MPI_BYTE, local, local_size, MPI_BYTE, 0, comm);
+
+    ByteBuffer rows = {0};
+    if (rank == 0) {
+        for (size_t i = first[0]; i < first[1]; ++i) {
+            append_quoted_entry(&rows, entries[i].key, entries[i].length, entries[i].value);
+        }
+    } else {
+        PackedView view = packed_view(local, (size_t)local_size);
+        for (uint64_t i = 0; i < view.count; ++i) {
+            append_quoted_entry(&rows, view.blob + view.offsets[i], (size_t)(view.offsets[i + 1] - view.offsets[i]),
+                                view.counts[i]);
+        }
+    }
+    char header[160];
+    snprintf(header, sizeof(header), "%s,count\n", key_header);
+    write_rows_parallel(filepath, header, &rows, rank, comm);
+
+    free(rows.data);
+    free(local);
+    free(packed);
+    free(sizes);
+    free(displs);
+    return bytes_sent;
+}
+
+/* Obtém o tamanho do arquivo de entrada em bytes. */
+static long long get_file_size(const char *path) {
+    struct stat st;
+    if (stat(path, &st) != 0) {
+        return -1;
+    }
+    return (long long)st.st_size;
+}
+
+/* Cria o diretório de saída caso ele não exista. */
+static void ensure_output_dir(const char *path) {
+    struct stat st;
+    if (stat(path, &st) == 0) {
+        return;
+    }
+    if (MKDIR(path) != 0 && errno != EEXIST) {
+        fprintf(stderr, "Failed to create directory %s: %s\n", path, strerror(errno));
+    }
+}
+
+/*
+ * Cria diretórios recursivamente, garantindo que todos os níveis do caminho
+ * existam antes do uso. Retorna 0 em sucesso e -1 em caso de erro.
+ */
+static int ensure_directory_recursive(const char *path) {
+    if (!path || !*path) {
+        return 0;
+    }
+    size_t len = strlen(path);
+    if (len >= PATH_MAX) {
+        errno = ENAMETOOLONG;
+        return -1;
+    }
+    char buffer[PATH_MAX];
+    memcpy(buffer, path, len + 1);
+    for (size_t i = 1; i < len; ++i) {
+        if (buffer[i] == '/' || buffer[i] == '\\') {
+            char saved = buffer[i];
+            buffer[i] = '\0';
+            if (buffer[0] != '\0' && strcmp(buffer, ".") != 0) {
+                if (MKDIR(buffer) != 0 && errno != EEXIST) {
+                    buffer[i] = saved;
+                    return -1;
+                }
+            }
+            buffer[i] = saved;
+        }
+    }
+    if (MKDIR(buffer) != 0 && errno != EEXIST) {
+        return -1;
+    }
+    return 0;
+}
+
+/*
+ * Normaliza o nome do cabeçalho para servir como base de nome de arquivo,
+ * substituindo caracteres problemáticos por sublinhados.
+ */
+static void sanitize_header_name(const char *input, char *output, size_t output_len) {
+    if (!output || output_len == 0) {
+        return;
+    }
+    size_t j = 0;
+    if (input) {
+        for (size_t i = 0; input[i] != '\0'; ++i) {
+            unsigned char c = (unsigned char)input[i];
+            if (c == '\n' || c == '\r') {
+                continue;
+            }
+            if (isspace(c)) {
+                if (j + 1 < output_len) {
+                    output[j++] = '_';
+                }
+            } else if (isalnum(c) || c == '-' || c == '.' || c == '_') {
+                if (j + 1 < output_len) {
+                    output[j++] = (char)c;
+                }
+            } else {
+                if (j + 1 < output_len) {
+                    output[j++] = '_';
+                }
+            }
+        }
+    }
+    if (j == 0) {
+        const char *fallback = "col";
+        for (size_t i = 0; fallback[i] != '\0' && j + 1 < output_len; ++i) {
+            output[j++] = fallback[i];
+        }
+    }
+    output[j] = '\0';
+}
+
+/*
+ * Lê um registro completo do CSV, respeitando quebras de linha dentro de
+ * campos entre aspas. Retorna o total de bytes lidos ou -1 no fim do arquivo.
+ */
+static ssize_t read_csv_record(FILE *fp, char **buffer, size_t *buf_size) {
+    if (!fp) {
         return -1;
     }
-    char buffer[PATH_MAX];
-    memcpy(buffer, path, len + 1);
-    for (size_t i = 1; i < len; ++i) {
-        if (buffer[i] == '/' || buffer[i] == '\\') {
-            char saved = buffer[i];
-            buffer[i] = '\0';
-            if (buffer[0] != '\0' && strcmp(buffer, ".") != 0) {
-                if (MKDIR(buffer) != 0 && errno != EEXIST) {
-                    buffer[i] = saved;
-                    return -1;
-                }
-            }
-            buffer[i] = saved;
+    if (!buffer || !buf_size) {
+        return -1;
+    }
+    if (!*buffer || *buf_size == 0) {
+        *buf_size = 1024;
+        *buffer = (char *)malloc(*buf_size);
+        if (!*buffer) {
+            fprintf(stderr, "Failed to allocate CSV buffer\n");
+            return -1;
+        }
+    }
+    size_t pos = 0;
+    int in_quotes = 0;
+    while (1) {
+        int ch = fgetc(fp);
+        if (ch == EOF) {
+            if (pos == 0) {
+                return -1;
+            }
+            break;
+        }
+        if (pos + 2 >= *buf_size) {
+            size_t new_size = *buf_size * 2U;
+            char *tmp = (char *)realloc(*buffer, new_size);
+            if (!tmp) {
+                fprintf(stderr, "Failed to grow CSV buffer\n");
+                return -1;
+            }
+            *buffer = tmp;
+            *buf_size = new_size;
+        }
+        (*buffer)[pos++] = (char)ch;
+        if (ch == '"') {
+            if (!in_quotes) {
+                in_quotes = 1;
+            } else {
+                int next = fgetc(fp);
+                if (next == '"') {
+                    if (pos + 1 >= *buf_size) {
+                        size_t new_size = *buf_size * 2U;
+                        char *tmp = (char *)realloc(*buffer, new_size);
+                        if (!tmp) {
+                            fprintf(stderr, "Failed to grow CSV buffer\n");
+                            return -1;
+                        }
+                        *buffer = tmp;
+                        *buf_size = new_size;
+                    }
+                    (*buffer)[pos++] = '"';
+                } else {
+                    if (next != EOF) {
+                        ungetc(next, fp);
+                    }
+                    in_quotes = 0;
+                }
+            }
+        } else if ((ch == '\n' || ch == '\r') && !in_quotes) {
+            if (ch == '\r') {
+                int next = fgetc(fp);
+                if (next == '\n') {
+                    if (pos + 1 >= *buf_size) {
+                        size_t new_size = *buf_size * 2U;
+                        char *tmp = (char *)realloc(*buffer, new_size);
+                        if (!tmp) {
+                            fprintf(stderr, "Failed to grow CSV buffer\n");
+                            return -1;
+                        }
+                        *buffer = tmp;
+                        *buf_size = new_size;
+                    }
+                    (*buffer)[pos++] = (char)next;
+                } else if (next != EOF) {
+                    ungetc(next, fp);
+                }
+            }
+            break;
+        }
+    }
+    (*buffer)[pos] = '\0';
+    return (ssize_t)pos;
+}
+
+/*
+ * Devolve o índice em [first, last] que marca o início da parte `part` de
+ * `parts`, equilibrando as partes pelo volume acumulado em `offsets` (um
+ * vetor de deslocamentos não decrescente, com uma posição por registro).
+ */
+static uint64_t offsets_split_point(const uint64_t *offsets, uint64_t first, uint64_t last, int part, int parts) {
+    if (part <= 0) {
+        return first;
+    }
+    if (part >= parts) {
+        return last;
+    }
+    uint64_t begin_bytes = offsets[first];
+    uint64_t end_bytes = offsets[last];
+    uint64_t target = begin_bytes + (end_bytes - begin_bytes) / (uint64_t)parts * (uint64_t)part +
+                      (end_bytes - begin_bytes) % (uint64_t)parts * (uint64_t)part / (uint64_t)parts;
+    uint64_t low = first;
+    uint64_t high = last;
+    while (low < high) {
+        uint64_t middle = low + (high - low) / 2U;
+        if (offsets[middle] < target) {
+            low = middle + 1U;
+        } else {
+            high = middle;
+        }
+    }
+    return low;
+}
+
+/* Acrescenta a `offsets` a posição atual de `fp`, como uint64. */
+static void append_file_offset(ByteBuffer *offsets, FILE *fp) {
+    uint64_t offset = (uint64_t)ftello(fp);
+    byte_buffer_append(offsets, &offset, sizeof(offset));
+}
+
+/*
+ * Cria arquivos separados para as colunas de artistas e letras, mantendo as
+ * aspas originais dos campos de texto. `text_offsets` e `artist_offsets`
+ * recebem a posição de cada registro nos dois arquivos, mais a do fim, para
+ * que as fatias de cada processo cubram as mesmas músicas. Retorna 1 em
+ * sucesso e 0 em caso de falha.
+ */
+static int split_dataset_columns(const char *dataset_path, const char *split_dir,
+                                 const char *artist_base_name, const char *text_base_name,
+                                 const char *artist_header_label, const char *text_header_label,
+                                 char *artist_out_path, size_t artist_out_len,
+                                 char *text_out_path, size_t text_out_len,
+                                 ByteBuffer *text_offsets, ByteBuffer *artist_offsets) {
+    if (!dataset_path || !split_dir || !artist_base_name || !text_base_name) {
+        return 0;
+    }
+    if (!artist_out_path || !text_out_path) {
+        return 0;
+    }
+    if (ensure_directory_recursive(split_dir) != 0) {
+        fprintf(stderr, "Failed to create split directory %s: %s\n", split_dir, strerror(errno));
+        return 0;
+    }
+    int needed = snprintf(artist_out_path, artist_out_len, "%s/%s.csv", split_dir, artist_base_name);
+    if (needed < 0 || (size_t)needed >= artist_out_len) {
+        fprintf(stderr, "Artist split path is too long\n");
+        return 0;
+    }
+    needed = snprintf(text_out_path, text_out_len, "%s/%s.csv", split_dir, text_base_name);
+    if (needed < 0 || (size_t)needed >= text_out_len) {
+        fprintf(stderr, "Text split path is too long\n");
+        return 0;
+    }
+
+    FILE *input = fopen(dataset_path, "r");
+    if (!input) {
+        fprintf(stderr, "Failed to open dataset %s for splitting\n", dataset_path);
+        return 0;
+    }
+    FILE *artist_fp = fopen(artist_out_path, "w");
+    FILE *text_fp = fopen(text_out_path, "w");
+    if (!artist_fp || !text_fp) {
+        fprintf(stderr, "Failed to create split files in %s\n", split_dir);
+        if (artist_fp) {
+            fclose(artist_fp);
+        }
+        if (text_fp) {
+            fclose(text_fp);
+        }
+        fclose(input);
+        return 0;
+    }
+
+    fprintf(artist_fp, "%s\n", (artist_header_label && *artist_header_label) ? artist_header_label : "Artists");
+    fprintf(text_fp, "%s\n", (text_header_label && *text_header_label) ? text_header_label : "Texts");
+
+    char *line = NULL;
+    size_t line_cap = 0;
+    ssize_t read = read_csv_record(input, &line, &line_cap); /* descarta cabeçalho */
+    if (read < 0) {
+        append_file_offset(text_offsets, text_fp);
+        append_file_offset(artist_offsets, artist_fp);
+        free(line);
+        fclose(artist_fp);
+        fclose(text_fp);
+        fclose(input);
+        return 1; /* dataset vazio, apenas cabeçalhos criados */
+    }
+
+    while ((read = read_csv_record(input, &line, &line_cap)) >= 0) {
+        if (read == 0) {
+            continue;
+        }
+        char *artist_raw = NULL;
+        char *lyrics_raw = NULL;
+        if (!parse_csv_line(line, &artist_raw, &lyrics_raw, NULL, 1, 1)) {
+            free(artist_raw);
+            free(lyrics_raw);
+            continue;
+        }
+        append_file_offset(text_offsets, text_fp);
+        append_file_offset(artist_offsets, artist_fp);
+        fprintf(artist_fp, "%s\n", artist_raw ? artist_raw : "");
+        fprintf(text_fp, "%s\n", lyrics_raw ? lyrics_raw : "");
+        free(artist_raw);
+        free(lyrics_raw);
+    }
+    append_file_offset(text_offsets, text_fp);
+    append_file_offset(artist_offsets, artist_fp);
+
+    free(line);
+    fclose(artist_fp);
+    fclose(text_fp);
+    fclose(input);
+    return 1;
+}
+
+/*
+ * Rank 0: divide as músicas dos arquivos auxiliares entre os processos,
+ * equilibrando os bytes de letras, e grava em `bounds` o início da fatia de
+ * cada rank no arquivo de letras (posições 0 a P) e no de artistas (posições
+ * P + 1 a 2P + 1), com o fim do arquivo na última posição de cada metade.
+ */
+static void split_column_bounds(const ByteBuffer *text_offsets, const ByteBuffer *artist_offsets, int world_size,
+                                long long *bounds) {
+    const uint64_t *text = (const uint64_t *)text_offsets->data;
+    const uint64_t *artist = (const uint64_t *)artist_offsets->data;
+    uint64_t records = text_offsets->size / sizeof(uint64_t) - 1U;
+    for (int part = 0; part <= world_size; ++part) {
+        uint64_t record = offsets_split_point(text, 0, records, part, world_size);
+        bounds[part] = (long long)text[record];
+        bounds[world_size + 1 + part] = (long long)artist[record];
+    }
+}
+
+/*
+ * Lê o cabeçalho do dataset original, devolvendo os rótulos das colunas de
+ * artista e letra e o deslocamento em bytes onde começam os registros.
+ * Retorna 1 em sucesso e 0 em caso de falha.
+ */
+static int read_dataset_header(const char *dataset_path, char *artist_label, size_t artist_label_len,
+                               char *text_label, size_t text_label_len, long long *data_start) {
+    FILE *fp = fopen(dataset_path, "r");
+    if (!fp) {
+        fprintf(stderr, "Failed to open dataset %s\n", dataset_path);
+        return 0;
+    }
+    char *header_line = NULL;
+    size_t header_cap = 0;
+    ssize_t header_read = read_csv_record(fp, &header_line, &header_cap);
+    if (header_read < 0) {
+        fprintf(stderr, "Dataset does not contain a header row\n");
+        free(header_line);
+        fclose(fp);
+        return 0;
+    }
+    *data_start = (long long)ftello(fp);
+    char *artist_header_tmp = NULL;
+    char *text_header_tmp = NULL;
+    if (!parse_csv_line(header_line, &artist_header_tmp, &text_header_tmp, NULL, 0, 0)) {
+        fprintf(stderr, "Unable to parse dataset header\n");
+        free(artist_header_tmp);
+        free(text_header_tmp);
+        free(header_line);
+        fclose(fp);
+        return 0;
+    }
+    strncpy(artist_label, artist_header_tmp, artist_label_len - 1);
+    strncpy(text_label, text_header_tmp, text_label_len - 1);
+    artist_label[artist_label_len - 1] = '\0';
+    text_label[text_label_len - 1] = '\0';
+    free(artist_header_tmp);
+    free(text_header_tmp);
+    free(header_line);
+    fclose(fp);
+    return 1;
+}
+
+/*
+ * Calcula o intervalo [início, fim) de bytes atribuído a um processo,
+ * distribuindo o resto da divisão entre os primeiros ranks.
+ */
+static void compute_byte_slice(long long data_start, long long data_end, int rank, int world_size,
+                               long long *slice_start, long long *slice_end) {
+    long long data_bytes = data_end > data_start ? data_end - data_start : 0;
+    long long base_chunk = data_bytes / world_size;
+    long long remainder = data_bytes % world_size;
+    *slice_start = data_start + rank * base_chunk + (rank < remainder ? rank : remainder);
+    *slice_end = *slice_start + base_chunk + (rank < remainder ? 1 : 0);
+    if (rank == world_size - 1) {
+        *slice_end = data_end;
+    }
+}
+
+#define SCAN_BLOCK_SIZE (1 << 20)
+
+/* Bytes classificados por vez na varredura estrutural do CSV. */
+#define CSV_BLOCK 64
+
+/*
+ * Classifica `count` bytes (até CSV_BLOCK) em uma máscara de aspas e uma de
+ * delimitadores (vírgula, \n e \r), um bit por byte.
+ */
+static void csv_classify_bytes_scalar(const unsigned char *src, size_t count, uint64_t *quotes,
+                                      uint64_t *delimiters) {
+    uint64_t quote_mask = 0;
+    uint64_t delimiter_mask = 0;
+    for (size_t i = 0; i < count; ++i) {
+        unsigned char ch = src[i];
+        quote_mask |= (uint64_t)(ch == '"') << i;
+        delimiter_mask |= (uint64_t)(ch == ',' || ch == '\n' || ch == '\r') << i;
+    }
+    *quotes = quote_mask;
+    *delimiters = delimiter_mask;
+}
+
+static void csv_classify_block_scalar(const unsigned char *src, uint64_t *quotes, uint64_t *delimiters) {
+    csv_classify_bytes_scalar(src, CSV_BLOCK, quotes, delimiters);
+}
+
+#ifdef HAVE_X86_SIMD
+static void csv_classify_block_sse2(const unsigned char *src, uint64_t *quotes, uint64_t *delimiters) {
+    const __m128i quote = _mm_set1_epi8('"');
+    const __m128i comma = _mm_set1_epi8(',');
+    const __m128i newline = _mm_set1_epi8('\n');
+    const __m128i carriage = _mm_set1_epi8('\r');
+    uint64_t quote_mask = 0;
+    uint64_t delimiter_mask = 0;
+    for (int part = 0; part < 4; ++part) {
+        __m128i v = _mm_loadu_si128((const __m128i *)(src + part * 16));
+        __m128i delimiter = _mm_or_si128(_mm_cmpeq_epi8(v, comma),
+                                         _mm_or_si128(_mm_cmpeq_epi8(v, newline), _mm_cmpeq_epi8(v, carriage)));
+        quote_mask |= (uint64_t)(uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(v, quote)) << (part * 16);
+        delimiter_mask |= (uint64_t)(uint32_t)_mm_movemask_epi8(delimiter) << (part * 16);
+    }
+    *quotes = quote_mask;
+    *delimiters = delimiter_mask;
+}
+
+__attribute__((target("avx2"))) static void csv_classify_block_avx2(const unsigned char *src, uint64_t *quotes,
+                                                                     uint64_t *delimiters) {
+    const __m256i quote = _mm256_set1_epi8('"');
+    const __m256i comma = _mm256_set1_epi8(',');
+    const __m256i newline = _mm256_set1_epi8('\n');
+    const __m256i carriage = _mm256_set1_epi8('\r');
+    __m256i low = _mm256_loadu_si256((const __m256i *)src);
+    __m256i high = _mm256_loadu_si256((const __m256i *)(src + 32));
+    __m256i low_delimiter = _mm256_or_si256(_mm256_cmpeq_epi8(low, comma),
+                                            _mm256_or_si256(_mm256_cmpeq_epi8(low, newline),
+                                                            _mm256_cmpeq_epi8(low, carriage)));
+    __m256i high_delimiter = _mm256_or_si256(_mm256_cmpeq_epi8(high, comma),
+                                             _mm256_or_si256(_mm256_cmpeq_epi8(high, newline),
+                                                             _mm256_cmpeq_epi8(high, carriage)));
+    *quotes = (uint64_t)(uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(low, quote)) |
+              (uint64_t)(uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(high, quote)) << 32;
+    *delimiters = (uint64_t)(uint32_t)_mm256_movemask_epi8(low_delimiter) |
+                  (uint64_t)(uint32_t)_mm256_movemask_epi8(high_delimiter) << 32;
+}
+#endif
+
+/* Núcleo de classificação do CSV escolhido em csv_scanner_init conforme a CPU. */
+static void (*csv_classify_block)(const unsigned char *src, uint64_t *quotes,
+                                  uint64_t *delimiters) = csv_classify_block_scalar;
+
+/* Seleciona o núcleo vetorial da varredura estrutural; chamar antes de criar threads. */
+static void csv_scanner_init(void) {
+#ifdef HAVE_X86_SIMD
+    __builtin_cpu_init();
+    csv_classify_block = __builtin_cpu_supports("avx2") ? csv_classify_block_avx2 : csv_classify_block_sse2;
+#else
+    csv_classify_block = csv_classify_block_scalar;
+#endif
+}
+
+/*
+ * Bit i do resultado é o XOR dos bits 0..i da entrada. Aplicado à máscara de
+ * aspas, marca os bytes que estão dentro de um campo entre aspas; um escape
+ * "" alterna o estado duas vezes e, portanto, não o altera.
+ */
+static inline uint64_t prefix_xor(uint64_t bits) {
+    bits ^= bits << 1;
+    bits ^= bits << 2;
+    bits ^= bits << 4;
+    bits ^= bits << 8;
+    bits ^= bits << 16;
+    bits ^= bits << 32;
+    return bits;
+}
+
+static inline unsigned popcount64(uint64_t bits) {
+#ifdef __GNUC__
+    return (unsigned)__builtin_popcountll(bits);
+#else
+    unsigned count = 0;
+    while (bits) {
+        bits &= bits - 1U;
+        ++count;
+    }
+    return count;
+#endif
+}
+
+/* Conta as aspas no intervalo [start, end) do arquivo, lendo em blocos. */
+static long long count_quotes_in_range(FILE *fp, long long start, long long end) {
+    if (start >= end || fseeko(fp, start, SEEK_SET) != 0) {
+        return 0;
+    }
+    unsigned char *block = (unsigned char *)malloc(SCAN_BLOCK_SIZE);
+    if (!block) {
+        fprintf(stderr, "Failed to allocate scan buffer\n");
+        MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
+    }
+    long long quotes = 0;
+    long long remaining = end - start;
+    while (remaining > 0) {
+        size_t wanted = remaining < SCAN_BLOCK_SIZE ? (size_t)remaining : SCAN_BLOCK_SIZE;
+        size_t got = fread(block, 1, wanted, fp);
+        if (got == 0) {
+            break;
+        }
+        for (size_t base = 0; base < got; base += CSV_BLOCK) {
+            uint64_t quote_mask;
+            uint64_t delimiter_mask;
+            if (got - base >= CSV_BLOCK) {
+                csv_classify_block(block + base, &quote_mask, &delimiter_mask);
+            } else {
+                csv_classify_bytes_scalar(block + base, got - base, &quote_mask, &delimiter_mask);
+            }
+            quotes += popcount64(quote_mask);
+        }
+        remaining -= (long long)got;
+    }
+    free(block);
+    return quotes;
+}
+
+/*
+ * Localiza o primeiro início de registro em posição maior ou igual a
+ * `offset`, sabendo se o deslocamento está dentro de aspas. Cada aspa alterna
+ * o estado (um escape "" alterna duas vezes), então a paridade basta para
+ * reconhecer quebras de linha fora de campos. Retorna `file_size` se nenhum
+ * registro começar depois do deslocamento.
+ */
+static long long find_record_start(FILE *fp, long long offset, int in_quotes,
+                                   long long data_start, long long file_size) {
+    if (offset <= data_start) {
+        return data_start;
+    }
+    if (offset >= file_size || fseeko(fp, offset - 1, SEEK_SET) != 0) {
+        return file_size;
+    }
+    int previous = fgetc(fp);
+    if (!in_quotes && previous == '\n') {
+        return offset;
+    }
+    int pending_cr = !in_quotes && previous == '\r';
+    long long position = offset;
+    int ch;
+    while ((ch = fgetc(fp)) != EOF) {
+        if (pending_cr) {
+            return ch == '\n' ? position + 1 : position;
+        }
+        if (ch == '"') {
+            in_quotes = !in_quotes;
+        } else if (!in_quotes && ch == '\n') {
+            return position + 1;
+        } else if (!in_quotes && ch == '\r') {
+            pending_cr = 1;
+        }
+        position++;
+    }
+    return file_size;
+}
+
+/*
+ * Resolve a fatia de registros completos de cada processo. A partição por
+ * bytes é apenas o ponto de partida: cada rank conta as aspas do seu trecho e
+ * um MPI_Exscan fornece a paridade acumulada no início de cada fatia, o que
+ * permite encontrar o primeiro registro real mesmo quando o corte cai no meio
+ * de uma letra. O fim de cada fatia é o início resolvido do rank seguinte,
+ * de modo que todo registro pertence a exatamente um processo.
+ */
+static void resolve_record_slice(const char *path, long long data_start, long long file_size,
+                                 int rank, int world_size, long long *slice_start, long long *slice_end) {
+    long long raw_start = 0;
+    long long raw_end = 0;
+    compute_byte_slice(data_start, file_size, rank, world_size, &raw_start, &raw_end);
+
+    FILE *fp = fopen(path, "r");
+    if (!fp) {
+        fprintf(stderr, "Rank %d failed to open %s for boundary resolution\n", rank, path);
+        MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
+    }
+    long long local_quotes = count_quotes_in_range(fp, raw_start, raw_end);
+    long long quotes_before = 0;
+    MPI_Exscan(&local_quotes, &quotes_before, 1, MPI_LONG_LONG, MPI_SUM, MPI_COMM_WORLD);
+    if (rank == 0) {
+        quotes_before = 0;
+    }
+    long long start = find_record_start(fp, raw_start, (int)(quotes_before & 1LL), data_start, file_size);
+    fclose(fp);
+
+    long long next_start = file_size;
+    int prev_rank = rank > 0 ? rank - 1 : MPI_PROC_NULL;
+    int next_rank = rank + 1 < world_size ? rank + 1 : MPI_PROC_NULL;
+    MPI_Sendrecv(&start, 1, MPI_LONG_LONG, prev_rank, 300,
+                 &next_start, 1, MPI_LONG_LONG, next_rank, 300, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+    if (rank == world_size - 1) {
+        next_start = file_size;
+    }
+    *slice_start = start;
+    *slice_end = next_start > start ? next_start : start;
+}
+
+/*
+ * Resolve as fronteiras dos `chunk_count` blocos do escalonamento dinâmico,
+ * que deve ser múltiplo de `world_size`. Cada rank conta as aspas dos blocos
+ * brutos da sua fatia, um MPI_Exscan fornece a paridade anterior a ela e o
+ * rank alinha o início de cada bloco ao próximo registro, como em
+ * resolve_record_slice. Um MPI_Allgather distribui o vetor completo de
+ * `chunk_count + 1` posições, que o chamador libera.
+ */
+static long long *resolve_chunk_bounds(const char *path, long long data_start, long long file_size,
+                                       long long chunk_count, int rank, int world_size) {
+    long long per_rank = chunk_count / world_size;
+    long long *bounds = (long long *)calloc((size_t)chunk_count + 1U, sizeof(long long));
+    long long *local = (long long *)calloc((size_t)per_rank, sizeof(long long));
+    long long *quotes = (long long *)calloc((size_t)per_rank, sizeof(long long));
+    if (!bounds || !local || !quotes) {
+        fprintf(stderr, "Rank %d failed to allocate chunk boundaries\n", rank);
+        MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
+    }
+    FILE *fp = fopen(path, "r");
+    if (!fp) {
+        fprintf(stderr, "Rank %d failed to open %s for boundary resolution\n", rank, path);
+        MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
+    }
+    long long local_quotes = 0;
+    for (long long j = 0; j < per_rank; ++j) {
+        long long raw_end = 0;
+        compute_byte_slice(data_start, file_size, (int)(rank * per_rank + j), (int)chunk_count, &local[j], &raw_end);
+        quotes[j] = count_quotes_in_range(fp, local[j], raw_end);
+        local_quotes += quotes[j];
+    }
+    long long quotes_before = 0;
+    MPI_Exscan(&local_quotes, &quotes_before, 1, MPI_LONG_LONG, MPI_SUM, MPI_COMM_WORLD);
+    if (rank == 0) {
+        quotes_before = 0;
+    }
+    for (long long j = 0; j < per_rank; ++j) {
+        local[j] = find_record_start(fp, local[j], (int)(quotes_before & 1LL), data_start, file_size);
+        quotes_before += quotes[j];
+    }
+    fclose(fp);
+    MPI_Allgather(local, (int)per_rank, MPI_LONG_LONG, bounds, (int)per_rank, MPI_LONG_LONG, MPI_COMM_WORLD);
+    bounds[chunk_count] = file_size;
+    for (long long c = 1; c <= chunk_count; ++c) {
+        if (bounds[c] < bounds[c - 1]) {
+            bounds[c] = bounds[c - 1];
+        }
+    }
+    free(quotes);
+    free(local);
+    return bounds;
+}
+
+/* Número de colunas relevantes em um registro do dataset (artist, song, link, text). */
+#define CSV_FIELD_COUNT 4
+
+/*
+ * Registro do CSV descrito apenas por visões sobre o buffer de origem. O
+ * último campo se estende até o fim do registro, como em parse_csv_line.
+ */
+typedef struct {
+    StringView fields[CSV_FIELD_COUNT];
+    int field_count;
+} CsvRecordView;
+
+/* Bytes indexados por lote na varredura estrutural. */
+#define CSV_SCAN_BATCH (16 * 1024)
+
+/*
+ * Índice estrutural de um buffer CSV, no estilo do estágio 1 do simdjson:
+ * cada lote de CSV_SCAN_BATCH bytes é classificado em blocos de 64 bytes, a
+ * máscara de aspas passa por prefix_xor para marcar as regiões entre aspas
+ * (com a paridade transportada entre blocos) e sobram apenas as posições de
+ * vírgulas e quebras de linha fora de aspas. O analisador consome essas
+ * posições em vez de percorrer o buffer byte a byte.
+ */
+typedef struct {
+    const unsigned char *data;
+    size_t length;
+    size_t scanned;
+    uint64_t inside_quotes;
+    size_t positions[CSV_SCAN_BATCH];
+    size_t count;
+    size_t cursor;
+} CsvScanner;
+
+/* Prepara a varredura de um buffer que começa fora de aspas. */
+static void csv_scanner_reset(CsvScanner *scanner, const char *data, size_t length) {
+    scanner->data = (const unsigned char *)data;
+    scanner->length = length;
+    scanner->scanned = 0;
+    scanner->inside_quotes = 0;
+    scanner->count = 0;
+    scanner->cursor = 0;
+}
+
+/* Indexa o próximo lote do buffer. */
+static void csv_scanner_fill(CsvScanner *scanner) {
+    size_t batch_end = scanner->scanned + CSV_SCAN_BATCH;
+    if (batch_end > scanner->length) {
+        batch_end = scanner->length;
+    }
+    size_t count = 0;
+    for (size_t base = scanner->scanned; base < batch_end; base += CSV_BLOCK) {
+        uint64_t quotes;
+        uint64_t delimiters;
+        if (batch_end - base >= CSV_BLOCK) {
+            csv_classify_block(scanner->data + base, &quotes, &delimiters);
+        } else {
+            csv_classify_bytes_scalar(scanner->data + base, batch_end - base, &quotes, &delimiters);
+        }
+        uint64_t quoted = prefix_xor(quotes) ^ scanner->inside_quotes;
+        scanner->inside_quotes = (uint64_t)0 - (quoted >> 63);
+        uint64_t structural = delimiters & ~quoted;
+        while (structural) {
+            scanner->positions[count++] = base + lowest_bit_index(structural);
+            structural &= structural - 1U;
+        }
+    }
+    scanner->scanned = batch_end;
+    scanner->count = count;
+    scanner->cursor = 0;
+}
+
+/* Devolve a próxima posição estrutural; retorna 0 ao fim do buffer. */
+static int csv_scanner_next(CsvScanner *scanner, size_t *position) {
+    while (scanner->cursor == scanner->count) {
+        if (scanner->scanned >= scanner->length) {
+            return 0;
+        }
+        csv_scanner_fill(scanner);
+    }
+    *position = scanner->positions[scanner->cursor++];
+    return 1;
+}
+
+/*
+ * Delimita o registro que começa em `pos` e preenche as visões dos campos sem
+ * copiar bytes. Segue as mesmas regras de read_csv_record e parse_csv_line
+ * (aspas duplicadas como escape, quebras de linha permitidas entre aspas),
+ * mas visita apenas as posições estruturais do índice. Retorna a posição logo
+ * após o registro.
+ */
+static size_t next_csv_record(CsvScanner *scanner, size_t pos, CsvRecordView *record) {
+    const char *data = (const char *)scanner->data;
+    size_t length = scanner->length;
+    size_t field_start = pos;
+    size_t record_end = length;
+    size_t next = length;
+    size_t at;
+    record->field_count = 0;
+    while (csv_scanner_next(scanner, &at)) {
+        if (at < pos) {
+            continue; /* \n de um \r\n já consumido pelo registro anterior */
+        }
+        if (data[at] == ',') {
+            if (record->field_count < CSV_FIELD_COUNT - 1) {
+                record->fields[record->field_count].data = data + field_start;
+                record->fields[record->field_count].length = at - field_start;
+                record->field_count++;
+                field_start = at + 1;
+            }
+            continue;
+        }
+        record_end = at;
+        next = at + 1;
+        if (data[at] == '\r' && next < length && data[next] == '\n') {
+            next++;
+        }
+        break;
+    }
+    if (record->field_count == CSV_FIELD_COUNT - 1) {
+        record->fields[CSV_FIELD_COUNT - 1].data = data + field_start;
+        record->fields[CSV_FIELD_COUNT - 1].length = record_end - field_start;
+        record->field_count = CSV_FIELD_COUNT;
+    }
+    return next;
+}
+
+/* Remove espaços nas extremidades de uma visão, sem alterar o buffer. */
+static StringView view_trim(StringView view) {
+    while (view.length > 0 && isspace((unsigned char)view.data[0])) {
+        view.data++;
+        view.length--;
+    }
+    while (view.length > 0 && isspace((unsigned char)view.data[view.length - 1])) {
+        view.length--;
+    }
+    return view;
+}
+
+/*
+ * Equivalente a duplicate_field(campo, 0) sobre visões: remove espaços e aspas
+ * externas e só copia o conteúdo para `scratch` quando há aspas escapadas a
+ * desfazer. Nos demais casos a visão devolvida aponta para o próprio buffer.
+ */
+static StringView view_unquote(StringView field, char **scratch, size_t *scratch_cap) {
+    StringView view = view_trim(field);
+    if (view.length < 2 || view.data[0] != '"' || view.data[view.length - 1] != '"') {
+        return view;
+    }
+    view.data++;
+    view.length -= 2;
+    if (!memchr(view.data, '"', view.length)) {
+        return view_trim(view);
+    }
+    if (*scratch_cap < view.length + 1) {
+        char *tmp = (char *)realloc(*scratch, view.length + 1);
+        if (!tmp) {
+            fprintf(stderr, "Failed to allocate memory for CSV field\n");
+            MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
+        }
+        *scratch = tmp;
+        *scratch_cap = view.length + 1;
+    }
+    size_t j = 0;
+    for (size_t i = 0; i < view.length; ++i) {
+        (*scratch)[j++] = view.data[i];
+        if (view.data[i] == '"' && i + 1 < view.length && view.data[i + 1] == '"') {
+            i++;
+        }
+    }
+    StringView unescaped = {*scratch, j};
+    return view_trim(unescaped);
+}
+
+/*
+ * Saídas detalhadas pedidas na linha de comando (--per-song, --per-artist,
+ * --artist-stats, com o número de palavras listadas por artista, e
+ * --sentiment). `artist_words` indica se os pares artista/palavra são
+ * contados; `sentiment_scores`, se sentiment_scores.csv é gravado, e
+ * `sentiment_margin` é o saldo mínimo, em valor absoluto, para que o rótulo
+ * do léxico dispense o LLM (--sentiment-margin).
+ */
+typedef struct {
+    int per_song;
+    int per_artist;
+    int artist_stats;
+    int artist_words;
+    int sentiment;
+    int sentiment_scores;
+    int sentiment_margin;
+} DetailOutputs;
+
+static DetailOutputs detail_outputs = {0, 0, 0, 0, 0, 0, 1};
+
+/*
+ * Soma `count` ao par artista/palavra, guardado como a chave "artista\0palavra";
+ * o '\0' separa as partes e ordena cada artista antes dos nomes que o
+ * estendem. `scratch` monta a chave.
+ */
+static void add_artist_word(HashTable *artist_words, StringView artist, const char *word, size_t word_length,
+                            CountType count, ByteBuffer *scratch) {
+    scratch->size = 0;
+    byte_buffer_append(scratch, artist.data, artist.length);
+    byte_buffer_append(scratch, "", 1);
+    byte_buffer_append(scratch, word, word_length);
+    ht_put_len(artist_words, scratch->data, scratch->size, count);
+}
+
+/*
+ * Léxico do classificador de sentimento (--sentiment), o mesmo de mock_label
+ * em scripts/sentiment_classifier.py: cada palavra-chave presente na letra
+ * vale +1 (as SENTIMENT_POSITIVE_KEYWORDS primeiras) ou -1, uma única vez
+ * por música. O script procura as palavras-chave como substrings da letra em
+ * minúsculas; como elas só têm letras, cada ocorrência cai dentro de um
+ * único token, e basta procurá-las nos tokens distintos da música.
+ */
+#define SENTIMENT_KEYWORD(text) {text, sizeof(text) - 1U}
+static const StringView sentiment_keywords[] = {
+    SENTIMENT_KEYWORD("love"), SENTIMENT_KEYWORD("happy"), SENTIMENT_KEYWORD("joy"),
+    SENTIMENT_KEYWORD("sunshine"), SENTIMENT_KEYWORD("smile"), SENTIMENT_KEYWORD("cry"),
+    SENTIMENT_KEYWORD("sad"), SENTIMENT_KEYWORD("pain"), SENTIMENT_KEYWORD("lonely"),
+    SENTIMENT_KEYWORD("tears"),
+};
+#define SENTIMENT_KEYWORD_COUNT (sizeof(sentiment_keywords) / sizeof(sentiment_keywords[0]))
+#define SENTIMENT_POSITIVE_KEYWORDS 5U
+
+/*
+ * Palavras-chave que começam com cada byte, como máscara de bits: quase todos
+ * os bytes de um token não iniciam nenhuma, e os demais iniciam no máximo duas.
+ */
+static uint16_t sentiment_first_byte[256];
+
+static void sentiment_lexicon_init(void) {
+    for (size_t k = 0; k < SENTIMENT_KEYWORD_COUNT; ++k) {
+        sentiment_first_byte[(unsigned char)sentiment_keywords[k].data[0]] |= (uint16_t)(1U << k);
+    }
+}
+
+/* Máscara das palavras-chave contidas em um token. */
+static unsigned sentiment_word_mask(const char *word, size_t length) {
+    unsigned mask = 0;
+    for (size_t i = 0; i < length; ++i) {
+        unsigned candidates = sentiment_first_byte[(unsigned char)word[i]];
+        while (candidates) {
+            unsigned k = (unsigned)__builtin_ctz(candidates);
+            candidates &= candidates - 1U;
+            const StringView *keyword = &sentiment_keywords[k];
+            if (keyword->length <= length - i && memcmp(word + i, keyword->data, keyword->length) == 0) {
+                mask |= 1U << k;
+            }
+        }
+    }
+    return mask;
+}
+
+/*
+ * Encerra uma música no classificador de sentimento a partir da máscara das
+ * palavras-chave dos seus tokens: o rótulo vem do saldo, como em mock_label,
+ * e a música é ambígua quando o saldo, em valor absoluto, fica abaixo de
+ * --sentiment-margin. Soma os totais do processo e a chave "artista\0d" (d é
+ * o dígito do rótulo) e, com sentiment_scores.csv, acrescenta a linha da
+ * música a partir de `prefix` ("artist,song,").
+ */
+static void record_song_sentiment(LocalStats *stats, StringView artist, const ByteBuffer *prefix, unsigned mask,
+                                  ByteBuffer *scratch) {
+    CountType positive = __builtin_popcount(mask & ((1U << SENTIMENT_POSITIVE_KEYWORDS) - 1U));
+    CountType negative = __builtin_popcount(mask >> SENTIMENT_POSITIVE_KEYWORDS);
+    CountType score = positive - negative;
+    int label = score > 0 ? SENTIMENT_POSITIVE : (score < 0 ? SENTIMENT_NEGATIVE : SENTIMENT_NEUTRAL);
+    int ambiguous = (score < 0 ? -score : score) < detail_outputs.sentiment_margin;
+    stats->sentiment_totals[label]++;
+    stats->sentiment_totals[SENTIMENT_AMBIGUOUS] += ambiguous;
+    if (artist.length > 0) {
+        const char suffix[2] = {'\0', (char)('0' + label)};
+        scratch->size = 0;
+        byte_buffer_append(scratch, artist.data, artist.length);
+        byte_buffer_append(scratch, suffix, sizeof(suffix));
+        ht_put_len(&stats->artist_sentiment, scratch->data, scratch->size, 1);
+    }
+    if (detail_outputs.sentiment_scores) {
+        ByteBuffer *out = &stats->sentiment_rows;
+        byte_buffer_append(out, prefix->data, prefix->size);
+        append_decimal(out, positive, ",", 1);
+        append_decimal(out, negative, ",", 1);
+        append_decimal(out, score, ",", 1);
+        byte_buffer_append(out, sentiment_labels[label], strlen(sentiment_labels[label]));
+        byte_buffer_append(out, ambiguous ? ",1\r\n" : ",0\r\n", 4);
+    }
+}
+
+/*
+ * Encerra uma música nas saídas detalhadas: as palavras contadas em
+ * `song_words` seguem para a contagem global e geram as linhas por música,
+ * os pares por artista e o rótulo de sentimento.
+ */
+static void record_song_details(LocalStats *stats, StringView artist, StringView song) {
+    SongCounter *counter = stats->song_words;
+    if (detail_outputs.sentiment_scores || (detail_outputs.per_song && counter->count > 0)) {
+        format_song_prefix(&counter->prefix, artist, song);
+    }
+    unsigned sentiment_mask = 0;
+    for (size_t i = 0; i < counter->count; ++i) {
+        const Entry *word = &counter->words[i];
+        ht_put_hashed(&stats->word_counts, word->key, word->length, word->hash, word->value);
+        if (detail_outputs.sentiment) {
+            sentiment_mask |= sentiment_word_mask(word->key, word->length);
+        }
+        if (detail_outputs.per_song) {
+            append_song_row(&stats->song_rows, &counter->prefix, word->key, word->length, word->value);
+        }
+        if (detail_outputs.artist_words && artist.length > 0) {
+            add_artist_word(&stats->artist_words, artist, word->key, word->length, word->value, &counter->scratch);
+        }
+    }
+    if (detail_outputs.artist_stats && artist.length > 0) {
+        add_artist_word(&stats->artist_words, artist, "", 0, 1, &counter->scratch);
+    }
+    if (detail_outputs.sentiment) {
+        record_song_sentiment(stats, artist, &counter->prefix, sentiment_mask, &counter->scratch);
+    }
+    song_counter_clear(counter);
+}
+
+/*
+ * Tokeniza a letra de uma música. Com saídas detalhadas, as palavras passam
+ * antes pelo contador da música, que alimenta também as linhas detalhadas.
+ */
+static void process_song_lyrics(LocalStats *stats, StringView artist, StringView song, StringView lyrics) {
+    double started = phase_clock();
+    if (stats->approx) {
+        if (lyrics.length > 0) {
+            TokenSink sink = {NULL, &stats->word_total, NULL, NULL, &stats->approx[APPROX_WORDS]};
+            tokenize_lyrics(&sink, lyrics.data, lyrics.length);
+        }
+    } else if (!stats->song_words) {
+        if (lyrics.length > 0) {
+            process_lyrics(&stats->word_counts, lyrics.data, lyrics.length, &stats->word_total);
+        }
+    } else {
+        if (lyrics.length > 0) {
+            TokenSink sink = {NULL, &stats->word_total, NULL, stats->song_words, NULL};
+            tokenize_lyrics(&sink, lyrics.data, lyrics.length);
+        }
+        record_song_details(stats, artist, song);
+    }
+    stats->profile.seconds[PHASE_TOKENIZE] += phase_clock() - started;
+}
+
+/* Soma `songs` músicas de um artista, na tabela ou no resumo aproximado. */
+static void count_artist(LocalStats *stats, const char *name, size_t length, CountType songs) {
+    if (stats->approx) {
+        approx_add(&stats->approx[APPROX_ARTISTS], name, length, hash_bytes(name, length), songs);
+    } else {
+        ht_put_len(&stats->artist_counts, name, length, songs);
+    }
+}
+
+/* Atualiza as contagens locais com o artista, o título e a letra de um registro. */
+static void process_record(LocalStats *stats, StringView artist, StringView song, StringView lyrics) {
+    if (artist.length > 0) {
+        double started = phase_clock();
+        count_artist(stats, artist.data, artist.length, 1);
+        stats->profile.seconds[PHASE_ARTISTS] += phase_clock() - started;
+    }
+    stats->song_total++;
+    process_song_lyrics(stats, artist, song, lyrics);
+}
+
+/*
+ * Contabiliza como leitura o tempo de análise de um trecho iniciada em
+ * `started`, descontando a tokenização e a contagem de artistas medidas
+ * dentro dele (`inner_before` é a soma das duas no início do trecho).
+ */
+static void profile_add_read(PhaseProfile *profile, double started, double inner_before) {
+    double inner = profile->seconds[PHASE_TOKENIZE] + profile->seconds[PHASE_ARTISTS] - inner_before;
+    profile->seconds[PHASE_READ] += phase_clock() - started - inner;
+}
+
+static double profile_inner_seconds(const PhaseProfile *profile) {
+    return profile->seconds[PHASE_TOKENIZE] + profile->seconds[PHASE_ARTISTS];
+}
+
+/*
+ * Processa diretamente um intervalo de bytes do CSV original: cada registro
+ * da fatia [slice_start, slice_end), já alinhada por resolve_record_slice, é
+ * lido uma única vez e tem artista e letra extraídos no mesmo passo.
+ */
+static void analyze_dataset_slice(const char *dataset_path, long long slice_start, long long slice_end,
+                                  LocalStats *stats, int rank) {
+    FILE *fp = fopen(dataset_path, "r");
+    if (!fp) {
+        fprintf(stderr, "Rank %d failed to open dataset %s\n", rank, dataset_path);
+        MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
+    }
+    long long position = slice_start;
+    if (fseeko(fp, position, SEEK_SET) != 0) {
+        fprintf(stderr, "Rank %d failed to seek dataset offset %lld\n", rank, position);
+        MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
+    }
+
+    char *line = NULL;
+    size_t line_buf = 0;
+    while (position < slice_end) {
+        ssize_t read_len = read_csv_record(fp, &line, &line_buf);
+        if (read_len < 0) {
+            break;
+        }
+        position += read_len;
+        char *artist = NULL;
+        char *song = NULL;
+        char *lyrics = NULL;
+        if (!parse_csv_line(line, &artist, &lyrics, stats->song_words ? &song : NULL, 0, 1)) {
+            free(artist);
+            free(song);
+            free(lyrics);
+            continue;
+        }
+        StringView artist_view = {artist, strlen(artist)};
+        StringView song_view = {song ? song : "", song ? strlen(song) : 0};
+        StringView lyrics_view = {lyrics, strlen(lyrics)};
+        process_record(stats, artist_view, song_view, lyrics_view);
+        free(artist);
+        free(song);
+        free(lyrics);
+    }
+    free(line);
+    fclose(fp);
+}
+
+#ifdef HAVE_MMAP
+/*
+ * Variante de analyze_dataset_slice que mapeia em memória apenas a fatia do
+ * processo. Como a fatia termina exatamente no fim de um registro, nenhum
+ * byte além dela precisa ser mapeado. Artista e letra chegam ao tokenizador e às tabelas de
+ * hash como visões sobre o mapeamento; só artistas com aspas escapadas são
+ * copiados para um buffer temporário. Retorna 0 se o mapeamento falhar, para
+ * que o chamador recorra à leitura com stdio.
+ */
+static int analyze_dataset_slice_mmap(const char *dataset_path, long long slice_start, long long slice_end,
+                                      LocalStats *stats, int rank) {
+    if (slice_start >= slice_end) {
+        return 1;
+    }
+    int fd = open(dataset_path, O_RDONLY);
+    if (fd < 0) {
+        fprintf(stderr, "Rank %d failed to open dataset %s: %s\n", rank, dataset_path, strerror(errno));
+        return 0;
+    }
+    long page_size = sysconf(_SC_PAGESIZE);
+    if (page_size <= 0) {
+        page_size = 4096;
+    }
+    long long map_offset = slice_start - (slice_start % page_size);
+    size_t map_length = (size_t)(slice_end - map_offset);
+    void *mapping = mmap(NULL, map_length, PROT_READ, MAP_PRIVATE, fd, (off_t)map_offset);
+    close(fd);
+    if (mapping == MAP_FAILED) {
+        fprintf(stderr, "Rank %d failed to map dataset %s: %s\n", rank, dataset_path, strerror(errno));
+        return 0;
+    }
+    madvise(mapping, map_length, MADV_SEQUENTIAL);
+
+    const char *data = (const char *)mapping;
+    size_t pos = (size_t)(slice_start - map_offset);
+    char *scratch = NULL;
+    size_t scratch_cap = 0;
+    char *song_scratch = NULL;
+    size_t song_scratch_cap = 0;
+    CsvScanner *scanner = (CsvScanner *)malloc(sizeof(CsvScanner));
+    if (!scanner) {
+        fprintf(stderr, "Failed to allocate CSV scanner\n");
+        MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
+    }
+    csv_scanner_reset(scanner, data + pos, map_length - pos);
+    CsvRecordView record;
+    pos = 0;
+    while (pos < scanner->length) {
+        pos = next_csv_record(scanner, pos, &record);
+        if (record.field_count < CSV_FIELD_COUNT) {
+            continue;
+        }
+        StringView artist = view_unquote(record.fields[0], &scratch, &scratch_cap);
+        StringView song = {NULL, 0};
+        if (stats->song_words) {
+            song = view_unquote(record.fields[1], &song_scratch, &song_scratch_cap);
+        }
+        process_record(stats, artist, song, record.fields[CSV_FIELD_COUNT - 1]);
+    }
+    free(scratch);
+    free(song_scratch);
+    free(scanner);
+    munmap(mapping, map_length);
+    return 1;
+}
+#endif
+
+/*
+ * Analisa uma fatia alinhada com o mecanismo de leitura escolhido, recorrendo
+ * ao stdio quando o mapeamento em memória não está disponível.
+ */
+static void analyze_record_range(const char *dataset_path, IoEngine io_engine, long long slice_start,
+                                 long long slice_end, LocalStats *stats, int rank) {
+    double started = phase_clock();
+    double inner_before = profile_inner_seconds(&stats->profile);
+    stats->profile.counters[COUNTER_BYTES_READ] += slice_end > slice_start ? slice_end - slice_start : 0;
+    int analyzed = 0;
+#ifdef HAVE_MMAP
+    if (io_engine == IO_MMAP) {
+        analyzed = analyze_dataset_slice_mmap(dataset_path, slice_start, slice_end, stats, rank);
+    }
+#else
+    (void)io_engine;
+#endif
+    if (!analyzed) {
+        analyze_dataset_slice(dataset_path, slice_start, slice_end, stats, rank);
+    }
+    profile_add_read(&stats->profile, started, inner_before);
+}
+
+/* Inicializa contagens locais vazias com as capacidades iniciais padrão. */
+static void local_stats_init(LocalStats *stats) {
+    memset(stats, 0, sizeof(*stats));
+    /* Com --approx as tabelas só recebem, no rank 0, os candidatos finais. */
+    ht_init(&stats->word_counts, approx_counting ? APPROX_HEAVY : 65536);
+    ht_init(&stats->artist_counts, approx_counting ? APPROX_HEAVY : 8192);
+    if (approx_counting) {
+        stats->approx = approx_alloc(APPROX_SKETCHES);
+    }
+    if (detail_outputs.artist_words) {
+        ht_init(&stats->artist_words, 65536);
+    }
+    if (detail_outputs.sentiment) {
+        ht_init(&stats->artist_sentiment, 8192);
+    }
+    if (detail_outputs.per_song || detail_outputs.artist_words || detail_outputs.sentiment) {
+        stats->song_words = (SongCounter *)calloc(1, sizeof(SongCounter));
+        if (!stats->song_words) {
+            fprintf(stderr, "Failed to allocate song word counter\n");
+            MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
+        }
+        ht_init(&stats->song_words->table, SONG_TABLE_CAPACITY);
+    }
+}
+
+/* Libera todas as tabelas e buffers das contagens locais. */
+static void local_stats_free(LocalStats *stats) {
+    ht_free(&stats->word_counts);
+    ht_free(&stats->artist_counts);
+    ht_free(&stats->artist_words);
+    ht_free(&stats->artist_sentiment);
+    free(stats->approx);
+    stats->approx = NULL;
+    free(stats->song_rows.data);
+    stats->song_rows.data = NULL;
+    free(stats->sentiment_rows.data);
+    stats->sentiment_rows.data = NULL;
+    if (stats->song_words) {
+        ht_free(&stats->song_words->table);
+        free(stats->song_words->words);
+        free(stats->song_words->scratch.data);
+        free(stats->song_words->prefix.data);
+        free(stats->song_words);
+        stats->song_words = NULL;
+    }
+}
+
+/* Soma as contagens de `src` em `dest`, com as linhas por música de `src` ao final. */
+static void local_stats_merge(LocalStats *dest, const LocalStats *src) {
+    ht_merge(&dest->word_counts, &src->word_counts);
+    ht_merge(&dest->artist_counts, &src->artist_counts);
+    if (src->artist_words.entries) {
+        ht_merge(&dest->artist_words, &src->artist_words);
+    }
+    if (src->artist_sentiment.entries) {
+        ht_merge(&dest->artist_sentiment, &src->artist_sentiment);
+    }
+    if (src->approx) {
+        for (int s = 0; s < APPROX_SKETCHES; ++s) {
+            approx_merge(&dest->approx[s], &src->approx[s]);
+        }
+    }
+    byte_buffer_append(&dest->song_rows, src->song_rows.data, src->song_rows.size);
+    byte_buffer_append(&dest->sentiment_rows, src->sentiment_rows.data, src->sentiment_rows.size);
+    for (int t = 0; t < SENTIMENT_TOTALS; ++t) {
+        dest->sentiment_totals[t] += src->sentiment_totals[t];
+    }
+    dest->word_total += src->word_total;
+    dest->song_total += src->song_total;
+    profile_merge(&dest->profile, &src->profile);
+}
+
+/* Distribuição do trabalho entre os processos (--schedule). */
+typedef enum {
+    SCHEDULE_STATIC,
+    SCHEDULE_DYNAMIC
+} ScheduleMode;
+
+/* Blocos por processo usados por padrão no escalonamento dinâmico. */
+#define DEFAULT_CHUNKS_PER_RANK 16
+
+/*
+ * Fila de blocos de trabalho. No modo estático cada rank processa a própria
+ * fatia: um único bloco ou, com `split_static` (usado pelo --reduce
+ * pipeline), `chunks_per_rank` blocos consecutivos, na ordem. No dinâmico a entrada é dividida em `chunk_count` blocos
+ * alinhados a registros e o próximo bloco livre vem de um contador no rank 0,
+ * incrementado com MPI_Fetch_and_op sob uma janela de acesso passivo, de modo
+ * que os processos mais rápidos pegam mais blocos. `spans` guarda, para a
+ * saída por música, o trecho de song_rows gerado por cada bloco, e
+ * `sentiment_spans` o de sentiment_rows.
+ */
+typedef struct {
+    ScheduleMode mode;
+    long long chunk_count;
+    long long chunks_taken;
+    long long next_static;
+    long long static_end;
+    int split_static;
+    ByteBuffer spans;
+    ByteBuffer sentiment_spans;
+    MPI_Win window;
+    long long *counter;
+} WorkSchedule;
+
+static void schedule_begin(WorkSchedule *schedule, int chunks_per_rank, int rank, int world_size, MPI_Comm comm) {
+    schedule->chunks_taken = 0;
+    schedule->spans.size = 0;
+    schedule->sentiment_spans.size = 0;
+    if (schedule->mode == SCHEDULE_STATIC) {
+        long long per_rank = schedule->split_static ? chunks_per_rank : 1;
+        schedule->chunk_count = per_rank * world_size;
+        schedule->next_static = rank * per_rank;
+        schedule->static_end = schedule->next_static + per_rank;
+        return;
+    }
+    schedule->chunk_count = (long long)chunks_per_rank * world_size;
+    MPI_Aint window_size = rank == 0 ? (MPI_Aint)sizeof(long long) : 0;
+    if (MPI_Win_allocate(window_size, (int)sizeof(long long), MPI_INFO_NULL, comm, &schedule->counter,
+                         &schedule->window) != MPI_SUCCESS) {
+        fprintf(stderr, "Rank %d failed to create the work queue window\n", rank);
+        MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
+    }
+    if (rank == 0) {
+        MPI_Win_lock(MPI_LOCK_EXCLUSIVE, 0, 0, schedule->window);
+        *schedule->counter = 0;
+        MPI_Win_unlock(0, schedule->window);
+    }
+    MPI_Barrier(comm);
+}
+
+/* Obtém o próximo bloco a processar; retorna 0 quando a fila acabou. */
+static int schedule_next(WorkSchedule *schedule, long long *chunk) {
+    long long taken = schedule->next_static;
+    if (schedule->mode == SCHEDULE_DYNAMIC) {
+        const long long one = 1;
+        MPI_Win_lock(MPI_LOCK_SHARED, 0, 0, schedule->window);
+        MPI_Fetch_and_op(&one, &taken, MPI_LONG_LONG, 0, 0, MPI_SUM, schedule->window);
+        MPI_Win_unlock(0, schedule->window);
+    } else if (taken < schedule->static_end) {
+        schedule->next_static++;
+    } else {
+        taken = schedule->chunk_count;
+    }
+    if (taken >= schedule->chunk_count) {
+        return 0;
+    }
+    schedule->chunks_taken++;
+    *chunk = taken;
+    return 1;
+}
+
+/* Registra em `spans` o trecho [begin, end) de um buffer de linhas produzido pelo bloco `chunk`. */
+static void schedule_record_rows(ByteBuffer *spans, long long chunk, size_t begin, size_t end) {
+    RowSpan span = {(uint64_t)chunk, begin, end};
+    byte_buffer_append(spans, &span, sizeof(span));
+}
+
+static void schedule_end(WorkSchedule *schedule) {
+    if (schedule->mode == SCHEDULE_DYNAMIC) {
+        MPI_Win_free(&schedule->window);
+    }
+}
+
+/* Situação do cache na execução, exportada nas métricas. */
+typedef enum {
+    CACHE_OFF,
+    CACHE_HIT,
+    CACHE_BUILT
+} CacheState;
+
+/* Bytes do início e do fim de um trecho do CSV que entram nos hashes de identificação. */
+#define SOURCE_SAMPLE_BYTES ((size_t)1 << 20)
+
+/*
+ * Hash FNV-1a do primeiro e do último MiB do trecho [0, end) de `fp`, usado
+ * para reconhecer a versão do CSV que gerou um cache ou um snapshot.
+ */
+static uint64_t source_sample_hash(FILE *fp, uint64_t end) {
+    unsigned char *block = (unsigned char *)malloc(SOURCE_SAMPLE_BYTES);
+    if (!block) {
+        fprintf(stderr, "Failed to allocate dataset sample buffer\n");
+        MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
+    }
+    uint64_t hash = HASH_OFFSET_BASIS;
+    uint64_t samples[2] = {0, end > SOURCE_SAMPLE_BYTES ? end - SOURCE_SAMPLE_BYTES : 0};
+    for (int s = 0; s < 2; ++s) {
+        size_t wanted = end - samples[s] < SOURCE_SAMPLE_BYTES ? (size_t)(end - samples[s]) : SOURCE_SAMPLE_BYTES;
+        size_t got = fseeko(fp, (off_t)samples[s], SEEK_SET) == 0 ? fread(block, 1, wanted, fp) : 0;
+        for (size_t i = 0; i < got; ++i) {
+            hash = hash_step(hash, block[i]);
+        }
+    }
+    free(block);
+    return hash;
+}
+
+/*
+ * Resume a política de tokenização ativa (comprimento mínimo, apóstrofos,
+ * letras UTF-8 e o conjunto de stop words) em um hash gravado no índice.
+ * As stop words entram como soma dos hashes, independente da ordem.
+ */
+static uint64_t token_policy_fingerprint(void) {
+    uint64_t fields[4] = {(uint64_t)token_policy.min_length, (uint64_t)token_policy.apostrophes,
+                          (uint64_t)token_policy.utf8_letters, 0};
+    if (token_policy.is_stopword == default_stopword) {
+        for (size_t i = 0; i < sizeof(stopword_table) / sizeof(stopword_table[0]); ++i) {
+            if (stopword_table[i].data) {
+                fields[3] += hash_bytes(stopword_table[i].data, stopword_table[i].length);
+            }
+        }
+    } else if (token_policy.is_stopword == custom_stopword) {
+        for (size_t i = 0; i < custom_stopwords.capacity; ++i) {
+            if (custom_stopwords.entries[i].key) {
+                fields[3] += custom_stopwords.entries[i].hash;
+            }
+        }
+    }
+    return hash_bytes((const char *)fields, sizeof(fields));
+}
+
+#define SNAPSHOT_MAGIC "PSSNAP01"
+#define SNAPSHOT_VERSION 1
+
+/*
+ * Cabeçalho do snapshot do modo incremental (--incremental). Depois dele vêm,
+ * no formato compacto das transferências MPI, as tabelas completas de
+ * palavras e de artistas. `offset` é o fim, exclusivo, do trecho do CSV já
+ * contado. O hash das amostras de [0, offset), o início dos dados e a
+ * política de tokenização garantem que a contagem só seja retomada se o CSV
+ * apenas recebeu registros no fim e as palavras são contadas da mesma forma.
+ */
+typedef struct {
+    char magic[8];
+    uint64_t version;
+    uint64_t policy_hash;
+    uint64_t data_start;
+    uint64_t offset;
+    uint64_t source_hash;
+    CountType total_songs;
+    CountType total_words;
+    uint64_t word_table_size;
+    uint64_t artist_table_size;
+} SnapshotHeader;
+
+/* Snapshot carregado pelo rank 0, com as tabelas ainda no formato compacto. */
+typedef struct {
+    SnapshotHeader header;
+    char *data;
+} ResultSnapshot;
+
+/*
+ * Executado pelo rank 0: carrega o snapshot de `path` e o valida contra o
+ * CSV atual, de `file_size` bytes. Retorna 1 quando a contagem pode ser
+ * retomada de `snapshot->header.offset`; sem snapshot válido retorna 0 e o
+ * dataset é processado por inteiro.
+ */
+static int snapshot_load(const char *path, const char *dataset_path, long long data_start, long long file_size,
+                         ResultSnapshot *snapshot) {
+    memset(snapshot, 0, sizeof(*snapshot));
+    FILE *fp = fopen(path, "rb");
+    if (!fp) {
+        return 0;
+    }
+    SnapshotHeader *header = &snapshot->header;
+    long long size = get_file_size(path);
+    int valid = size >= (long long)sizeof(*header) && fread(header, sizeof(*header), 1, fp) == 1 &&
+                memcmp(header->magic, SNAPSHOT_MAGIC, sizeof(header->magic)) == 0 &&
+                header->version == SNAPSHOT_VERSION && header->policy_hash == token_policy_fingerprint() &&
+                header->data_start == (uint64_t)data_start && header->offset <= (uint64_t)file_size &&
+                header->word_table_size <= (uint64_t)size && header->artist_table_size <= (uint64_t)size &&
+                sizeof(*header) + header->word_table_size + header->artist_table_size == (uint64_t)size;
+    size_t tables_size = valid ? (size_t)(header->word_table_size + header->artist_table_size) : 0;
+    snapshot->data = valid ? (char *)malloc(tables_size) : NULL;
+    valid = snapshot->data && fread(snapshot->data, 1, tables_size, fp) == tables_size;
+    fclose(fp);
+    if (valid) {
+        FILE *source = fopen(dataset_path, "rb");
+        valid = source && source_sample_hash(source, header->offset) == header->source_hash;
+        if (source) {
+            fclose(source);
+        }
+    }
+    if (!valid) {
+        fprintf(stderr, "Snapshot %s does not match %s, processing the whole dataset\n", path, dataset_path);
+        free(snapshot->data);
+        snapshot->data = NULL;
+    }
+    return valid;
+}
+
+/* Soma as contagens do snapshot às tabelas globais do rank 0. */
+static void snapshot_merge(const ResultSnapshot *snapshot, HashTable *word_counts, HashTable *artist_counts) {
+    ht_merge_packed(word_counts, snapshot->data, (size_t)snapshot->header.word_table_size);
+    ht_merge_packed(artist_counts, snapshot->data + snapshot->header.word_table_size,
+                    (size_t)snapshot->header.artist_table_size);
+}
+
+/*
+ * Executado pelo rank 0: grava em `path` as tabelas globais completas e o
+ * fim do trecho contado, para que a próxima execução processe só os bytes
+ * acrescentados depois de `offset`. Uma falha apenas impede a retomada.
+ */
+static void snapshot_save(const char *snapshot_dir, const char *path, const char *dataset_path,
+                          long long data_start, long long offset, CountType total_songs, CountType total_words,
+                          const HashTable *word_counts, const HashTable *artist_counts) {
+    if (ensure_directory_recursive(snapshot_dir) != 0) {
+        fprintf(stderr, "Failed to prepare snapshot directory %s: %s\n", snapshot_dir, strerror(errno));
+        return;
+    }
+    FILE *source = fopen(dataset_path, "rb");
+    if (!source) {
+        fprintf(stderr, "Failed to reopen %s for the snapshot: %s\n", dataset_path, strerror(errno));
+        return;
+    }
+    SnapshotHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic));
+    header.version = SNAPSHOT_VERSION;
+    header.policy_hash = token_policy_fingerprint();
+    header.data_start = (uint64_t)data_start;
+    header.offset = (uint64_t)offset;
+    header.source_hash = source_sample_hash(source, header.offset);
+    header.total_songs = total_songs;
+    header.total_words = total_words;
+    fclose(source);
+
+    PackedTable tables[2];
+    ht_pack(word_counts, &tables[0]);
+    ht_pack(artist_counts, &tables[1]);
+    header.word_table_size = tables[0].size;
+    header.artist_table_size = tables[1].size;
+    StringView sections[2] = {{tables[0].data, tables[0].size}, {tables[1].data, tables[1].size}};
+    write_sections_atomically(path, "snapshot", &header, sizeof(header), sections, 2);
+    free(tables[0].data);
+    free(tables[1].data);
+}
+
+#ifdef HAVE_MMAP
+#define CACHE_MAGIC "PSCACHE1"
+#define CACHE_VERSION 1
+#define CACHE_NO_ARTIST UINT32_MAX
+
+/*
+ * Cabeçalho do cache colunar binário do dataset (--cache). Depois dele vêm,
+ * cada seção alinhada a 8 bytes:
+ *   artist_offsets[artist_count + 1] e o bloco com os nomes dos artistas;
+ *   record_artists[record_count], o id do artista de cada música;
+ *   song_offsets[record_count + 1] e o bloco com os títulos;
+ *   lyrics_offsets[record_count + 1] e o bloco com as letras já sem aspas.
+ * Os inteiros ficam na ordem de bytes nativa. Tamanho, mtime e um hash de
+ * amostras do CSV de origem identificam a versão do arquivo que gerou o
+ * cache, que é refeito quando qualquer um deles muda.
+ */
+typedef struct {
+    char magic[8];
+    uint64_t version;
+    uint64_t source_size;
+    int64_t source_mtime;
+    uint64_t source_hash;
+    uint64_t record_count;
+    uint64_t artist_count;
+    uint64_t artist_blob_size;
+    uint64_t song_blob_size;
+    uint64_t lyrics_blob_size;
+} CacheHeader;
+
+/* Cache mapeado em memória, com ponteiros para cada coluna. */
+typedef struct {
+    void *mapping;
+    size_t mapping_size;
+    CacheHeader header;
+    const uint64_t *artist_offsets;
+    const char *artist_blob;
+    const uint32_t *record_artists;
+    const uint64_t *song_offsets;
+    const char *song_blob;
+    const uint64_t *lyrics_offsets;
+    const char *lyrics_blob;
+} DatasetCache;
+
+/*
+ * Calcula a posição de cada seção descrita pelo cabeçalho e devolve o tamanho
+ * total do arquivo. Com `base` não nulo, também aponta as colunas de `cache`.
+ */
+static uint64_t cache_layout(const CacheHeader *header, const char *base, DatasetCache *cache) {
+    uint64_t offset = sizeof(CacheHeader);
+    uint64_t artist_offsets = offset;
+    offset += (header->artist_count + 1U) * sizeof(uint64_t);
+    uint64_t artist_blob = offset;
+    offset = align8(offset + header->artist_blob_size);
+    uint64_t record_artists = offset;
+    offset = align8(offset + header->record_count * sizeof(uint32_t));
+    uint64_t song_offsets = offset;
+    offset += (header->record_count + 1U) * sizeof(uint64_t);
+    uint64_t song_blob = offset;
+    offset = align8(offset + header->song_blob_size);
+    uint64_t lyrics_offsets = offset;
+    offset += (header->record_count + 1U) * sizeof(uint64_t);
+    uint64_t lyrics_blob = offset;
+    offset = align8(offset + header->lyrics_blob_size);
+    if (base && cache) {
+        cache->artist_offsets = (const uint64_t *)(base + artist_offsets);
+        cache->artist_blob = base + artist_blob;
+        cache->record_artists = (const uint32_t *)(base + record_artists);
+        cache->song_offsets = (const uint64_t *)(base + song_offsets);
+        cache->song_blob = base + song_blob;
+        cache->lyrics_offsets = (const uint64_t *)(base + lyrics_offsets);
+        cache->lyrics_blob = base + lyrics_blob;
+    }
+    return offset;
+}
+
+/*
+ * Preenche os campos de identificação do CSV de origem: tamanho, mtime e o
+ * hash FNV-1a do primeiro e do último MiB. Retorna 0 se o arquivo não puder
+ * ser lido.
+ */
+static int cache_source_identity(const char *dataset_path, CacheHeader *identity) {
+    struct stat st;
+    if (stat(dataset_path, &st) != 0) {
+        return 0;
+    }
+    FILE *fp = fopen(dataset_path, "rb");
+    if (!fp) {
+        return 0;
+    }
+    uint64_t size = (uint64_t)st.st_size;
+    uint64_t hash = source_sample_hash(fp, size);
+    fclose(fp);
+    memset(identity, 0, sizeof(*identity));
+    identity->source_size = size;
+    identity->source_mtime = (int64_t)st.st_mtime;
+    identity->source_hash = hash;
+    return 1;
+}
+
+/*
+ * Mapeia o CSV inteiro para leitura sequencial. Devolve NULL para um arquivo
+ * vazio e MAP_FAILED, já com a mensagem de erro, se ele não puder ser mapeado.
+ */
+static void *map_dataset_file(const char *dataset_path, size_t file_size) {
+    int fd = open(dataset_path, O_RDONLY);
+    if (fd < 0) {
+        fprintf(stderr, "Failed to open dataset %s: %s\n", dataset_path, strerror(errno));
+        return MAP_FAILED;
+    }
+    void *mapping = NULL;
+    if (file_size > 0) {
+        mapping = mmap(NULL, file_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    }
+    close(fd);
+    if (mapping == MAP_FAILED) {
+        fprintf(stderr, "Failed to map dataset %s: %s\n", dataset_path, strerror(errno));
+    } else if (mapping) {
+        madvise(mapping, file_size, MADV_SEQUENTIAL);
+    }
+    return mapping;
+}
+
+/* Prepara a varredura dos registros do CSV mapeado, a partir de `data_start`. */
+static CsvScanner *dataset_scanner_create(const void *mapping, size_t file_size, long long data_start) {
+    CsvScanner *scanner = (CsvScanner *)malloc(sizeof(CsvScanner));
+    if (!scanner) {
+        fprintf(stderr, "Failed to allocate CSV scanner\n");
+        MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
+    }
+    size_t records_start = (size_t)data_start < file_size ? (size_t)data_start : file_size;
+    csv_scanner_reset(scanner, (const char *)mapping + records_start, file_size - records_start);
+    return scanner;
+}
+
+/* Registra o artista de um registro no dicionário, ou CACHE_NO_ARTIST se vazio. */
+static void intern_artist(Interner *artists, StringView artist) {
+    if (artist.length > 0) {
+        intern_key(artists, artist.data, artist.length, hash_bytes(artist.data, artist.length));
+    } else {
+        uint32_t none = CACHE_NO_ARTIST;
+        byte_buffer_append(&artists->ids, &none, sizeof(none));
+    }
+}
+
+/*
+ * Monta o cache a partir do CSV original em um único passo pelo índice
+ * estrutural e o grava em `cache_path`. Executado apenas pelo rank 0.
+ * Retorna 1 em sucesso e 0 em falha.
+ */
+static int dataset_cache_build(const char *dataset_path, long long data_start, const char *cache_path,
+                               const CacheHeader *identity) {
+    size_t file_size = (size_t)identity->source_size;
+    void *mapping = map_dataset_file(dataset_path, file_size);
+    if (mapping == MAP_FAILED) {
+        return 0;
+    }
+    CsvScanner *scanner = dataset_scanner_create(mapping, file_size, data_start);
+
+    Interner artists;
+    interner_init(&artists, 8192);
+    ByteBuffer song_offsets = {0};
+    ByteBuffer song_blob = {0};
+    ByteBuffer lyrics_offsets = {0};
+    ByteBuffer lyrics_blob = {0};
+    byte_buffer_append_u64(&song_offsets, 0);
+    byte_buffer_append_u64(&lyrics_offsets, 0);
+    char *scratch[3] = {NULL, NULL, NULL};
+    size_t scratch_cap[3] = {0, 0, 0};
+    uint64_t record_count = 0;
+
+    CsvRecordView record;
+    size_t pos = 0;
+    while (pos < scanner->length) {
+        pos = next_csv_record(scanner, pos, &record);
+        if (record.field_count < CSV_FIELD_COUNT) {
+            continue;
+        }
+        StringView artist = view_unquote(record.fields[0], &scratch[0], &scratch_cap[0]);
+        StringView song = view_unquote(record.fields[1], &scratch[1], &scratch_cap[1]);
+        StringView lyrics = view_unquote(record.fields[CSV_FIELD_COUNT - 1], &scratch[2], &scratch_cap[2]);
+        intern_artist(&artists, artist);
+        byte_buffer_append(&song_blob, song.data, song.length);
+        byte_buffer_append_u64(&song_offsets, song_blob.size);
+        byte_buffer_append(&lyrics_blob, lyrics.data, lyrics.length);
+        byte_buffer_append_u64(&lyrics_offsets, lyrics_blob.size);
+        record_count++;
+    }
+    free(scanner);
+    if (mapping) {
+        munmap(mapping, file_size);
+    }
+
+    CacheHeader header = *identity;
+    memcpy(header.magic, CACHE_MAGIC, sizeof(header.magic));
+    header.version = CACHE_VERSION;
+    header.record_count = record_count;
+    header.artist_count = artists.count;
+    header.artist_blob_size = artists.blob.size;
+    header.song_blob_size = song_blob.size;
+    header.lyrics_blob_size = lyrics_blob.size;
+    const StringView sections[] = {
+        {artists.offsets.data, artists.offsets.size}, {artists.blob.data, artists.blob.size},
+        {artists.ids.data, artists.ids.size},         {song_offsets.data, song_offsets.size},
+        {song_blob.data, song_blob.size},             {lyrics_offsets.data, lyrics_offsets.size},
+        {lyrics_blob.data, lyrics_blob.size},
+    };
+    int ok = write_sections_atomically(cache_path, "dataset cache", &header, sizeof(header), sections,
+                                       sizeof(sections) / sizeof(sections[0]));
+
+    for (int i = 0; i < 3; ++i) {
+        free(scratch[i]);
+    }
+    free(song_offsets.data);
+    free(song_blob.data);
+    free(lyrics_offsets.data);
+    free(lyrics_blob.data);
+    interner_free(&artists);
+    return ok;
+}
+
+/*
+ * Mapeia por inteiro, somente para leitura, um arquivo gerado por esta
+ * aplicação (cache ou índice). Devolve NULL se o arquivo não existir, não
+ * puder ser mapeado ou for menor que `min_size`.
+ */
+static void *map_binary_file(const char *path, size_t min_size, size_t *size) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return NULL;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (uint64_t)st.st_size < min_size) {
+        close(fd);
+        return NULL;
+    }
+    *size = (size_t)st.st_size;
+    void *mapping = mmap(NULL, *size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    return mapping == MAP_FAILED ? NULL : mapping;
+}
+
+/*
+ * Mapeia o cache e valida cabeçalho e tamanho. Com `identity` não nulo, o
+ * cache só é aceito se foi gerado a partir da mesma versão do CSV. Retorna 1
+ * quando o cache pode ser usado.
+ */
+static int dataset_cache_open(const char *cache_path, const CacheHeader *identity, DatasetCache *cache) {
+    memset(cache, 0, sizeof(*cache));
+    size_t size = 0;
+    void *mapping = map_binary_file(cache_path, sizeof(CacheHeader), &size);
+    if (!mapping) {
+        return 0;
+    }
+    const CacheHeader *header = (const CacheHeader *)mapping;
+    int valid = memcmp(header->magic, CACHE_MAGIC, sizeof(header->magic)) == 0 &&
+                header->version == CACHE_VERSION && header->record_count < size / sizeof(uint32_t) &&
+                header->artist_count < size / sizeof(uint64_t) && header->artist_blob_size <= size &&
+                header->song_blob_size <= size && header->lyrics_blob_size <= size &&
+                cache_layout(header, NULL, NULL) == (uint64_t)size;
+    if (valid && identity) {
+        valid = header->source_size == identity->source_size && header->source_mtime == identity->source_mtime &&
+                header->source_hash == identity->source_hash;
+    }
+    if (!valid) {
+        munmap(mapping, size);
+        return 0;
+    }
+    cache->mapping = mapping;
+    cache->mapping_size = size;
+    cache->header = *header;
+    cache_layout(header, (const char *)mapping, cache);
+    return 1;
+}
+
+static void dataset_cache_close(DatasetCache *cache) {
+    if (cache->mapping) {
+        munmap(cache->mapping, cache->mapping_size);
+        cache->mapping = NULL;
+    }
+}
+
+/*
+ * Devolve o índice do registro em [first, last] que marca o início da parte
+ * `part` de `parts`, equilibrando as partes pelo volume de letras. Como os
+ * deslocamentos já estão no cache, a partição é exata e não exige resolver
+ * fronteiras de registros.
+ */
+static uint64_t cache_split_point(const DatasetCache *cache, uint64_t first, uint64_t last, int part, int parts) {
+    return offsets_split_point(cache->lyrics_offsets, first, last, part, parts);
+}
+
+/*
+ * Processa os registros [first, last) do cache. As músicas de cada artista
+ * são contadas por id em um vetor e só chegam à tabela de hash, com o nome,
+ * ao final do intervalo.
+ */
+static void analyze_cache_range(const DatasetCache *cache, uint64_t first, uint64_t last, LocalStats *stats) {
+    double started = phase_clock();
+    double inner_before = profile_inner_seconds(&stats->profile);
+    stats->profile.counters[COUNTER_BYTES_READ] +=
+        (long long)(cache->lyrics_offsets[last] - cache->lyrics_offsets[first]);
+    uint64_t artist_count = cache->header.artist_count;
+    CountType *artist_songs = NULL;
+    if (artist_count > 0) {
+        artist_songs = (CountType *)calloc((size_t)artist_count, sizeof(CountType));
+        if (!artist_songs) {
+            fprintf(stderr, "Failed to allocate artist counters\n");
+            MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
+        }
+    }
+    for (uint64_t r = first; r < last; ++r) {
+        uint32_t artist_id = cache->record_artists[r];
+        if (artist_id < artist_count) {
+            artist_songs[artist_id]++;
+        }
+        stats->song_total++;
+        uint64_t lyrics_start = cache->lyrics_offsets[r];
+        StringView lyrics = {cache->lyrics_blob + lyrics_start, (size_t)(cache->lyrics_offsets[r + 1] - lyrics_start)};
+        StringView artist = {NULL, 0};
+        StringView song = {NULL, 0};
+        if (stats->song_words) {
+            if (artist_id < artist_count) {
+                artist.data = cache->artist_blob + cache->artist_offsets[artist_id];
+                artist.length = (size_t)(cache->artist_offsets[artist_id + 1] - cache->artist_offsets[artist_id]);
+            }
+            song.data = cache->song_blob + cache->song_offsets[r];
+            song.length = (size_t)(cache->song_offsets[r + 1] - cache->song_offsets[r]);
+        }
+        process_song_lyrics(stats, artist, song, lyrics);
+    }
+    double artists_started = phase_clock();
+    for (uint64_t a = 0; a < artist_count; ++a) {
+        if (artist_songs[a] > 0) {
+            uint64_t start = cache->artist_offsets[a];
+            count_artist(stats, cache->artist_blob + start, (size_t)(cache->artist_offsets[a + 1] - start),
+                         artist_songs[a]);
+        }
+    }
+    stats->profile.seconds[PHASE_ARTISTS] += phase_clock() - artists_started;
+    free(artist_songs);
+    profile_add_read(&stats->profile, started, inner_before);
+}
+
+#define INDEX_MAGIC "PSINDEX1"
+#define INDEX_VERSION 1
+
+/* Maior quantidade de contadores somada por chamada de MPI_Reduce. */
+#define DENSE_REDUCE_CHUNK ((size_t)1 << 24)
+
+/*
+ * Cabeçalho do índice de tokens (--index): cada música é guardada como uma
+ * sequência de ids de 32 bits sobre um vocabulário global, já com a política
+ * de tokenização aplicada. Depois dele vêm, cada seção alinhada a 8 bytes:
+ *   artist_offsets[artist_count + 1] e o bloco com os nomes dos artistas;
+ *   record_artists[record_count], o id do artista de cada música;
+ *   song_offsets[record_count + 1] e o bloco com os títulos;
+ *   vocab_offsets[vocab_count + 1] e o bloco com as palavras do vocabulário;
+ *   token_offsets[record_count + 1] e tokens[token_count], os ids das
+ *   palavras de cada música, na ordem da letra.
+ * A identificação do CSV segue a do cache; `policy_hash` resume a política
+ * de tokenização, e o índice é refeito quando ela muda.
+ */
+typedef struct {
+    char magic[8];
+    uint64_t version;
+    uint64_t source_size;
+    int64_t source_mtime;
+    uint64_t source_hash;
+    uint64_t policy_hash;
+    uint64_t record_count;
+    uint64_t artist_count;
+    uint64_t artist_blob_size;
+    uint64_t song_blob_size;
+    uint64_t vocab_count;
+    uint64_t vocab_blob_size;
+    uint64_t token_count;
+} IndexHeader;
+
+/* Índice de tokens mapeado em memória, com ponteiros para cada seção. */
+typedef struct {
+    void *mapping;
+    size_t mapping_size;
+    IndexHeader header;
+    const uint64_t *artist_offsets;
+    const char *artist_blob;
+    const uint32_t *record_artists;
+    const uint64_t *song_offsets;
+    const char *song_blob;
+    const uint64_t *vocab_offsets;
+    const char *vocab_blob;
+    const uint64_t *token_offsets;
+    const uint32_t *tokens;
+} TokenIndex;
+
+/* Equivalente a cache_layout para o índice de tokens. */
+static uint64_t token_index_layout(const IndexHeader *header, const char *base, TokenIndex *index) {
+    uint64_t offset = sizeof(IndexHeader);
+    uint64_t artist_offsets = offset;
+    offset += (header->artist_count + 1U) * sizeof(uint64_t);
+    uint64_t artist_blob = offset;
+    offset = align8(offset + header->artist_blob_size);
+    uint64_t record_artists = offset;
+    offset = align8(offset + header->record_count * sizeof(uint32_t));
+    uint64_t song_offsets = offset;
+    offset += (header->record_count + 1U) * sizeof(uint64_t);
+    uint64_t song_blob = offset;
+    offset = align8(offset + header->song_blob_size);
+    uint64_t vocab_offsets = offset;
+    offset += (header->vocab_count + 1U) * sizeof(uint64_t);
+    uint64_t vocab_blob = offset;
+    offset = align8(offset + header->vocab_blob_size);
+    uint64_t token_offsets = offset;
+    offset += (header->record_count + 1U) * sizeof(uint64_t);
+    uint64_t tokens = offset;
+    offset = align8(offset + header->token_count * sizeof(uint32_t));
+    if (base && index) {
+        index->artist_offsets = (const uint64_t *)(base + artist_offsets);
+        index->artist_blob = base + artist_blob;
+        index->record_artists = (const uint32_t *)(base + record_artists);
+        index->song_offsets = (const uint64_t *)(base + song_offsets);
+        index->song_blob = base + song_blob;
+        index->vocab_offsets = (const uint64_t *)(base + vocab_offsets);
+        index->vocab_blob = base + vocab_blob;
+        index->token_offsets = (const uint64_t *)(base + token_offsets);
+        index->tokens = (const uint32_t *)(base + tokens);
+    }
+    return offset;
+}
+
+/*
+ * Monta o índice de tokens a partir do CSV original: um único passo pelo
+ * índice estrutural tokeniza cada letra com a política ativa e converte os
+ * tokens em ids do vocabulário, atribuídos por ordem de primeira ocorrência.
+ * Executado apenas pelo rank 0. Retorna 1 em sucesso e 0 em falha.
+ */
+static int token_index_build(const char *dataset_path, long long data_start, const char *index_path,
+                             const IndexHeader *identity) {
+    size_t file_size = (size_t)identity->source_size;
+    void *mapping = map_dataset_file(dataset_path, file_size);
+    if (mapping == MAP_FAILED) {
+        return 0;
+    }
+    CsvScanner *scanner = dataset_scanner_create(mapping, file_size, data_start);
+
+    Interner artists;
+    Interner words;
+    interner_init(&artists, 8192);
+    interner_init(&words, 65536);
+    ByteBuffer song_offsets = {0};
+    ByteBuffer song_blob = {0};
+    ByteBuffer token_offsets = {0};
+    byte_buffer_append_u64(&song_offsets, 0);
+    byte_buffer_append_u64(&token_offsets, 0);
+    char *scratch[2] = {NULL, NULL};
+    size_t scratch_cap[2] = {0, 0};
+    uint64_t record_count = 0;
+    CountType token_count = 0;
+
+    CsvRecordView record;
+    size_t pos = 0;
+    while (pos < scanner->length) {
+        pos = next_csv_record(scanner, pos, &record);
+        if (record.field_count < CSV_FIELD_COUNT) {
+            continue;
+        }
+        StringView artist = view_unquote(record.fields[0], &scratch[0], &scratch_cap[0]);
+        StringView song = view_unquote(record.fields[1], &scratch[1], &scratch_cap[1]);
+        StringView lyrics = record.fields[CSV_FIELD_COUNT - 1];
+        intern_artist(&artists, artist);
+        byte_buffer_append(&song_blob, song.data, song.length);
+        byte_buffer_append_u64(&song_offsets, song_blob.size);
+        if (lyrics.length > 0) {
+            process_lyrics_ids(&words, lyrics.data, lyrics.length, &token_count);
+        }
+        byte_buffer_append_u64(&token_offsets, (uint64_t)token_count);
+        record_count++;
+    }
+    free(scanner);
+    if (mapping) {
+        munmap(mapping, file_size);
+    }
+
+    IndexHeader header = *identity;
+    memcpy(header.magic, INDEX_MAGIC, sizeof(header.magic));
+    header.version = INDEX_VERSION;
+    header.record_count = record_count;
+    header.artist_count = artists.count;
+    header.artist_blob_size = artists.blob.size;
+    header.song_blob_size = song_blob.size;
+    header.vocab_count = words.count;
+    header.vocab_blob_size = words.blob.size;
+    header.token_count = (uint64_t)token_count;
+    const StringView sections[] = {
+        {artists.offsets.data, artists.offsets.size}, {artists.blob.data, artists.blob.size},
+        {artists.ids.data, artists.ids.size},         {song_offsets.data, song_offsets.size},
+        {song_blob.data, song_blob.size},             {words.offsets.data, words.offsets.size},
+        {words.blob.data, words.blob.size},           {token_offsets.data, token_offsets.size},
+        {words.ids.data, words.ids.size},
+    };
+    int ok = write_sections_atomically(index_path, "token index", &header, sizeof(header), sections,
+                                       sizeof(sections) / sizeof(sections[0]));
+
+    for (int i = 0; i < 2; ++i) {
+        free(scratch[i]);
+    }
+    free(song_offsets.data);
+    free(song_blob.data);
+    free(token_offsets.data);
+    interner_free(&artists);
+    interner_free(&words);
+    return ok;
+}
+
+/*
+ * Mapeia o índice e valida cabeçalho e tamanho. Com `identity` não nulo, o
+ * índice só é aceito se foi gerado a partir da mesma versão do CSV e com a
+ * mesma política de tokenização. Retorna 1 quando o índice pode ser usado.
+ */
+static int token_index_open(const char *index_path, const IndexHeader *identity, TokenIndex *index) {
+    memset(index, 0, sizeof(*index));
+    size_t size = 0;
+    void *mapping = map_binary_file(index_path, sizeof(IndexHeader), &size);
+    if (!mapping) {
+        return 0;
+    }
+    const IndexHeader *header = (const IndexHeader *)mapping;
+    int valid = memcmp(header->magic, INDEX_MAGIC, sizeof(header->magic)) == 0 &&
+                header->version == INDEX_VERSION && header->record_count < size / sizeof(uint32_t) &&
+                header->artist_count < size / sizeof(uint64_t) && header->vocab_count < size / sizeof(uint64_t) &&
+                header->token_count < size / sizeof(uint32_t) && header->artist_blob_size <= size &&
+                header->song_blob_size <= size && header->vocab_blob_size <= size &&
+                token_index_layout(header, NULL, NULL) == (uint64_t)size;
+    if (valid && identity) {
+        valid = header->source_size == identity->source_size && header->source_mtime == identity->source_mtime &&
+                header->source_hash == identity->source_hash && header->policy_hash == identity->policy_hash;
+    }
+    if (!valid) {
+        munmap(mapping, size);
+        return 0;
+    }
+    index->mapping = mapping;
+    index->mapping_size = size;
+    index->header = *header;
+    token_index_layout(header, (const char *)mapping, index);
+    return 1;
+}
+
+static void token_index_close(TokenIndex *index) {
+    if (index->mapping) {
+        munmap(index->mapping, index->mapping_size);
+        index->mapping = NULL;
+    }
+}
+
+/*
+ * Executado pelo rank 0: reaproveita o índice de `dataset_path` se ele
+ * corresponder à versão atual do CSV e à política de tokenização, ou o
+ * reconstrói. Retorna CACHE_OFF se o índice não puder ser usado.
+ */
+static CacheState prepare_token_index(const char *dataset_path, long long data_start, const char *index_dir,
+                                      const char *index_path) {
+    CacheHeader source;
+    if (!cache_source_identity(dataset_path, &source)) {
+        fprintf(stderr, "Failed to inspect dataset %s for indexing\n", dataset_path);
+        return CACHE_OFF;
+    }
+    IndexHeader identity;
+    memset(&identity, 0, sizeof(identity));
+    identity.source_size = source.source_size;
+    identity.source_mtime = source.source_mtime;
+    identity.source_hash = source.source_hash;
+    identity.policy_hash = token_policy_fingerprint();
+    TokenIndex index;
+    if (token_index_open(index_path, &identity, &index)) {
+        token_index_close(&index);
+        return CACHE_HIT;
+    }
+    if (ensure_directory_recursive(index_dir) != 0) {
+        fprintf(stderr, "Failed to prepare index directory %s: %s\n", index_dir, strerror(errno));
+        return CACHE_OFF;
+    }
+    return token_index_build(dataset_path, data_start, index_path, &identity) ? CACHE_BUILT : CACHE_OFF;
+}
+
+/*
+ * Soma os contadores densos de todos os processos no rank 0, em blocos que
+ * respeitam o limite de `int` do MPI. Retorna os bytes enviados pelo processo.
+ */
+static long long reduce_dense_counts(CountType *counts, size_t count, int rank, MPI_Comm comm) {
+    long long bytes_sent = 0;
+    for (size_t offset = 0; offset < count; offset += DENSE_REDUCE_CHUNK) {
+        size_t chunk = count - offset < DENSE_REDUCE_CHUNK ? count - offset : DENSE_REDUCE_CHUNK;
+        if (rank == 0) {
+            MPI_Reduce(MPI_IN_PLACE, counts + offset, (int)chunk, MPI_LONG_LONG, MPI_SUM, 0, comm);
+        } else {
+            MPI_Reduce(counts + offset, NULL, (int)chunk, MPI_LONG_LONG, MPI_SUM, 0, comm);
+            bytes_sent += (long long)(chunk * sizeof(CountType));
+            rank_profile.counters[COUNTER_MESSAGES]++;
+        }
+    }
+    return bytes_sent;
+}
+
+/* Aloca `count` contadores zerados (ao menos um, para simplificar os laços). */
+static CountType *dense_counts_alloc(uint64_t count) {
+    CountType *counts = (CountType *)calloc(count ? (size_t)count : 1U, sizeof(CountType));
+    if (!counts) {
+        fprintf(stderr, "Failed to allocate %llu dense counters\n", (unsigned long long)count);
+        MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
+    }
+    return counts;
+}
+
+/* Devolve a chave `id` de um dicionário do índice (artistas ou vocabulário). */
+static StringView index_string(const uint64_t *offsets, const char *blob, uint64_t id) {
+    StringView view = {blob + offsets[id], (size_t)(offsets[id + 1] - offsets[id])};
+    return view;
+}
+
+/* Copia para `table` as chaves de `offsets`/`blob` com contagem positiva. */
+static void dense_counts_to_table(const CountType *counts, uint64_t count, const uint64_t *offsets,
+                                  const char *blob, HashTable *table) {
+    for (uint64_t id = 0; id < count; ++id) {
+        if (counts[id] > 0) {
+            StringView key = index_string(offsets, blob, id);
+            ht_put_len(table, key.data, key.length, counts[id]);
+        }
+    }
+}
+
+/*
+ * Contagem sobre o índice com saídas detalhadas: as palavras de cada música
+ * são somadas em `song_counts`, com os ids anotados em `order` na primeira
+ * ocorrência, e então seguem para o histograma global `word_counts` e para
+ * as linhas por música e os pares por artista.
+ */
+static void analyze_index_details(const TokenIndex *index, uint64_t first, uint64_t last, CountType *word_counts,
+                                  LocalStats *stats) {
+    const IndexHeader *header = &index->header;
+    CountType *song_counts = dense_counts_alloc(header->vocab_count);
+    size_t order_capacity = header->vocab_count ? (size_t)header->vocab_count : 1U;
+    uint32_t *order = (uint32_t *)malloc(order_capacity * sizeof(uint32_t));
+    if (!order) {
+        fprintf(stderr, "Failed to allocate song word order\n");
+        MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
+    }
+    for (uint64_t r = first; r < last; ++r) {
+        size_t distinct = 0;
+        for (uint64_t t = index->token_offsets[r]; t < index->token_offsets[r + 1]; ++t) {
+            uint32_t id = index->tokens[t];
+            if (song_counts[id]++ == 0) {
+                order[distinct++] = id;
+            }
+        }
+        uint32_t artist_id = index->record_artists[r];
+        StringView artist = {NULL, 0};
+        if (artist_id < header->artist_count) {
+            artist = index_string(index->artist_offsets, index->artist_blob, artist_id);
+        }
+        StringView song = index_string(index->song_offsets, index->song_blob, r);
+        if (detail_outputs.sentiment_scores || (detail_outputs.per_song && distinct > 0)) {
+            format_song_prefix(&stats->song_words->prefix, artist, song);
+        }
+        unsigned sentiment_mask = 0;
+        for (size_t i = 0; i < distinct; ++i) {
+            uint32_t id = order[i];
+            CountType count = song_counts[id];
+            StringView word = index_string(index->vocab_offsets, index->vocab_blob, id);
+            word_counts[id] += count;
+            song_counts[id] = 0;
+            if (detail_outputs.sentiment) {
+                sentiment_mask |= sentiment_word_mask(word.data, word.length);
+            }
+            if (detail_outputs.per_song) {
+                append_song_row(&stats->song_rows, &stats->song_words->prefix, word.data, word.length, count);
+            }
+            if (detail_outputs.artist_words && artist.length > 0) {
+                add_artist_word(&stats->artist_words, artist, word.data, word.length, count,
+                                &stats->song_words->scratch);
+            }
+        }
+        if (detail_outputs.artist_stats && artist.length > 0) {
+            add_artist_word(&stats->artist_words, artist, "", 0, 1, &stats->song_words->scratch);
+        }
+        if (detail_outputs.sentiment) {
+            record_song_sentiment(stats, artist, &stats->song_words->prefix, sentiment_mask,
+                                  &stats->song_words->scratch);
+        }
+    }
+    free(order);
+    free(song_counts);
+}
+
+/*
+ * Analisa a parte do processo a partir do índice de tokens já validado pelo
+ * rank 0. Os registros são divididos pelo número de tokens; palavras e
+ * artistas viram histogramas densos indexados por id, somados no rank 0 com
+ * MPI_Reduce, que só então converte os ids com contagem positiva em chaves.
+ * As tabelas dos demais processos ficam vazias, e a redução de tabelas que
+ * vem depois praticamente não transfere dados. Retorna os bytes enviados.
+ */
+static long long analyze_indexed_dataset(const char *index_path, WorkSchedule *schedule, LocalStats *stats,
+                                         int rank) {
+    TokenIndex index;
+    if (!token_index_open(index_path, NULL, &index)) {
+        fprintf(stderr, "Rank %d failed to open token index %s\n", rank, index_path);
+        MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
+    }
+    const IndexHeader *header = &index.header;
+    CountType *word_counts = dense_counts_alloc(header->vocab_count);
+    CountType *artist_counts = dense_counts_alloc(header->artist_count);
+
+    long long chunk = 0;
+    int parts = (int)schedule->chunk_count;
+    while (schedule_next(schedule, &chunk)) {
+        uint64_t first = offsets_split_point(index.token_offsets, 0, header->record_count, (int)chunk, parts);
+        uint64_t last = offsets_split_point(index.token_offsets, 0, header->record_count, (int)chunk + 1, parts);
+        size_t rows_begin = stats->song_rows.size;
+        size_t scores_begin = stats->sentiment_rows.size;
+        double started = phase_clock();
+        for (uint64_t r = first; r < last; ++r) {
+            uint32_t artist_id = index.record_artists[r];
+            if (artist_id < header->artist_count) {
+                artist_counts[artist_id]++;
+            }
+        }
+        double tokens_started = phase_clock();
+        stats->profile.seconds[PHASE_ARTISTS] += tokens_started - started;
+        const uint64_t token_end = index.token_offsets[last];
+        if (stats->song_words) {
+            analyze_index_details(&index, first, last, word_counts, stats);
+        } else {
+            for (uint64_t t = index.token_offsets[first]; t < token_end; ++t) {
+                word_counts[index.tokens[t]]++;
+            }
+        }
+        stats->profile.seconds[PHASE_TOKENIZE] += phase_clock() - tokens_started;
+        stats->profile.counters[COUNTER_BYTES_READ] +=
+            (long long)((token_end - index.token_offsets[first]) * sizeof(uint32_t));
+        stats->song_total += (CountType)(last - first);
+        stats->word_total += (CountType)(token_end - index.token_offsets[first]);
+        schedule_record_rows(&schedule->spans, chunk, rows_begin, stats->song_rows.size);
+        schedule_record_rows(&schedule->sentiment_spans, chunk, scores_begin, stats->sentiment_rows.size);
+    }
+
+    double communicate_started = phase_clock();
+    long long bytes_sent = reduce_dense_counts(word_counts, (size_t)header->vocab_count, rank, MPI_COMM_WORLD);
+    bytes_sent += reduce_dense_counts(artist_counts, (size_t)header->artist_count, rank, MPI_COMM_WORLD);
+    profile_add(PHASE_COMMUNICATE, communicate_started);
+    if (rank == 0) {
+        double merge_started = phase_clock();
+        dense_counts_to_table(word_counts, header->vocab_count, index.vocab_offsets, index.vocab_blob,
+                              &stats->word_counts);
+        dense_counts_to_table(artist_counts, header->artist_count, index.artist_offsets, index.artist_blob,
+                              &stats->artist_counts);
+        profile_add(PHASE_MERGE, merge_started);
+    }
+    free(word_counts);
+    free(artist_counts);
+    token_index_close(&index);
+    return bytes_sent;
+}
+
+/* Chave vaga da tabela de n-gramas; não ocorre porque os ids são menores que o limite de bits. */
+#define NGRAM_EMPTY UINT64_MAX
+
+/*
+ * Tabela de endereçamento aberto com chaves inteiras para os n-gramas
+ * (--ngrams): cada chave empacota os ids das N palavras do índice em 64
+ * bits, 64 / N bits por palavra, sem strings nem arena. Chaves e contagens
+ * ficam em vetores paralelos, e as posições vagas valem NGRAM_EMPTY.
+ */
+typedef struct {
+    uint64_t *keys;
+    CountType *values;
+    size_t capacity;
+    size_t size;
+} NgramTable;
+
+/* Par chave/contagem trocado entre os processos, com tamanho fixo de 16 bytes. */
+typedef struct {
+    uint64_t key;
+    CountType count;
+} NgramCount;
+
+static void ngram_table_init(NgramTable *table, size_t initial_capacity) {
+    table->capacity = next_power_of_two(initial_capacity < 16U ? 16U : initial_capacity);
+    table->size = 0;
+    table->keys = (uint64_t *)malloc(table->capacity * sizeof(uint64_t));
+    table->values = (CountType *)calloc(table->capacity, sizeof(CountType));
+    if (!table->keys || !table->values) {
+        fprintf(stderr, "Failed to allocate n-gram table\n");
+        MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
+    }
+    memset(table->keys, 0xFF, table->capacity * sizeof(uint64_t));
+}
+
+static void ngram_table_free(NgramTable *table) {
+    free(table->keys);
+    free(table->values);
+    memset(table, 0, sizeof(*table));
+}
+
+static void ngram_table_add(NgramTable *table, uint64_t key, CountType count);
+
+static void ngram_table_resize(NgramTable *table, size_t new_capacity) {
+    NgramTable grown;
+    ngram_table_init(&grown, new_capacity);
+    for (size_t i = 0; i < table->capacity; ++i) {
+        if (table->keys[i] != NGRAM_EMPTY) {
+            ngram_table_add(&grown, table->keys[i], table->values[i]);
+        }
+    }
+    ngram_table_free(table);
+    *table = grown;
+}
+
+static void ngram_table_add(NgramTable *table, uint64_t key, CountType count) {
+    if ((table->size + 1U) * 10U > table->capacity * 7U) {
+        ngram_table_resize(table, table->capacity * 2U);
+    }
+    size_t mask = table->capacity - 1U;
+    size_t position = (size_t)mix_hash64(key) & mask;
+    while (table->keys[position] != NGRAM_EMPTY && table->keys[position] != key) {
+        position = (position + 1U) & mask;
+    }
+    if (table->keys[position] == NGRAM_EMPTY) {
+        table->keys[position] = key;
+        table->size++;
+    }
+    table->values[position] += count;
+}
+
+/*
+ * Conta os n-gramas dos registros [first, last) do índice. As janelas não
+ * atravessam músicas e usam os tokens já filtrados pela política de
+ * tokenização. Retorna a quantidade de n-gramas contados.
+ */
+static CountType ngram_count_records(const TokenIndex *index, uint64_t first, uint64_t last, unsigned ngram_size,
+                                     NgramTable *table) {
+    unsigned bits = 64U / ngram_size;
+    uint64_t key_mask = ngram_size * bits == 64U ? UINT64_MAX : (((uint64_t)1 << (ngram_size * bits)) - 1U);
+    CountType total = 0;
+    for (uint64_t r = first; r < last; ++r) {
+        uint64_t key = 0;
+        unsigned filled = 0;
+        for (uint64_t t = index->token_offsets[r]; t < index->token_offsets[r + 1]; ++t) {
+            key = ((key << bits) | index->tokens[t]) & key_mask;
+            if (++filled >= ngram_size) {
+                ngram_table_add(table, key, 1);
+                total++;
+            }
+        }
+    }
+    return total;
+}
+
+/*
+ * Equivalente a shard_exchange para a tabela de n-gramas: os pares são
+ * agrupados pelo rank dono da chave e trocados como inteiros com um único
+ * MPI_Alltoallv. Ao final, `table` contém apenas o fragmento deste rank, com
+ * as contagens globais. Retorna os bytes enviados a outros processos.
+ */
+static long long ngram_exchange(NgramTable *table, int rank, int world_size, MPI_Comm comm) {
+    double started = phase_clock();
+    size_t *bucket_sizes = (size_t *)calloc((size_t)world_size, sizeof(size_t));
+    int *send_counts = (int *)calloc((size_t)world_size, sizeof(int));
+    int *send_displs = (int *)calloc((size_t)world_size + 1U, sizeof(int));
+    int *recv_counts = (int *)calloc((size_t)world_size, sizeof(int));
+    int *recv_displs = (int *)calloc((size_t)world_size, sizeof(int));
+    NgramCount *send_buf = (NgramCount *)malloc((table->size ? table->size : 1U) * sizeof(NgramCount));
+    if (!bucket_sizes || !send_counts || !send_displs || !recv_counts || !recv_displs || !send_buf) {
+        fprintf(stderr, "Failed to allocate n-gram exchange buffers\n");
+        MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
+    }
+    if (table->size * sizeof(NgramCount) > (size_t)INT_MAX) {
+        fprintf(stderr, "Rank %d n-gram exchange exceeds the MPI message size limit\n", rank);
+        MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
+    }
+    for (size_t i = 0; i < table->capacity; ++i) {
+        if (table->keys[i] != NGRAM_EMPTY) {
+            bucket_sizes[shard_owner(mix_hash64(table->keys[i]), world_size)]++;
+        }
+    }
+    for (int r = 0; r < world_size; ++r) {
+        send_counts[r] = (int)(bucket_sizes[r] * sizeof(NgramCount));
+        send_displs[r + 1] = send_displs[r] + send_counts[r];
+        bucket_sizes[r] = (size_t)send_displs[r] / sizeof(NgramCount);
+    }
+    for (size_t i = 0; i < table->capacity; ++i) {
+        if (table->keys[i] != NGRAM_EMPTY) {
+            int owner = shard_owner(mix_hash64(table->keys[i]), world_size);
+            NgramCount *pair = &send_buf[bucket_sizes[owner]++];
+            pair->key = table->keys[i];
+            pair->count = table->values[i];
+        }
+    }
+    size_t local_size = table->size;
+    ngram_table_free(table);
+    profile_add(PHASE_SERIALIZE, started);
+
+    started = phase_clock();
+    MPI_Alltoall(send_counts, 1, MPI_INT, recv_counts, 1, MPI_INT, comm);
+    size_t recv_total = 0;
+    for (int r = 0; r < world_size; ++r) {
+        if (recv_total + (size_t)recv_counts[r] > (size_t)INT_MAX) {
+            fprintf(stderr, "Rank %d n-gram exchange exceeds the MPI message size limit\n", rank);
+            MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
+        }
+        recv_displs[r] = (int)recv_total;
+        recv_total += (size_t)recv_counts[r];
+    }
+    NgramCount *recv_buf = (NgramCount *)malloc(recv_total ? recv_total : 1U);
+    if (!recv_buf) {
+        fprintf(stderr, "Failed to allocate n-gram receive buffer\n");
+        MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
+    }
+    MPI_Alltoallv(send_buf, send_counts, send_displs, MPI_BYTE, recv_buf, recv_counts, recv_displs, MPI_BYTE, comm);
+    long long bytes_sent = (long long)(send_displs[world_size] - send_counts[rank]);
+    rank_profile.counters[COUNTER_MESSAGES] += world_size - 1;
+    free(send_buf);
+    profile_add(PHASE_COMMUNICATE, started);
+
+    started = phase_clock();
+    size_t received = recv_total / sizeof(NgramCount);
+    ngram_table_init(table, received > local_size ? received * 2U : local_size * 2U);
+    for (size_t i = 0; i < received; ++i) {
+        ngram_table_add(table, recv_buf[i].key, recv_buf[i].count);
+    }
+    profile_add(PHASE_MERGE, started);
+    free(recv_buf);
+    free(bucket_sizes);
+    free(send_counts);
+    free(send_displs);
+    free(recv_counts);
+    free(recv_displs);
+    return bytes_sent;
+}
+
+static int ngram_count_compare(const void *a, const void *b) {
+    const NgramCount *pa = (const NgramCount *)a;
+    const NgramCount *pb = (const NgramCount *)b;
+    if (pa->count != pb->count) {
+        return pa->count < pb->count ? 1 : -1;
+    }
+    return pa->key < pb->key ? -1 : (pa->key > pb->key ? 1 : 0);
+}
+
+/*
+ * Candidatos do fragmento ao ranking: todos com `candidates` igual a 0 ou os
+ * `candidates` maiores, mais os empatados com o último, já que o desempate
+ * final é pelo texto do n-grama e não pela chave inteira.
+ */
+static NgramCount *ngram_candidates(const NgramTable *table, size_t candidates, size_t *out_count) {
+    NgramCount *pairs = (NgramCount *)malloc((table->size ? table->size : 1U) * sizeof(NgramCount));
+    if (!pairs) {
+        fprintf(stderr, "Failed to allocate n-gram candidates\n");
+        MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
+    }
+    size_t count = 0;
+    for (size_t i = 0; i < table->capacity; ++i) {
+        if (table->keys[i] != NGRAM_EMPTY) {
+            pairs[count].key = table->keys[i];
+            pairs[count++].count = table->values[i];
         }
     }
-    if (MKDIR(buffer) != 0 && errno != EEXIST) {
-        return -1;
+    qsort(pairs, count, sizeof(NgramCount), ngram_count_compare);
+    if (candidates > 0 && count > candidates) {
+        size_t kept = candidates;
+        while (kept < count && pairs[kept].count == pairs[candidates - 1U].count) {
+            kept++;
+        }
+        count = kept;
+    }
+    *out_count = count;
+    return pairs;
+}
+
+/* Converte uma chave empacotada no texto do n-grama, com as palavras separadas por espaço. */
+static void ngram_key_text(const TokenIndex *index, uint64_t key, unsigned ngram_size, ByteBuffer *text) {
+    unsigned bits = 64U / ngram_size;
+    uint64_t id_mask = bits == 64U ? UINT64_MAX : (((uint64_t)1 << bits) - 1U);
+    text->size = 0;
+    for (unsigned i = 0; i < ngram_size; ++i) {
+        uint64_t id = (key >> (bits * (ngram_size - 1U - i))) & id_mask;
+        StringView word = index_string(index->vocab_offsets, index->vocab_blob, id);
+        if (i > 0) {
+            byte_buffer_append(text, " ", 1);
+        }
+        byte_buffer_append(text, word.data, word.length);
     }
-    return 0;
 }
 
 /*
- * Normaliza o nome do cabeçalho para servir como base de nome de arquivo,
- * substituindo caracteres problemáticos por sublinhados.
+ * Contagem distribuída de n-gramas (--ngrams) sobre o índice de tokens: cada
+ * processo conta as janelas da sua faixa de registros, os pares inteiros vão
+ * para o rank dono com ngram_exchange e apenas os candidatos de cada
+ * fragmento seguem para o rank 0 com MPI_Gatherv. Só o rank 0 converte as
+ * chaves em texto, preenchendo `ngrams`. `totals` recebe, no rank 0, a
+ * quantidade de n-gramas e a de n-gramas distintos. Retorna os bytes enviados.
  */
-static void sanitize_header_name(const char *input, char *output, size_t output_len) {
-    if (!output || output_len == 0) {
-        return;
+static long long count_ngrams(const char *index_path, unsigned ngram_size, size_t candidates, HashTable *ngrams,
+                              CountType totals[2], int rank, int world_size, MPI_Comm comm) {
+    TokenIndex index;
+    if (!token_index_open(index_path, NULL, &index)) {
+        fprintf(stderr, "Rank %d failed to open token index %s\n", rank, index_path);
+        MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
     }
-    size_t j = 0;
-    if (input) {
-        for (size_t i = 0; input[i] != '\0'; ++i) {
-            unsigned char c = (unsigned char)input[i];
-            if (c == '\n' || c == '\r') {
-                continue;
-            }
-            if (isspace(c)) {
-                if (j + 1 < output_len) {
-                    output[j++] = '_';
-                }
-            } else if (isalnum(c) || c == '-' || c == '.' || c == '_') {
-                if (j + 1 < output_len) {
-                    output[j++] = (char)c;
-                }
-            } else {
-                if (j + 1 < output_len) {
-                    output[j++] = '_';
-                }
+    const IndexHeader *header = &index.header;
+    if (header->vocab_count >= ((uint64_t)1 << (64U / ngram_size)) - 1U) {
+        if (rank == 0) {
+            fprintf(stderr, "Vocabulary of %llu words is too large for packed %u-grams\n",
+                    (unsigned long long)header->vocab_count, ngram_size);
+        }
+        token_index_close(&index);
+        return 0;
+    }
+    double started = phase_clock();
+    uint64_t first = offsets_split_point(index.token_offsets, 0, header->record_count, rank, world_size);
+    uint64_t last = offsets_split_point(index.token_offsets, 0, header->record_count, rank + 1, world_size);
+    NgramTable table;
+    ngram_table_init(&table, 65536);
+    CountType local[2] = {ngram_count_records(&index, first, last, ngram_size, &table), 0};
+    rank_profile.counters[COUNTER_BYTES_READ] +=
+        (long long)((index.token_offsets[last] - index.token_offsets[first]) * sizeof(uint32_t));
+    profile_add(PHASE_TOKENIZE, started);
+
+    long long bytes_sent = ngram_exchange(&table, rank, world_size, comm);
+    local[1] = (CountType)table.size;
+
+    started = phase_clock();
+    size_t count = 0;
+    NgramCount *pairs = ngram_candidates(&table, candidates, &count);
+    ngram_table_free(&table);
+    profile_add(PHASE_SORT, started);
+
+    started = phase_clock();
+    MPI_Reduce(local, totals, 2, MPI_LONG_LONG, MPI_SUM, 0, comm);
+    int send_bytes = (int)(count * sizeof(NgramCount));
+    int *recv_counts = rank == 0 ? (int *)calloc((size_t)world_size, sizeof(int)) : NULL;
+    int *recv_displs = rank == 0 ? (int *)calloc((size_t)world_size, sizeof(int)) : NULL;
+    if (rank == 0 && (!recv_counts || !recv_displs)) {
+        fprintf(stderr, "Failed to allocate n-gram gather buffers\n");
+        MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
+    }
+    MPI_Gather(&send_bytes, 1, MPI_INT, recv_counts, 1, MPI_INT, 0, comm);
+    size_t recv_total = 0;
+    if (rank == 0) {
+        for (int r = 0; r < world_size; ++r) {
+            if (recv_total + (size_t)recv_counts[r] > (size_t)INT_MAX) {
+                fprintf(stderr, "N-gram candidates exceed the MPI message size limit\n");
+                MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
             }
+            recv_displs[r] = (int)recv_total;
+            recv_total += (size_t)recv_counts[r];
         }
     }
-    if (j == 0) {
-        const char *fallback = "col";
-        for (size_t i = 0; fallback[i] != '\0' && j + 1 < output_len; ++i) {
-            output[j++] = fallback[i];
+    NgramCount *gathered = rank == 0 ? (NgramCount *)malloc(recv_total ? recv_total : 1U) : NULL;
+    if (rank == 0 && !gathered) {
+        fprintf(stderr, "Failed to allocate n-gram gather buffer\n");
+        MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
+    }
+    MPI_Gatherv(pairs, send_bytes, MPI_BYTE, gathered, recv_counts, recv_displs, MPI_BYTE, 0, comm);
+    if (rank != 0) {
+        bytes_sent += send_bytes + (long long)sizeof(local);
+        rank_profile.counters[COUNTER_MESSAGES] += 3;
+    }
+    free(pairs);
+    profile_add(PHASE_COMMUNICATE, started);
+
+    if (rank == 0) {
+        started = phase_clock();
+        size_t gathered_count = recv_total / sizeof(NgramCount);
+        ByteBuffer text = {0};
+        ht_init(ngrams, gathered_count * 2U);
+        for (size_t i = 0; i < gathered_count; ++i) {
+            ngram_key_text(&index, gathered[i].key, ngram_size, &text);
+            ht_put_len(ngrams, text.data, text.size, gathered[i].count);
         }
+        free(text.data);
+        profile_add(PHASE_MERGE, started);
     }
-    output[j] = '\0';
+    free(gathered);
+    free(recv_counts);
+    free(recv_displs);
+    token_index_close(&index);
+    return bytes_sent;
 }
+#endif
 
+#ifdef HAVE_PTHREADS
 /*
- * Lê um registro completo do CSV, respeitando quebras de linha dentro de
- * campos entre aspas. Retorna o total de bytes lidos ou -1 no fim do arquivo.
+ * Trabalho de uma thread do modo híbrido: trecho do arquivo (ou, com `cache`,
+ * intervalo de registros do cache) e contagens próprias.
  */
-static ssize_t read_csv_record(FILE *fp, char **buffer, size_t *buf_size) {
-    if (!fp) {
-        return -1;
+typedef struct {
+    const char *dataset_path;
+    IoEngine io_engine;
+#ifdef HAVE_MMAP
+    const DatasetCache *cache;
+#endif
+    long long start;
+    long long end;
+    long long quotes;
+    LocalStats stats;
+    int rank;
+} ThreadTask;
+
+/* Primeira fase: conta as aspas do trecho bruto da thread. */
+static void *thread_count_quotes(void *arg) {
+    ThreadTask *task = (ThreadTask *)arg;
+    FILE *fp = fopen(task->dataset_path, "r");
+    task->quotes = fp ? count_quotes_in_range(fp, task->start, task->end) : 0;
+    if (fp) {
+        fclose(fp);
     }
-    if (!buffer || !buf_size) {
-        return -1;
+    return NULL;
+}
+
+/* Segunda fase: processa os registros do trecho já alinhado. */
+static void *thread_analyze(void *arg) {
+    ThreadTask *task = (ThreadTask *)arg;
+#ifdef HAVE_MMAP
+    if (task->cache) {
+        analyze_cache_range(task->cache, (uint64_t)task->start, (uint64_t)task->end, &task->stats);
+        return NULL;
     }
-    if (!*buffer || *buf_size == 0) {
-        *buf_size = 1024;
-        *buffer = (char *)malloc(*buf_size);
-        if (!*buffer) {
-            fprintf(stderr, "Failed to allocate CSV buffer\n");
-            return -1;
+#endif
+    analyze_record_range(task->dataset_path, task->io_engine, task->start, task->end, &task->stats, task->rank);
+    return NULL;
+}
+
+/* Executa `routine` em uma thread por tarefa e aguarda todas terminarem. */
+static void run_thread_tasks(ThreadTask *tasks, int count, void *(*routine)(void *)) {
+    pthread_t *handles = (pthread_t *)malloc(sizeof(pthread_t) * (size_t)count);
+    if (!handles) {
+        fprintf(stderr, "Failed to allocate thread handles\n");
+        MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
+    }
+    for (int t = 0; t < count; ++t) {
+        if (pthread_create(&handles[t], NULL, routine, &tasks[t]) != 0) {
+            fprintf(stderr, "Failed to start worker thread %d\n", t);
+            MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
         }
     }
-    size_t pos = 0;
-    int in_quotes = 0;
-    while (1) {
-        int ch = fgetc(fp);
-        if (ch == EOF) {
-            if (pos == 0) {
-                return -1;
-            }
-            break;
+    for (int t = 0; t < count; ++t) {
+        pthread_join(handles[t], NULL);
+    }
+    free(handles);
+}
+
+/* Mescla em `stats` as contagens de cada thread e libera as tabelas delas. */
+static void merge_thread_stats(ThreadTask *tasks, int count, LocalStats *stats) {
+    double started = phase_clock();
+    for (int t = 0; t < count; ++t) {
+        local_stats_merge(stats, &tasks[t].stats);
+        local_stats_free(&tasks[t].stats);
+    }
+    profile_add(PHASE_MERGE, started);
+}
+#endif
+
+/*
+ * Divide a fatia do processo entre `threads` threads. O alinhamento repete,
+ * dentro do rank, a estratégia de resolve_record_slice: cada thread conta as
+ * aspas do seu trecho bruto, a soma prefixada dá a paridade no início de cada
+ * trecho e o início real é o primeiro registro a partir dali. Cada thread
+ * acumula em tabelas próprias, mescladas em `stats` ao final; apenas a thread
+ * principal realiza chamadas MPI (MPI_THREAD_FUNNELED).
+ */
+static void analyze_slice_threaded(const char *dataset_path, IoEngine io_engine, long long slice_start,
+                                   long long slice_end, int threads, LocalStats *stats, int rank) {
+#ifdef HAVE_PTHREADS
+    if (threads > 1 && slice_end - slice_start > (long long)threads) {
+        ThreadTask *tasks = (ThreadTask *)calloc((size_t)threads, sizeof(ThreadTask));
+        if (!tasks) {
+            fprintf(stderr, "Failed to allocate thread tasks\n");
+            MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
         }
-        if (pos + 2 >= *buf_size) {
-            size_t new_size = *buf_size * 2U;
-            char *tmp = (char *)realloc(*buffer, new_size);
-            if (!tmp) {
-                fprintf(stderr, "Failed to grow CSV buffer\n");
-                return -1;
-            }
-            *buffer = tmp;
-            *buf_size = new_size;
+        for (int t = 0; t < threads; ++t) {
+            tasks[t].dataset_path = dataset_path;
+            tasks[t].io_engine = io_engine;
+            tasks[t].rank = rank;
+            compute_byte_slice(slice_start, slice_end, t, threads, &tasks[t].start, &tasks[t].end);
         }
-        (*buffer)[pos++] = (char)ch;
-        if (ch == '"') {
-            if (!in_quotes) {
-                in_quotes = 1;
-            } else {
-                int next = fgetc(fp);
-                if (next == '"') {
-                    if (pos + 1 >= *buf_size) {
-                        size_t new_size = *buf_size * 2U;
-                        char *tmp = (char *)realloc(*buffer, new_size);
-                        if (!tmp) {
-                            fprintf(stderr, "Failed to grow CSV buffer\n");
-                            return -1;
-                        }
-                        *buffer = tmp;
-                        *buf_size = new_size;
-                    }
-                    (*buffer)[pos++] = '"';
-                } else {
-                    if (next != EOF) {
-                        ungetc(next, fp);
-                    }
-                    in_quotes = 0;
-                }
-            }
-        } else if ((ch == '\n' || ch == '\r') && !in_quotes) {
-            if (ch == '\r') {
-                int next = fgetc(fp);
-                if (next == '\n') {
-                    if (pos + 1 >= *buf_size) {
-                        size_t new_size = *buf_size * 2U;
-                        char *tmp = (char *)realloc(*buffer, new_size);
-                        if (!tmp) {
-                            fprintf(stderr, "Failed to grow CSV buffer\n");
-                            return -1;
-                        }
-                        *buffer = tmp;
-                        *buf_size = new_size;
-                    }
-                    (*buffer)[pos++] = (char)next;
-                } else if (next != EOF) {
-                    ungetc(next, fp);
-                }
-            }
-            break;
+        run_thread_tasks(tasks, threads, thread_count_quotes);
+
+        FILE *fp = fopen(dataset_path, "r");
+        if (!fp) {
+            fprintf(stderr, "Rank %d failed to open dataset %s\n", rank, dataset_path);
+            MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
+        }
+        long long quotes_before = 0;
+        for (int t = 0; t < threads; ++t) {
+            long long raw_quotes = tasks[t].quotes;
+            tasks[t].start = find_record_start(fp, tasks[t].start, (int)(quotes_before & 1LL), slice_start, slice_end);
+            quotes_before += raw_quotes;
         }
+        fclose(fp);
+        for (int t = 0; t < threads; ++t) {
+            tasks[t].end = t + 1 < threads ? tasks[t + 1].start : slice_end;
+            local_stats_init(&tasks[t].stats);
+        }
+        run_thread_tasks(tasks, threads, thread_analyze);
+        merge_thread_stats(tasks, threads, stats);
+        free(tasks);
+        return;
     }
-    (*buffer)[pos] = '\0';
-    return (ssize_t)pos;
+#else
+    (void)threads;
+#endif
+    analyze_record_range(dataset_path, io_engine, slice_start, slice_end, stats, rank);
 }
 
+#ifdef HAVE_MMAP
 /*
- * Cria arquivos separados para as colunas de artistas e letras, mantendo as
- * aspas originais dos campos de texto. Retorna 1 em sucesso e 0 em caso de
- * falha.
+ * Divide os registros [first, last) do cache entre `threads` threads. Como as
+ * fronteiras dos registros já são conhecidas, basta equilibrar o volume de
+ * letras, sem a fase de contagem de aspas do modo direto.
  */
-static int split_dataset_columns(const char *dataset_path, const char *split_dir,
-                                 const char *artist_base_name, const char *text_base_name,
-                                 const char *artist_header_label, const char *text_header_label,
-                                 char *artist_out_path, size_t artist_out_len,
-                                 char *text_out_path, size_t text_out_len) {
-    if (!dataset_path || !split_dir || !artist_base_name || !text_base_name) {
-        return 0;
+static void analyze_cache_threaded(const DatasetCache *cache, uint64_t first, uint64_t last, int threads,
+                                   LocalStats *stats) {
+#ifdef HAVE_PTHREADS
+    if (threads > 1 && last - first > (uint64_t)threads) {
+        ThreadTask *tasks = (ThreadTask *)calloc((size_t)threads, sizeof(ThreadTask));
+        if (!tasks) {
+            fprintf(stderr, "Failed to allocate thread tasks\n");
+            MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
+        }
+        for (int t = 0; t < threads; ++t) {
+            tasks[t].cache = cache;
+            tasks[t].start = (long long)cache_split_point(cache, first, last, t, threads);
+            tasks[t].end = (long long)cache_split_point(cache, first, last, t + 1, threads);
+            local_stats_init(&tasks[t].stats);
+        }
+        run_thread_tasks(tasks, threads, thread_analyze);
+        merge_thread_stats(tasks, threads, stats);
+        free(tasks);
+        return;
     }
-    if (!artist_out_path || !text_out_path) {
-        return 0;
+#else
+    (void)threads;
+#endif
+    analyze_cache_range(cache, first, last, stats);
+}
+
+/*
+ * Executado pelo rank 0: reaproveita o cache de `dataset_path` se ele
+ * corresponder à versão atual do CSV ou o reconstrói. Retorna CACHE_OFF se o
+ * cache não puder ser usado, caso em que a leitura do CSV segue normalmente.
+ */
+static CacheState prepare_dataset_cache(const char *dataset_path, long long data_start, const char *cache_dir,
+                                        const char *cache_path) {
+    CacheHeader identity;
+    if (!cache_source_identity(dataset_path, &identity)) {
+        fprintf(stderr, "Failed to inspect dataset %s for caching\n", dataset_path);
+        return CACHE_OFF;
     }
-    if (ensure_directory_recursive(split_dir) != 0) {
-        fprintf(stderr, "Failed to create split directory %s: %s\n", split_dir, strerror(errno));
-        return 0;
+    DatasetCache cache;
+    if (dataset_cache_open(cache_path, &identity, &cache)) {
+        dataset_cache_close(&cache);
+        return CACHE_HIT;
     }
-    int needed = snprintf(artist_out_path, artist_out_len, "%s/%s.csv", split_dir, artist_base_name);
-    if (needed < 0 || (size_t)needed >= artist_out_len) {
-        fprintf(stderr, "Artist split path is too long\n");
-        return 0;
+    if (ensure_directory_recursive(cache_dir) != 0) {
+        fprintf(stderr, "Failed to prepare cache directory %s: %s\n", cache_dir, strerror(errno));
+        return CACHE_OFF;
     }
-    needed = snprintf(text_out_path, text_out_len, "%s/%s.csv", split_dir, text_base_name);
-    if (needed < 0 || (size_t)needed >= text_out_len) {
-        fprintf(stderr, "Text split path is too long\n");
-        return 0;
+    return dataset_cache_build(dataset_path, data_start, cache_path, &identity) ? CACHE_BUILT : CACHE_OFF;
+}
+
+/* Analisa a parte do processo a partir do cache já validado pelo rank 0. */
+static void analyze_cached_dataset(const char *cache_path, int threads, WorkSchedule *schedule, LocalStats *stats,
+                                   int rank) {
+    DatasetCache cache;
+    if (!dataset_cache_open(cache_path, NULL, &cache)) {
+        fprintf(stderr, "Rank %d failed to open dataset cache %s\n", rank, cache_path);
+        MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
+    }
+    uint64_t records = cache.header.record_count;
+    madvise(cache.mapping, cache.mapping_size, MADV_WILLNEED);
+    long long chunk = 0;
+    int parts = (int)schedule->chunk_count;
+    while (schedule_next(schedule, &chunk)) {
+        uint64_t first = cache_split_point(&cache, 0, records, (int)chunk, parts);
+        uint64_t last = cache_split_point(&cache, 0, records, (int)chunk + 1, parts);
+        size_t rows_begin = stats->song_rows.size;
+        size_t scores_begin = stats->sentiment_rows.size;
+        analyze_cache_threaded(&cache, first, last, threads, stats);
+        schedule_record_rows(&schedule->spans, chunk, rows_begin, stats->song_rows.size);
+        schedule_record_rows(&schedule->sentiment_spans, chunk, scores_begin, stats->sentiment_rows.size);
+        pipeline_flush(stats);
     }
+    dataset_cache_close(&cache);
+}
+#endif
 
-    FILE *input = fopen(dataset_path, "r");
-    if (!input) {
-        fprintf(stderr, "Failed to open dataset %s for splitting\n", dataset_path);
-        return 0;
+/*
+ * Lê o trecho [data_start, file_size) do CSV diretamente. Com um bloco por
+ * rank cada processo lê a sua fatia alinhada por resolve_record_slice; com
+ * mais blocos, alinhados por resolve_chunk_bounds, eles são retirados da
+ * fila até ela acabar.
+ */
+static void analyze_csv_dataset(const char *dataset_path, IoEngine io_engine, long long data_start,
+                                long long file_size, int threads, WorkSchedule *schedule, LocalStats *stats, int rank,
+                                int world_size) {
+    long long *bounds = NULL;
+    long long slice_start = 0;
+    long long slice_end = 0;
+    /* O alinhamento das fatias percorre o arquivo e conta como leitura. */
+    double started = phase_clock();
+    if (schedule->mode == SCHEDULE_DYNAMIC || schedule->chunk_count > world_size) {
+        bounds = resolve_chunk_bounds(dataset_path, data_start, file_size, schedule->chunk_count, rank, world_size);
+    } else {
+        resolve_record_slice(dataset_path, data_start, file_size, rank, world_size, &slice_start, &slice_end);
     }
-    FILE *artist_fp = fopen(artist_out_path, "w");
-    FILE *text_fp = fopen(text_out_path, "w");
-    if (!artist_fp || !text_fp) {
-        fprintf(stderr, "Failed to create split files in %s\n", split_dir);
-        if (artist_fp) {
-            fclose(artist_fp);
-        }
-        if (text_fp) {
-            fclose(text_fp);
+    stats->profile.seconds[PHASE_READ] += phase_clock() - started;
+    long long chunk = 0;
+    while (schedule_next(schedule, &chunk)) {
+        if (bounds) {
+            slice_start = bounds[chunk];
+            slice_end = bounds[chunk + 1];
         }
-        fclose(input);
-        return 0;
+        size_t rows_begin = stats->song_rows.size;
+        size_t scores_begin = stats->sentiment_rows.size;
+        analyze_slice_threaded(dataset_path, io_engine, slice_start, slice_end, threads, stats, rank);
+        schedule_record_rows(&schedule->spans, chunk, rows_begin, stats->song_rows.size);
+        schedule_record_rows(&schedule->sentiment_spans, chunk, scores_begin, stats->sentiment_rows.size);
+        pipeline_flush(stats);
     }
+    free(bounds);
+}
 
-    fprintf(artist_fp, "%s\n", (artist_header_label && *artist_header_label) ? artist_header_label : "Artists");
-    fprintf(text_fp, "%s\n", (text_header_label && *text_header_label) ? text_header_label : "Texts");
+/* Abre uma coluna auxiliar já posicionada no início da fatia do rank. */
+static FILE *open_split_column(const char *path, long long offset, const char *label, int rank) {
+    FILE *fp = fopen(path, "r");
+    if (!fp) {
+        fprintf(stderr, "Rank %d failed to open %s column %s\n", rank, label, path);
+        MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
+    }
+    if (fseeko(fp, offset, SEEK_SET) != 0) {
+        fprintf(stderr, "Rank %d failed to seek %s column offset %lld\n", rank, label, offset);
+        MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
+    }
+    return fp;
+}
 
-    char *line = NULL;
-    size_t line_cap = 0;
-    ssize_t read = read_csv_record(input, &line, &line_cap); /* descarta cabeçalho */
-    if (read < 0) {
-        free(line);
-        fclose(artist_fp);
-        fclose(text_fp);
-        fclose(input);
-        return 1; /* dataset vazio, apenas cabeçalhos criados */
+/* Remove a quebra de linha final de um registro lido por read_csv_record. */
+static void strip_record_newline(char *line, ssize_t length) {
+    while (length > 0 && (line[length - 1] == '\n' || line[length - 1] == '\r')) {
+        line[--length] = '\0';
+    }
+}
+
+/*
+ * Modo legado: percorre juntos, em um único passo, os arquivos auxiliares de
+ * letras e artistas gerados por split_dataset_columns. As fatias de `bounds`
+ * (ver split_column_bounds) cobrem as mesmas músicas nos dois arquivos, de
+ * modo que cada letra é analisada com o seu artista, como na leitura direta.
+ */
+static void analyze_split_columns(const char *text_split_path, const char *artist_split_path,
+                                  const long long *bounds, LocalStats *stats, int rank, int world_size) {
+    double started = phase_clock();
+    double inner_before = profile_inner_seconds(&stats->profile);
+    long long text_start = bounds[rank];
+    long long text_end = bounds[rank + 1];
+    long long artist_start = bounds[world_size + 1 + rank];
+    long long artist_end = bounds[world_size + 2 + rank];
+    stats->profile.counters[COUNTER_BYTES_READ] += (text_end - text_start) + (artist_end - artist_start);
+
+    FILE *text_fp = open_split_column(text_split_path, text_start, "text", rank);
+    FILE *artist_fp = open_split_column(artist_split_path, artist_start, "artist", rank);
+    char *text_line = NULL;
+    size_t text_cap = 0;
+    char *artist_line = NULL;
+    size_t artist_cap = 0;
+    StringView no_song = {"", 0};
+    while (ftello(text_fp) < text_end) {
+        ssize_t text_len = read_csv_record(text_fp, &text_line, &text_cap);
+        ssize_t artist_len = read_csv_record(artist_fp, &artist_line, &artist_cap);
+        if (text_len < 0 || artist_len < 0) {
+            break;
+        }
+        strip_record_newline(text_line, text_len);
+        strip_record_newline(artist_line, artist_len);
+        char *lyrics = duplicate_field(text_line, 1);
+        char *artist = duplicate_field(artist_line, 0);
+        StringView artist_view = {artist, strlen(artist)};
+        StringView lyrics_view = {lyrics, strlen(lyrics)};
+        process_record(stats, artist_view, no_song, lyrics_view);
+        free(lyrics);
+        free(artist);
     }
+    free(text_line);
+    free(artist_line);
+    fclose(text_fp);
+    fclose(artist_fp);
+    profile_add_read(&stats->profile, started, inner_before);
+}
 
-    while ((read = read_csv_record(input, &line, &line_cap)) >= 0) {
-        if (read == 0) {
-            continue;
+/*
+ * Exporta os blocos "phases" e "counters" de performance_metrics.json a
+ * partir dos perfis reunidos no rank 0 (`world_size` linhas de PHASE_COUNT
+ * tempos e de COUNTER_COUNT contadores).
+ */
+static void write_profile_json(FILE *fp, const double *seconds, const long long *counters, int world_size) {
+    fprintf(fp, "  \"phases\": {\n");
+    for (int p = 0; p < PHASE_COUNT; ++p) {
+        double sum = 0.0;
+        double min = seconds[p];
+        double max = seconds[p];
+        for (int r = 0; r < world_size; ++r) {
+            double value = seconds[(size_t)r * PHASE_COUNT + (size_t)p];
+            sum += value;
+            min = value < min ? value : min;
+            max = value > max ? value : max;
         }
-        char *artist_raw = NULL;
-        char *lyrics_raw = NULL;
-        if (!parse_csv_line(line, &artist_raw, &lyrics_raw, 1, 1)) {
-            free(artist_raw);
-            free(lyrics_raw);
-            continue;
+        fprintf(fp, "    \"%s\": {\"avg_seconds\": %.6f, \"min_seconds\": %.6f, \"max_seconds\": %.6f, \"per_rank\": [",
+                phase_names[p], sum / world_size, min, max);
+        for (int r = 0; r < world_size; ++r) {
+            fprintf(fp, "%s%.6f", r > 0 ? ", " : "", seconds[(size_t)r * PHASE_COUNT + (size_t)p]);
         }
-        fprintf(artist_fp, "%s\n", artist_raw ? artist_raw : "");
-        fprintf(text_fp, "%s\n", lyrics_raw ? lyrics_raw : "");
-        free(artist_raw);
-        free(lyrics_raw);
+        fprintf(fp, "]}%s\n", p + 1 < PHASE_COUNT ? "," : "");
+    }
+    fprintf(fp, "  },\n");
+    fprintf(fp, "  \"counters\": {\n");
+    for (int c = 0; c < COUNTER_COUNT; ++c) {
+        long long total = 0;
+        long long max = 0;
+        for (int r = 0; r < world_size; ++r) {
+            long long value = counters[(size_t)r * COUNTER_COUNT + (size_t)c];
+            total += value;
+            max = value > max ? value : max;
+        }
+        fprintf(fp, "    \"%s\": {\"total\": %lld, \"max_per_rank\": %lld, \"per_rank\": [", counter_names[c], total,
+                max);
+        for (int r = 0; r < world_size; ++r) {
+            fprintf(fp, "%s%lld", r > 0 ? ", " : "", counters[(size_t)r * COUNTER_COUNT + (size_t)c]);
+        }
+        fprintf(fp, "]}%s\n", c + 1 < COUNTER_COUNT ? "," : "");
     }
+    fprintf(fp, "  }\n");
+}
 
-    free(line);
-    fclose(artist_fp);
-    fclose(text_fp);
-    fclose(input);
-    return 1;
+/*
+ * Reconhece uma opção com valor nos formatos "--nome valor" e "--nome=valor".
+ * Retorna o valor (avançando o índice quando ele está no argumento seguinte)
+ * ou NULL se o argumento atual não corresponde à opção.
+ */
+static const char *option_value(int argc, char **argv, int *index, const char *name) {
+    const char *arg = argv[*index];
+    size_t name_len = strlen(name);
+    if (strncmp(arg, name, name_len) != 0) {
+        return NULL;
+    }
+    if (arg[name_len] == '=') {
+        return arg + name_len + 1;
+    }
+    if (arg[name_len] == '\0' && *index + 1 < argc) {
+        return argv[++(*index)];
+    }
+    return NULL;
 }
 
 /* Função principal que distribui o trabalho entre os processos MPI. */
+/* O microbenchmark (src/microbench.c) inclui este arquivo sem o main. */
+#ifndef PARALLEL_SPOTIFY_NO_MAIN
 int main(int argc, char **argv) {
-    MPI_Init(&argc, &argv);
+    int thread_support = MPI_THREAD_SINGLE;
+    MPI_Init_thread(&argc, &argv, MPI_THREAD_FUNNELED, &thread_support);
+    csv_scanner_init();
 
     int rank = 0;
     int world_size = 0;
@@ -731,7 +6083,7 @@ int main(int argc, char **argv) {
 
     if (argc < 2) {
         if (rank == 0) {
-            fprintf(stderr, "Usage: mpirun -np <n> %s <dataset.csv> [--word-limit N] [--artist-limit N] [--output-dir DIR]\n", argv[0]);
+            fprintf(stderr, "Usage: mpirun -np <n> %s <dataset.csv> [--word-limit N] [--artist-limit N] [--output-dir DIR] [--split-columns] [--io stdio|mmap] [--reduce tree|gather|shard|pipeline] [--threads N] [--min-length N] [--stopwords none|default|FILE] [--apostrophes keep|split] [--utf8] [--cache DIR] [--index DIR] [--per-song] [--per-artist] [--artist-stats N] [--write serial|mpiio] [--binary] [--schedule static|dynamic] [--chunks N] [--incremental DIR] [--approx] [--ngrams 2|3] [--ngram-limit N] [--sentiment] [--sentiment-margin N]\n", argv[0]);
         }
         MPI_Finalize();
         return EXIT_FAILURE;
@@ -740,11 +6092,43 @@ int main(int argc, char **argv) {
     const char *dataset_path = argv[1];
     int word_limit = DEFAULT_WORD_LIMIT;
     int artist_limit = DEFAULT_ARTIST_LIMIT;
+    int use_split_columns = 0;
+#ifdef HAVE_MMAP
+    IoEngine io_engine = IO_MMAP;
+#else
+    IoEngine io_engine = IO_STDIO;
+#endif
+    ReduceMode reduce_mode = REDUCE_TREE;
+    WriteMode write_mode = WRITE_SERIAL;
+    WorkSchedule schedule;
+    memset(&schedule, 0, sizeof(schedule));
+    int chunks_per_rank = DEFAULT_CHUNKS_PER_RANK;
+    int binary_output = 0;
+    int threads = 1;
+    TokenPolicy policy = {3, APOSTROPHE_KEEP, 0, NULL};
+    const char *stopwords_source = NULL;
+    const char *cache_dir = NULL;
+    char cache_path[PATH_MAX] = {0};
+    const char *index_dir = NULL;
+    char index_path[PATH_MAX] = {0};
+    const char *snapshot_dir = NULL;
+    char snapshot_path[PATH_MAX] = {0};
     char output_dir[PATH_MAX];
     snprintf(output_dir, sizeof(output_dir), "output");
     char word_output_path[PATH_MAX] = {0};
     char artist_output_path[PATH_MAX] = {0};
     char metrics_output_path[PATH_MAX] = {0};
+    char word_binary_path[PATH_MAX] = {0};
+    char artist_binary_path[PATH_MAX] = {0};
+    char song_output_path[PATH_MAX] = {0};
+    char artist_words_output_path[PATH_MAX] = {0};
+    char artist_stats_output_path[PATH_MAX] = {0};
+    char sentiment_scores_path[PATH_MAX] = {0};
+    char sentiment_totals_path[PATH_MAX] = {0};
+    char sentiment_artist_path[PATH_MAX] = {0};
+    char ngram_output_path[PATH_MAX] = {0};
+    unsigned ngram_size = 0;
+    int ngram_limit = DEFAULT_WORD_LIMIT;
     char split_dir[PATH_MAX] = {0};
     char sanitized_artist[128] = {0};
     char sanitized_text[128] = {0};
@@ -752,316 +6136,733 @@ int main(int argc, char **argv) {
     char text_header_label[128] = {0};
     char artist_split_path[PATH_MAX] = {0};
     char text_split_path[PATH_MAX] = {0};
+    long long *split_bounds = NULL;
 
     for (int i = 2; i < argc; ++i) {
-        if (strcmp(argv[i], "--word-limit") == 0 && i + 1 < argc) {
-            word_limit = atoi(argv[++i]);
-        } else if (strcmp(argv[i], "--artist-limit") == 0 && i + 1 < argc) {
-            artist_limit = atoi(argv[++i]);
-        } else if (strcmp(argv[i], "--output-dir") == 0 && i + 1 < argc) {
-            strncpy(output_dir, argv[++i], sizeof(output_dir) - 1);
+        const char *value = NULL;
+        if ((value = option_value(argc, argv, &i, "--word-limit")) != NULL) {
+            word_limit = atoi(value);
+        } else if ((value = option_value(argc, argv, &i, "--artist-limit")) != NULL) {
+            artist_limit = atoi(value);
+        } else if ((value = option_value(argc, argv, &i, "--output-dir")) != NULL) {
+            strncpy(output_dir, value, sizeof(output_dir) - 1);
             output_dir[sizeof(output_dir) - 1] = '\0';
+        } else if ((value = option_value(argc, argv, &i, "--io")) != NULL) {
+            if (strcmp(value, "stdio") == 0) {
+                io_engine = IO_STDIO;
+            } else if (strcmp(value, "mmap") == 0) {
+#ifdef HAVE_MMAP
+                io_engine = IO_MMAP;
+#else
+                if (rank == 0) {
+                    fprintf(stderr, "mmap is not available on this platform, using stdio\n");
+                }
+#endif
+            } else if (rank == 0) {
+                fprintf(stderr, "Ignoring unknown I/O engine: %s\n", value);
+            }
+        } else if ((value = option_value(argc, argv, &i, "--reduce")) != NULL) {
+            if (strcmp(value, "tree") == 0) {
+                reduce_mode = REDUCE_TREE;
+            } else if (strcmp(value, "gather") == 0) {
+                reduce_mode = REDUCE_GATHER;
+            } else if (strcmp(value, "shard") == 0) {
+                reduce_mode = REDUCE_SHARD;
+            } else if (strcmp(value, "pipeline") == 0) {
+                reduce_mode = REDUCE_PIPELINE;
+            } else if (rank == 0) {
+                fprintf(stderr, "Ignoring unknown reduction mode: %s\n", value);
+            }
+        } else if (strcmp(argv[i], "--binary") == 0) {
+            binary_output = 1;
+        } else if ((value = option_value(argc, argv, &i, "--write")) != NULL) {
+            if (strcmp(value, "serial") == 0) {
+                write_mode = WRITE_SERIAL;
+            } else if (strcmp(value, "mpiio") == 0) {
+                write_mode = WRITE_MPIIO;
+            } else if (rank == 0) {
+                fprintf(stderr, "Ignoring unknown write mode: %s\n", value);
+            }
+        } else if ((value = option_value(argc, argv, &i, "--schedule")) != NULL) {
+            if (strcmp(value, "static") == 0) {
+                schedule.mode = SCHEDULE_STATIC;
+            } else if (strcmp(value, "dynamic") == 0) {
+                schedule.mode = SCHEDULE_DYNAMIC;
+            } else if (rank == 0) {
+                fprintf(stderr, "Ignoring unknown schedule: %s\n", value);
+            }
+        } else if ((value = option_value(argc, argv, &i, "--chunks")) != NULL) {
+            chunks_per_rank = atoi(value);
+            if (chunks_per_rank < 1) {
+                chunks_per_rank = 1;
+            }
+        } else if ((value = option_value(argc, argv, &i, "--threads")) != NULL) {
+            threads = atoi(value);
+            if (threads < 1) {
+                threads = 1;
+            }
+        } else if ((value = option_value(argc, argv, &i, "--min-length")) != NULL) {
+            int min_length = atoi(value);
+            policy.min_length = min_length > 0 ? (size_t)min_length : 1U;
+        } else if ((value = option_value(argc, argv, &i, "--stopwords")) != NULL) {
+            stopwords_source = strcmp(value, "none") == 0 ? NULL : value;
+        } else if ((value = option_value(argc, argv, &i, "--apostrophes")) != NULL) {
+            if (strcmp(value, "keep") == 0) {
+                policy.apostrophes = APOSTROPHE_KEEP;
+            } else if (strcmp(value, "split") == 0) {
+                policy.apostrophes = APOSTROPHE_SPLIT;
+            } else if (rank == 0) {
+                fprintf(stderr, "Ignoring unknown apostrophe mode: %s\n", value);
+            }
+        } else if ((value = option_value(argc, argv, &i, "--cache")) != NULL) {
+#ifdef HAVE_MMAP
+            cache_dir = value;
+#else
+            if (rank == 0) {
+                fprintf(stderr, "The dataset cache requires mmap, ignoring --cache\n");
+            }
+#endif
+        } else if ((value = option_value(argc, argv, &i, "--index")) != NULL) {
+#ifdef HAVE_MMAP
+            index_dir = value;
+#else
+            if (rank == 0) {
+                fprintf(stderr, "The token index requires mmap, ignoring --index\n");
+            }
+#endif
+        } else if ((value = option_value(argc, argv, &i, "--incremental")) != NULL) {
+            snapshot_dir = value;
+        } else if (strcmp(argv[i], "--utf8") == 0) {
+            policy.utf8_letters = 1;
+        } else if (strcmp(argv[i], "--per-song") == 0) {
+            detail_outputs.per_song = 1;
+        } else if (strcmp(argv[i], "--per-artist") == 0) {
+            detail_outputs.per_artist = 1;
+        } else if ((value = option_value(argc, argv, &i, "--artist-stats")) != NULL) {
+            detail_outputs.artist_stats = atoi(value) > 0 ? atoi(value) : 1;
+        } else if (strcmp(argv[i], "--sentiment") == 0) {
+            detail_outputs.sentiment = 1;
+        } else if ((value = option_value(argc, argv, &i, "--sentiment-margin")) != NULL) {
+            detail_outputs.sentiment_margin = atoi(value) > 0 ? atoi(value) : 0;
+        } else if (strcmp(argv[i], "--split-columns") == 0) {
+            use_split_columns = 1;
+        } else if (strcmp(argv[i], "--approx") == 0) {
+            approx_counting = 1;
+        } else if ((value = option_value(argc, argv, &i, "--ngrams")) != NULL) {
+            int size = atoi(value);
+            if (size == 2 || size == 3) {
+                ngram_size = (unsigned)size;
+            } else if (rank == 0) {
+                fprintf(stderr, "Ignoring unsupported n-gram size: %s\n", value);
+            }
+        } else if ((value = option_value(argc, argv, &i, "--ngram-limit")) != NULL) {
+            ngram_limit = atoi(value);
         } else if (rank == 0) {
             fprintf(stderr, "Ignoring unknown argument: %s\n", argv[i]);
         }
     }
+    detail_outputs.artist_words = detail_outputs.per_artist || detail_outputs.artist_stats > 0;
+    detail_outputs.sentiment_scores = detail_outputs.sentiment;
+    if (threads > 1 && thread_support < MPI_THREAD_FUNNELED) {
+        if (rank == 0) {
+            fprintf(stderr, "MPI library lacks MPI_THREAD_FUNNELED support; using a single thread\n");
+        }
+        threads = 1;
+    }
 
-    int split_dir_len = snprintf(split_dir, sizeof(split_dir), "%s/split_columns", output_dir);
-    if (split_dir_len < 0 || (size_t)split_dir_len >= sizeof(split_dir)) {
+    if (stopwords_source) {
+        policy.is_stopword = strcmp(stopwords_source, "default") == 0 ? default_stopword : custom_stopword;
+    }
+    const char *tokenizer_kernel = tokenizer_init(&policy);
+    if (policy.is_stopword == custom_stopword && !load_stopwords(stopwords_source)) {
         if (rank == 0) {
-            fprintf(stderr, "Split directory path is too long\n");
+            fprintf(stderr, "Failed to read stop word list %s: %s\n", stopwords_source, strerror(errno));
         }
         MPI_Finalize();
         return EXIT_FAILURE;
     }
 
-    if (rank == 0) {
-        if (ensure_directory_recursive(output_dir) != 0) {
-            fprintf(stderr, "Failed to prepare output directory %s: %s\n", output_dir, strerror(errno));
-            MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
+    if (use_split_columns && detail_outputs.per_song) {
+        if (rank == 0) {
+            fprintf(stderr, "Ignoring --per-song in --split-columns mode, the split files have no song titles\n");
         }
-        if (ensure_directory_recursive(split_dir) != 0) {
-            fprintf(stderr, "Failed to prepare split directory %s: %s\n", split_dir, strerror(errno));
-            MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
+        detail_outputs.per_song = 0;
+    }
+    if (use_split_columns && detail_outputs.sentiment_scores) {
+        if (rank == 0) {
+            fprintf(stderr, "Skipping sentiment_scores.csv in --split-columns mode, the split files have no song "
+                            "titles\n");
         }
-
-        FILE *header_fp = fopen(dataset_path, "r");
-        if (!header_fp) {
-            fprintf(stderr, "Failed to open dataset %s\n", dataset_path);
-            MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
+        detail_outputs.sentiment_scores = 0;
+    }
+    if (use_split_columns && schedule.mode == SCHEDULE_DYNAMIC) {
+        if (rank == 0) {
+            fprintf(stderr, "Ignoring --schedule dynamic in --split-columns mode\n");
         }
-        char *header_line = NULL;
-        size_t header_cap = 0;
-        ssize_t header_read = read_csv_record(header_fp, &header_line, &header_cap);
-        if (header_read < 0) {
-            fprintf(stderr, "Dataset does not contain a header row\n");
-            free(header_line);
-            fclose(header_fp);
-            MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
+        schedule.mode = SCHEDULE_STATIC;
+    }
+    if (use_split_columns && (cache_dir || index_dir)) {
+        if (rank == 0) {
+            fprintf(stderr, "Ignoring --cache and --index in --split-columns mode\n");
         }
-        char *artist_header_tmp = NULL;
-        char *text_header_tmp = NULL;
-        if (!parse_csv_line(header_line, &artist_header_tmp, &text_header_tmp, 0, 0)) {
-            fprintf(stderr, "Unable to parse dataset header\n");
-            free(header_line);
-            fclose(header_fp);
-            MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
+        cache_dir = NULL;
+        index_dir = NULL;
+    }
+    /* O snapshot guarda bytes do CSV original: cache, índice e colunas
+     * divididas descrevem o arquivo inteiro e não são retomáveis. */
+    if (snapshot_dir && (use_split_columns || cache_dir || index_dir)) {
+        if (rank == 0) {
+            fprintf(stderr, "Ignoring --split-columns, --cache and --index in --incremental mode\n");
         }
-        strncpy(artist_header_label, artist_header_tmp, sizeof(artist_header_label) - 1);
-        strncpy(text_header_label, text_header_tmp, sizeof(text_header_label) - 1);
-        artist_header_label[sizeof(artist_header_label) - 1] = '\0';
-        text_header_label[sizeof(text_header_label) - 1] = '\0';
-        sanitize_header_name(artist_header_tmp, sanitized_artist, sizeof(sanitized_artist));
-        sanitize_header_name(text_header_tmp, sanitized_text, sizeof(sanitized_text));
-        free(artist_header_tmp);
-        free(text_header_tmp);
-        free(header_line);
-        fclose(header_fp);
-
-        if (!split_dataset_columns(dataset_path, split_dir, sanitized_artist, sanitized_text,
-                                   artist_header_label, text_header_label,
-                                   artist_split_path, sizeof(artist_split_path),
-                                   text_split_path, sizeof(text_split_path))) {
-            fprintf(stderr, "Failed to split dataset columns\n");
-            MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
+        use_split_columns = 0;
+        cache_dir = NULL;
+        index_dir = NULL;
+    }
+    /* O snapshot guarda só as tabelas globais: as linhas por música e por
+     * artista e os rótulos das músicas já contadas não seriam retomados, e as
+     * saídas detalhadas cobririam apenas os registros novos. */
+    if (snapshot_dir && (detail_outputs.per_song || detail_outputs.artist_words || detail_outputs.sentiment)) {
+        if (rank == 0) {
+            fprintf(stderr, "Ignoring --per-song, --per-artist, --artist-stats and --sentiment in --incremental "
+                            "mode\n");
         }
+        memset(&detail_outputs, 0, sizeof(detail_outputs));
     }
-
-    MPI_Bcast(sanitized_artist, (int)sizeof(sanitized_artist), MPI_CHAR, 0, MPI_COMM_WORLD);
-    MPI_Bcast(sanitized_text, (int)sizeof(sanitized_text), MPI_CHAR, 0, MPI_COMM_WORLD);
-
-    int artist_path_len = snprintf(artist_split_path, sizeof(artist_split_path), "%s/%s.csv", split_dir, sanitized_artist);
-    if (artist_path_len < 0 || (size_t)artist_path_len >= sizeof(artist_split_path)) {
+    if (snapshot_dir && reduce_mode == REDUCE_SHARD) {
         if (rank == 0) {
-            fprintf(stderr, "Artist split path is too long\n");
+            fprintf(stderr, "The snapshot needs the complete tables on rank 0, using --reduce tree\n");
         }
-        MPI_Finalize();
-        return EXIT_FAILURE;
+        reduce_mode = REDUCE_TREE;
     }
-    int text_path_len = snprintf(text_split_path, sizeof(text_split_path), "%s/%s.csv", split_dir, sanitized_text);
-    if (text_path_len < 0 || (size_t)text_path_len >= sizeof(text_split_path)) {
+    /* Os resumos aproximados só têm as palavras mais frequentes: não há
+     * tabelas completas para as saídas detalhadas, o índice nem o snapshot. */
+    if (approx_counting && (detail_outputs.per_song || detail_outputs.artist_words || detail_outputs.sentiment ||
+                            index_dir || snapshot_dir)) {
         if (rank == 0) {
-            fprintf(stderr, "Text split path is too long\n");
+            fprintf(stderr, "Ignoring --per-song, --per-artist, --artist-stats, --sentiment, --index and "
+                            "--incremental in --approx mode\n");
         }
-        MPI_Finalize();
-        return EXIT_FAILURE;
+        memset(&detail_outputs, 0, sizeof(detail_outputs));
+        index_dir = NULL;
+        snapshot_dir = NULL;
     }
-
-    MPI_Barrier(MPI_COMM_WORLD);
-    double start_time = MPI_Wtime();
-
-    long long text_header_len = compute_header_length(text_split_path);
-    long long text_file_size = get_file_size(text_split_path);
-    if (text_header_len < 0 || text_file_size < 0) {
-        fprintf(stderr, "Rank %d failed to obtain text column metadata\n", rank);
-        MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
+    if (approx_counting && reduce_mode != REDUCE_TREE) {
+        if (rank == 0) {
+            fprintf(stderr, "Ignoring --reduce in --approx mode, the sketches are combined with MPI_Reduce\n");
+        }
+        reduce_mode = REDUCE_TREE;
     }
-    long long artist_header_len = compute_header_length(artist_split_path);
-    long long artist_file_size = get_file_size(artist_split_path);
-    if (artist_header_len < 0 || artist_file_size < 0) {
-        fprintf(stderr, "Rank %d failed to obtain artist column metadata\n", rank);
-        MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
+    /* Os n-gramas são contados sobre os ids do índice de tokens; sem --index,
+     * o índice fica no diretório de saída. */
+    if (ngram_size && (approx_counting || use_split_columns || snapshot_dir)) {
+        if (rank == 0) {
+            fprintf(stderr, "Ignoring --ngrams with --approx, --split-columns or --incremental\n");
+        }
+        ngram_size = 0;
     }
-
-    long long text_data_bytes = text_file_size > text_header_len ? text_file_size - text_header_len : 0;
-    long long text_base_chunk = text_data_bytes / world_size;
-    long long text_remainder = text_data_bytes % world_size;
-    long long text_local_start = text_header_len + rank * text_base_chunk + (rank < text_remainder ? rank : text_remainder);
-    long long text_local_end = text_local_start + text_base_chunk + (rank < text_remainder ? 1 : 0);
-    if (rank == world_size - 1) {
-        text_local_end = text_file_size;
+#ifdef HAVE_MMAP
+    if (ngram_size && !index_dir) {
+        if (rank == 0) {
+            fprintf(stderr, "--ngrams needs the token index, writing it to %s (use --index DIR to choose)\n",
+                    output_dir);
+        }
+        index_dir = output_dir;
     }
-
-    long long artist_data_bytes = artist_file_size > artist_header_len ? artist_file_size - artist_header_len : 0;
-    long long artist_base_chunk = artist_data_bytes / world_size;
-    long long artist_remainder = artist_data_bytes % world_size;
-    long long artist_local_start = artist_header_len + rank * artist_base_chunk + (rank < artist_remainder ? rank : artist_remainder);
-    long long artist_local_end = artist_local_start + artist_base_chunk + (rank < artist_remainder ? 1 : 0);
-    if (rank == world_size - 1) {
-        artist_local_end = artist_file_size;
+#else
+    if (ngram_size) {
+        if (rank == 0) {
+            fprintf(stderr, "N-gram counting requires the token index, ignoring --ngrams\n");
+        }
+        ngram_size = 0;
     }
-
-    HashTable word_counts;
-    HashTable artist_counts;
-    ht_init(&word_counts, 65536);
-    ht_init(&artist_counts, 8192);
-
-    CountType local_word_total = 0;
-    CountType local_song_total = 0;
-
-    char *line = NULL;
-    size_t line_buf = 0;
-
-    FILE *text_fp = fopen(text_split_path, "r");
-    if (!text_fp) {
-        fprintf(stderr, "Rank %d failed to open text column %s\n", rank, text_split_path);
-        MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
+#endif
+    if (detail_outputs.sentiment) {
+        sentiment_lexicon_init();
     }
-
-    if (text_local_start > text_header_len) {
-        if (fseeko(text_fp, text_local_start, SEEK_SET) != 0) {
-            fprintf(stderr, "Rank %d failed to seek text column offset %lld\n", rank, text_local_start);
-            MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
+    const char *dataset_name = strrchr(dataset_path, '/');
+    dataset_name = dataset_name ? dataset_name + 1 : dataset_path;
+    if (cache_dir) {
+        int cache_path_len = snprintf(cache_path, sizeof(cache_path), "%s/%s.pscache", cache_dir, dataset_name);
+        if (cache_path_len < 0 || (size_t)cache_path_len >= sizeof(cache_path)) {
+            if (rank == 0) {
+                fprintf(stderr, "Cache path is too long\n");
+            }
+            MPI_Finalize();
+            return EXIT_FAILURE;
         }
-        if (text_local_start > text_header_len) {
-            if (read_csv_record(text_fp, &line, &line_buf) < 0) {
-                /* offset apontou além do fim */
+    }
+    if (snapshot_dir) {
+        int snapshot_path_len = snprintf(snapshot_path, sizeof(snapshot_path), "%s/%s.pssnap", snapshot_dir,
+                                         dataset_name);
+        if (snapshot_path_len < 0 || (size_t)snapshot_path_len >= sizeof(snapshot_path)) {
+            if (rank == 0) {
+                fprintf(stderr, "Snapshot path is too long\n");
             }
+            MPI_Finalize();
+            return EXIT_FAILURE;
         }
-    } else {
-        if (fseeko(text_fp, text_header_len, SEEK_SET) != 0) {
-            fprintf(stderr, "Rank %d failed to seek to text header end\n", rank);
-            MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
+    }
+    if (index_dir) {
+        int index_path_len = snprintf(index_path, sizeof(index_path), "%s/%s.psindex", index_dir, dataset_name);
+        if (index_path_len < 0 || (size_t)index_path_len >= sizeof(index_path)) {
+            if (rank == 0) {
+                fprintf(stderr, "Index path is too long\n");
+            }
+            MPI_Finalize();
+            return EXIT_FAILURE;
         }
     }
 
-    while (1) {
-        long long position = ftello(text_fp);
-        if (position < 0) {
-            break;
+    int split_dir_len = snprintf(split_dir, sizeof(split_dir), "%s/split_columns", output_dir);
+    if (split_dir_len < 0 || (size_t)split_dir_len >= sizeof(split_dir)) {
+        if (rank == 0) {
+            fprintf(stderr, "Split directory path is too long\n");
         }
-        if (rank != world_size - 1 && position >= text_local_end) {
-            break;
+        MPI_Finalize();
+        return EXIT_FAILURE;
+    }
+    if (detail_outputs.per_song) {
+        int song_path_len = snprintf(song_output_path, sizeof(song_output_path), "%s/word_counts_by_song.csv",
+                                     output_dir);
+        if (song_path_len < 0 || (size_t)song_path_len >= sizeof(song_output_path)) {
+            if (rank == 0) {
+                fprintf(stderr, "Per-song output path is too long\n");
+            }
+            MPI_Finalize();
+            return EXIT_FAILURE;
         }
-        ssize_t read_len = read_csv_record(text_fp, &line, &line_buf);
-        if (read_len < 0) {
-            break;
+    }
+    if (detail_outputs.per_artist) {
+        int artist_words_path_len = snprintf(artist_words_output_path, sizeof(artist_words_output_path),
+                                             "%s/word_counts_by_artist.csv", output_dir);
+        if (artist_words_path_len < 0 || (size_t)artist_words_path_len >= sizeof(artist_words_output_path)) {
+            if (rank == 0) {
+                fprintf(stderr, "Per-artist output path is too long\n");
+            }
+            MPI_Finalize();
+            return EXIT_FAILURE;
         }
-        if (read_len == 0) {
-            continue;
+    }
+    if (binary_output) {
+        int word_binary_len = snprintf(word_binary_path, sizeof(word_binary_path), "%s/word_counts.bin", output_dir);
+        int artist_binary_len =
+            snprintf(artist_binary_path, sizeof(artist_binary_path), "%s/top_artists.bin", output_dir);
+        if (word_binary_len < 0 || (size_t)word_binary_len >= sizeof(word_binary_path) || artist_binary_len < 0 ||
+            (size_t)artist_binary_len >= sizeof(artist_binary_path)) {
+            if (rank == 0) {
+                fprintf(stderr, "Binary output path is too long\n");
+            }
+            MPI_Finalize();
+            return EXIT_FAILURE;
         }
-        while (read_len > 0 && (line[read_len - 1] == '\n' || line[read_len - 1] == '\r')) {
-            line[--read_len] = '\0';
+    }
+    if (detail_outputs.artist_stats) {
+        int artist_stats_path_len = snprintf(artist_stats_output_path, sizeof(artist_stats_output_path),
+                                             "%s/artist_stats.csv", output_dir);
+        if (artist_stats_path_len < 0 || (size_t)artist_stats_path_len >= sizeof(artist_stats_output_path)) {
+            if (rank == 0) {
+                fprintf(stderr, "Artist statistics output path is too long\n");
+            }
+            MPI_Finalize();
+            return EXIT_FAILURE;
         }
-        char *lyrics = duplicate_field(line, 1);
-        if (lyrics && *lyrics) {
-            process_lyrics(&word_counts, lyrics, &local_word_total);
+    }
+    if (ngram_size) {
+        int ngram_path_len = snprintf(ngram_output_path, sizeof(ngram_output_path), "%s/ngram_counts.csv", output_dir);
+        if (ngram_path_len < 0 || (size_t)ngram_path_len >= sizeof(ngram_output_path)) {
+            if (rank == 0) {
+                fprintf(stderr, "N-gram output path is too long\n");
+            }
+            MPI_Finalize();
+            return EXIT_FAILURE;
         }
-        free(lyrics);
     }
-    free(line);
-    fclose(text_fp);
-
-    line = NULL;
-    line_buf = 0;
-
-    FILE *artist_fp = fopen(artist_split_path, "r");
-    if (!artist_fp) {
-        fprintf(stderr, "Rank %d failed to open artist column %s\n", rank, artist_split_path);
-        MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
+    if (detail_outputs.sentiment) {
+        int scores_len = snprintf(sentiment_scores_path, sizeof(sentiment_scores_path), "%s/sentiment_scores.csv",
+                                  output_dir);
+        int totals_len = snprintf(sentiment_totals_path, sizeof(sentiment_totals_path), "%s/sentiment_totals.json",
+                                  output_dir);
+        int artist_len = snprintf(sentiment_artist_path, sizeof(sentiment_artist_path),
+                                  "%s/sentiment_by_artist.csv", output_dir);
+        if (scores_len < 0 || (size_t)scores_len >= sizeof(sentiment_scores_path) || totals_len < 0 ||
+            (size_t)totals_len >= sizeof(sentiment_totals_path) || artist_len < 0 ||
+            (size_t)artist_len >= sizeof(sentiment_artist_path)) {
+            if (rank == 0) {
+                fprintf(stderr, "Sentiment output path is too long\n");
+            }
+            MPI_Finalize();
+            return EXIT_FAILURE;
+        }
     }
 
-    if (artist_local_start > artist_header_len) {
-        if (fseeko(artist_fp, artist_local_start, SEEK_SET) != 0) {
-            fprintf(stderr, "Rank %d failed to seek artist column offset %lld\n", rank, artist_local_start);
+    /* O cronômetro começa antes de qualquer leitura do dataset, incluindo o
+     * pré-processamento serial do modo legado, para que as métricas reflitam
+     * o tempo real de execução. */
+    MPI_Barrier(MPI_COMM_WORLD);
+    double start_time = MPI_Wtime();
+    double prepare_started = phase_clock();
+
+    long long data_start = 0;
+    /* Trecho do CSV lido nesta execução; no modo incremental começa no fim
+     * do trecho já contado pelo snapshot. */
+    long long scan_range[2] = {0, 0};
+    int snapshot_state = CACHE_OFF;
+    ResultSnapshot snapshot;
+    memset(&snapshot, 0, sizeof(snapshot));
+    if (rank == 0) {
+        if (ensure_directory_recursive(output_dir) != 0) {
+            fprintf(stderr, "Failed to prepare output directory %s: %s\n", output_dir, strerror(errno));
+            MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
+        }
+        if (!read_dataset_header(dataset_path, artist_header_label, sizeof(artist_header_label),
+                                 text_header_label, sizeof(text_header_label), &data_start)) {
             MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
         }
-        if (artist_local_start > artist_header_len) {
-            if (read_csv_record(artist_fp, &line, &line_buf) < 0) {
-                /* offset apontou além do fim */
+        if (use_split_columns) {
+            if (ensure_directory_recursive(split_dir) != 0) {
+                fprintf(stderr, "Failed to prepare split directory %s: %s\n", split_dir, strerror(errno));
+                MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
+            }
+            sanitize_header_name(artist_header_label, sanitized_artist, sizeof(sanitized_artist));
+            sanitize_header_name(text_header_label, sanitized_text, sizeof(sanitized_text));
+            ByteBuffer text_offsets = {NULL, 0, 0};
+            ByteBuffer artist_offsets = {NULL, 0, 0};
+            if (!split_dataset_columns(dataset_path, split_dir, sanitized_artist, sanitized_text,
+                                       artist_header_label, text_header_label,
+                                       artist_split_path, sizeof(artist_split_path),
+                                       text_split_path, sizeof(text_split_path), &text_offsets, &artist_offsets)) {
+                fprintf(stderr, "Failed to split dataset columns\n");
+                MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
+            }
+            split_bounds = (long long *)calloc(2U * ((size_t)world_size + 1U), sizeof(long long));
+            if (!split_bounds) {
+                fprintf(stderr, "Failed to allocate split column boundaries\n");
+                MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
             }
+            split_column_bounds(&text_offsets, &artist_offsets, world_size, split_bounds);
+            free(text_offsets.data);
+            free(artist_offsets.data);
         }
-    } else {
-        if (fseeko(artist_fp, artist_header_len, SEEK_SET) != 0) {
-            fprintf(stderr, "Rank %d failed to seek to artist header end\n", rank);
+        scan_range[0] = data_start;
+        scan_range[1] = get_file_size(dataset_path);
+        if (scan_range[1] < 0) {
+            fprintf(stderr, "Failed to obtain dataset size\n");
             MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
         }
+        if (snapshot_dir) {
+            snapshot_state = snapshot_load(snapshot_path, dataset_path, data_start, scan_range[1], &snapshot)
+                                 ? CACHE_HIT
+                                 : CACHE_BUILT;
+            if (snapshot_state == CACHE_HIT) {
+                scan_range[0] = (long long)snapshot.header.offset;
+            }
+        }
     }
 
-    while (1) {
-        long long position = ftello(artist_fp);
-        if (position < 0) {
-            break;
-        }
-        if (rank != world_size - 1 && position >= artist_local_end) {
-            break;
+    /* Com o índice de tokens disponível, o cache de colunas não é consultado. */
+    int index_state = CACHE_OFF;
+    int cache_state = CACHE_OFF;
+#ifdef HAVE_MMAP
+    if (index_dir) {
+        if (rank == 0) {
+            index_state = (int)prepare_token_index(dataset_path, data_start, index_dir, index_path);
         }
-        ssize_t read_len = read_csv_record(artist_fp, &line, &line_buf);
-        if (read_len < 0) {
-            break;
+        MPI_Bcast(&index_state, 1, MPI_INT, 0, MPI_COMM_WORLD);
+    }
+    if (cache_dir && index_state == CACHE_OFF) {
+        if (rank == 0) {
+            cache_state = (int)prepare_dataset_cache(dataset_path, data_start, cache_dir, cache_path);
         }
-        if (read_len == 0) {
-            continue;
+        MPI_Bcast(&cache_state, 1, MPI_INT, 0, MPI_COMM_WORLD);
+    }
+#endif
+
+    profile_add(PHASE_PREPARE, prepare_started);
+
+    LocalStats stats;
+    local_stats_init(&stats);
+    long long index_bytes_sent = 0;
+    if (reduce_mode == REDUCE_PIPELINE) {
+        schedule.split_static = 1;
+        pipeline_begin(rank, MPI_COMM_WORLD);
+    }
+    schedule_begin(&schedule, chunks_per_rank, rank, world_size, MPI_COMM_WORLD);
+
+    if (index_state != CACHE_OFF) {
+#ifdef HAVE_MMAP
+        index_bytes_sent = analyze_indexed_dataset(index_path, &schedule, &stats, rank);
+#endif
+    } else if (cache_state != CACHE_OFF) {
+#ifdef HAVE_MMAP
+        analyze_cached_dataset(cache_path, threads, &schedule, &stats, rank);
+#endif
+    } else if (use_split_columns) {
+        MPI_Bcast(sanitized_artist, (int)sizeof(sanitized_artist), MPI_CHAR, 0, MPI_COMM_WORLD);
+        MPI_Bcast(sanitized_text, (int)sizeof(sanitized_text), MPI_CHAR, 0, MPI_COMM_WORLD);
+
+        int artist_path_len = snprintf(artist_split_path, sizeof(artist_split_path), "%s/%s.csv", split_dir, sanitized_artist);
+        if (artist_path_len < 0 || (size_t)artist_path_len >= sizeof(artist_split_path)) {
+            if (rank == 0) {
+                fprintf(stderr, "Artist split path is too long\n");
+            }
+            MPI_Finalize();
+            return EXIT_FAILURE;
         }
-        while (read_len > 0 && (line[read_len - 1] == '\n' || line[read_len - 1] == '\r')) {
-            line[--read_len] = '\0';
+        int text_path_len = snprintf(text_split_path, sizeof(text_split_path), "%s/%s.csv", split_dir, sanitized_text);
+        if (text_path_len < 0 || (size_t)text_path_len >= sizeof(text_split_path)) {
+            if (rank == 0) {
+                fprintf(stderr, "Text split path is too long\n");
+            }
+            MPI_Finalize();
+            return EXIT_FAILURE;
         }
-        char *artist = duplicate_field(line, 0);
-        if (artist && *artist) {
-            ht_put(&artist_counts, artist, 1);
+
+        if (!split_bounds) {
+            split_bounds = (long long *)calloc(2U * ((size_t)world_size + 1U), sizeof(long long));
+            if (!split_bounds) {
+                fprintf(stderr, "Rank %d failed to allocate split column boundaries\n", rank);
+                MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
+            }
         }
-        local_song_total++;
-        free(artist);
+        MPI_Bcast(split_bounds, 2 * (world_size + 1), MPI_LONG_LONG, 0, MPI_COMM_WORLD);
+        analyze_split_columns(text_split_path, artist_split_path, split_bounds, &stats, rank, world_size);
+        free(split_bounds);
+        schedule.chunks_taken = 1;
+    } else {
+        MPI_Bcast(scan_range, 2, MPI_LONG_LONG, 0, MPI_COMM_WORLD);
+        analyze_csv_dataset(dataset_path, io_engine, scan_range[0], scan_range[1], threads, &schedule, &stats, rank,
+                            world_size);
     }
 
-    free(line);
-    fclose(artist_fp);
-
     double compute_time = MPI_Wtime() - start_time;
+    schedule_end(&schedule);
 
     CountType global_word_total = 0;
     CountType global_song_total = 0;
-    MPI_Reduce(&local_word_total, &global_word_total, 1, MPI_LONG_LONG, MPI_SUM, 0, MPI_COMM_WORLD);
-    MPI_Reduce(&local_song_total, &global_song_total, 1, MPI_LONG_LONG, MPI_SUM, 0, MPI_COMM_WORLD);
+    double phase_started = phase_clock();
+    MPI_Reduce(&stats.word_total, &global_word_total, 1, MPI_LONG_LONG, MPI_SUM, 0, MPI_COMM_WORLD);
+    MPI_Reduce(&stats.song_total, &global_song_total, 1, MPI_LONG_LONG, MPI_SUM, 0, MPI_COMM_WORLD);
+    rank_profile.counters[COUNTER_MESSAGES] += rank > 0 ? 2 : 0;
+    profile_add(PHASE_COMMUNICATE, phase_started);
 
     if (rank == 0) {
         ensure_output_dir(output_dir);
     }
+    /* Com escrita paralela, os demais ranks só abrem arquivos depois que o
+     * rank 0 criou o diretório de saída. */
+    if (detail_outputs.per_song || detail_outputs.sentiment_scores || write_mode == WRITE_MPIIO) {
+        MPI_Barrier(MPI_COMM_WORLD);
+    }
 
-    if (rank == 0) {
-        HashTable global_words;
-        HashTable global_artists;
-        ht_init(&global_words, word_counts.capacity);
-        ht_init(&global_artists, artist_counts.capacity);
-        ht_merge(&global_words, &word_counts);
-        ht_merge(&global_artists, &artist_counts);
+    /* Com limite, a seleção guarda também o suficiente para a prévia. */
+    size_t word_candidates = word_limit > 0 ? (size_t)(word_limit > PREVIEW_ITEMS ? word_limit : PREVIEW_ITEMS) : 0;
+    size_t artist_candidates = artist_limit > 0 ? (size_t)(artist_limit > PREVIEW_ITEMS ? artist_limit : PREVIEW_ITEMS) : 0;
 
-        ht_free(&word_counts);
-        ht_free(&artist_counts);
+    long long bytes_sent = 0;
+    double approx_distinct_words = 0.0;
+    double approx_distinct_artists = 0.0;
+    if (approx_counting) {
+        bytes_sent = reduce_tables_approx(&stats, rank, MPI_COMM_WORLD);
+        if (rank == 0) {
+            approx_distinct_words = approx_distinct(&stats.approx[APPROX_WORDS]);
+            approx_distinct_artists = approx_distinct(&stats.approx[APPROX_ARTISTS]);
+        }
+    } else if (reduce_mode == REDUCE_GATHER) {
+        bytes_sent = reduce_tables_gather(&stats, rank, world_size, MPI_COMM_WORLD);
+    } else if (reduce_mode == REDUCE_PIPELINE) {
+        bytes_sent = reduce_tables_pipeline(&stats, rank, world_size, MPI_COMM_WORLD);
+    } else if (reduce_mode == REDUCE_SHARD) {
+        bytes_sent = reduce_tables_shard(&stats, word_candidates, artist_candidates, rank, world_size, MPI_COMM_WORLD);
+    } else {
+        bytes_sent = reduce_tables_tree(&stats, rank, world_size, MPI_COMM_WORLD);
+    }
+    bytes_sent += index_bytes_sent;
 
-        for (int source = 1; source < world_size; ++source) {
-            receive_hash_table(&global_words, source, 100, MPI_COMM_WORLD);
-            receive_hash_table(&global_artists, source, 200, MPI_COMM_WORLD);
+    /* Modo incremental: as contagens do trecho novo se somam às do snapshot,
+     * e as tabelas completas resultantes formam o próximo snapshot. */
+    if (rank == 0 && snapshot_state == CACHE_HIT) {
+        phase_started = phase_clock();
+        snapshot_merge(&snapshot, &stats.word_counts, &stats.artist_counts);
+        global_song_total += snapshot.header.total_songs;
+        global_word_total += snapshot.header.total_words;
+        free(snapshot.data);
+        profile_add(PHASE_MERGE, phase_started);
+    }
+    if (rank == 0 && snapshot_dir) {
+        phase_started = phase_clock();
+        snapshot_save(snapshot_dir, snapshot_path, dataset_path, data_start, scan_range[1], global_song_total,
+                      global_word_total, &stats.word_counts, &stats.artist_counts);
+        profile_add(PHASE_WRITE, phase_started);
+    }
+
+    /* Saídas detalhadas: as linhas por música já estão na ordem do dataset em
+     * cada rank e são gravadas em paralelo; os pares por artista são somados
+     * no rank 0, que grava o arquivo ordenado. */
+    if (detail_outputs.per_song) {
+        phase_started = phase_clock();
+        if (schedule.mode == SCHEDULE_DYNAMIC) {
+            write_row_spans_parallel(song_output_path, "artist,song,word,count\r\n", &stats.song_rows,
+                                     (const RowSpan *)schedule.spans.data, schedule.spans.size / sizeof(RowSpan),
+                                     (size_t)schedule.chunk_count, rank, MPI_COMM_WORLD);
+        } else {
+            write_rows_parallel(song_output_path, "artist,song,word,count\r\n", &stats.song_rows, rank,
+                                MPI_COMM_WORLD);
+        }
+        profile_add(PHASE_WRITE, phase_started);
+    }
+    /* Sentimento: as linhas por música seguem o mesmo caminho das de
+     * word_counts_by_song.csv; os totais vão ao rank 0 com um MPI_Reduce e os
+     * rótulos por artista, em árvore. */
+    CountType sentiment_totals[SENTIMENT_TOTALS] = {0, 0, 0, 0};
+    if (detail_outputs.sentiment) {
+        phase_started = phase_clock();
+        MPI_Reduce(stats.sentiment_totals, sentiment_totals, SENTIMENT_TOTALS, MPI_LONG_LONG, MPI_SUM, 0,
+                   MPI_COMM_WORLD);
+        rank_profile.counters[COUNTER_MESSAGES] += rank > 0 ? 1 : 0;
+        profile_add(PHASE_COMMUNICATE, phase_started);
+        if (detail_outputs.sentiment_scores) {
+            phase_started = phase_clock();
+            const char *header = "artist,song,positive,negative,score,label,ambiguous\r\n";
+            if (schedule.mode == SCHEDULE_DYNAMIC) {
+                write_row_spans_parallel(sentiment_scores_path, header, &stats.sentiment_rows,
+                                         (const RowSpan *)schedule.sentiment_spans.data,
+                                         schedule.sentiment_spans.size / sizeof(RowSpan),
+                                         (size_t)schedule.chunk_count, rank, MPI_COMM_WORLD);
+            } else {
+                write_rows_parallel(sentiment_scores_path, header, &stats.sentiment_rows, rank, MPI_COMM_WORLD);
+            }
+            profile_add(PHASE_WRITE, phase_started);
+        }
+        bytes_sent += reduce_table_tree(&stats.artist_sentiment, 800, rank, world_size, MPI_COMM_WORLD);
+        if (rank == 0) {
+            phase_started = phase_clock();
+            write_sentiment_totals_json(sentiment_totals, sentiment_totals_path);
+            write_sentiment_by_artist_csv(&stats.artist_sentiment, sentiment_artist_path);
+            profile_add(PHASE_WRITE, phase_started);
+        }
+    }
+    if (detail_outputs.artist_stats) {
+        HashTable artist_rows;
+        bytes_sent += reduce_artist_stats(&stats, (size_t)detail_outputs.artist_stats, &artist_rows, rank, world_size,
+                                          MPI_COMM_WORLD);
+        if (rank == 0) {
+            phase_started = phase_clock();
+            write_artist_stats_csv(&artist_rows, artist_stats_output_path);
+            profile_add(PHASE_WRITE, phase_started);
+            ht_free(&artist_rows);
+        }
+    }
+    if (detail_outputs.per_artist) {
+        bytes_sent += reduce_table_tree(&stats.artist_words, 400, rank, world_size, MPI_COMM_WORLD);
+        if (rank == 0) {
+            phase_started = phase_clock();
+            write_artist_words_csv(&stats.artist_words, artist_words_output_path);
+            profile_add(PHASE_WRITE, phase_started);
         }
+    }
 
-        snprintf(word_output_path, sizeof(word_output_path), "%s/word_counts.csv", output_dir);
-        snprintf(artist_output_path, sizeof(artist_output_path), "%s/top_artists.csv", output_dir);
-        snprintf(metrics_output_path, sizeof(metrics_output_path), "%s/performance_metrics.json", output_dir);
+    /* N-gramas: segunda passada sobre o índice, com chaves inteiras até o rank 0. */
+    CountType ngram_totals[2] = {0, 0};
+    size_t ngram_array_size = 0;
+    Entry *ngram_entries = NULL;
+    HashTable ngrams;
+    memset(&ngrams, 0, sizeof(ngrams));
+#ifdef HAVE_MMAP
+    if (ngram_size && index_state != CACHE_OFF) {
+        size_t ngram_candidates =
+            ngram_limit > 0 ? (size_t)(ngram_limit > PREVIEW_ITEMS ? ngram_limit : PREVIEW_ITEMS) : 0;
+        bytes_sent += count_ngrams(index_path, ngram_size, ngram_candidates, &ngrams, ngram_totals, rank,
+                                   world_size, MPI_COMM_WORLD);
+        if (rank == 0) {
+            phase_started = phase_clock();
+            ngram_entries = select_top_entries(&ngrams, ngram_candidates, &ngram_array_size);
+            profile_add(PHASE_SORT, phase_started);
+            phase_started = phase_clock();
+            write_table_csv(ngram_entries, ngram_array_size, ngram_output_path, "ngram", ngram_limit);
+            profile_add(PHASE_WRITE, phase_started);
+        }
+    }
+#endif
 
-        write_table_csv(&global_words, word_output_path, "word", word_limit);
-        write_table_csv(&global_artists, artist_output_path, "artist", artist_limit);
+    snprintf(word_output_path, sizeof(word_output_path), "%s/word_counts.csv", output_dir);
+    snprintf(artist_output_path, sizeof(artist_output_path), "%s/top_artists.csv", output_dir);
+    size_t word_array_size = 0;
+    Entry *word_entries = NULL;
+    size_t artist_array_size = 0;
+    Entry *artist_entries = NULL;
+    if (rank == 0) {
+        snprintf(metrics_output_path, sizeof(metrics_output_path), "%s/performance_metrics.json", output_dir);
 
-        size_t word_array_size = 0;
-        Entry *word_entries = ht_to_array(&global_words, &word_array_size);
-        qsort(word_entries, word_array_size, sizeof(Entry), entry_compare_desc);
-        size_t artist_array_size = 0;
-        Entry *artist_entries = ht_to_array(&global_artists, &artist_array_size);
-        qsort(artist_entries, artist_array_size, sizeof(Entry), entry_compare_desc);
+        /* Uma única seleção atende ao arquivo de saída e à prévia impressa. */
+        phase_started = phase_clock();
+        word_entries = select_top_entries(&stats.word_counts, word_candidates, &word_array_size);
+        artist_entries = select_top_entries(&stats.artist_counts, artist_candidates, &artist_array_size);
+        profile_add(PHASE_SORT, phase_started);
+    }
+    phase_started = phase_clock();
+    if (write_mode == WRITE_MPIIO) {
+        bytes_sent += write_table_parallel(word_entries, word_array_size, word_output_path, "word", word_limit,
+                                           rank, world_size, MPI_COMM_WORLD);
+        bytes_sent += write_table_parallel(artist_entries, artist_array_size, artist_output_path, "artist",
+                                           artist_limit, rank, world_size, MPI_COMM_WORLD);
+    } else if (rank == 0) {
+        write_table_csv(word_entries, word_array_size, word_output_path, "word", word_limit);
+        write_table_csv(artist_entries, artist_array_size, artist_output_path, "artist", artist_limit);
+    }
+    if (rank == 0 && binary_output) {
+        write_table_binary(word_entries, word_array_size, word_binary_path, word_limit);
+        write_table_binary(artist_entries, artist_array_size, artist_binary_path, artist_limit);
+    }
+    profile_add(PHASE_WRITE, phase_started);
 
+    if (rank == 0) {
         printf("=== Parallel Spotify Analysis ===\n");
+        if (snapshot_state == CACHE_HIT) {
+            printf("Resumed from snapshot: %lld new bytes processed\n", scan_range[1] - scan_range[0]);
+        }
         printf("Total songs processed: %lld\n", (long long)global_song_total);
         printf("Total words counted: %lld\n", (long long)global_word_total);
-        size_t preview_words = word_array_size < 10 ? word_array_size : 10;
+        if (approx_counting) {
+            printf("Approximate counts: ~%.0f distinct words, ~%.0f distinct artists, word error <= %lld\n",
+                   approx_distinct_words, approx_distinct_artists,
+                   (long long)ceil(exp(1.0) * (double)global_word_total / (double)APPROX_WIDTH));
+        }
+        size_t preview_words = word_array_size < PREVIEW_ITEMS ? word_array_size : PREVIEW_ITEMS;
         printf("Top %zu words:\n", preview_words);
         for (size_t i = 0; i < preview_words; ++i) {
             printf("  %s: %lld\n", word_entries[i].key, word_entries[i].value);
         }
-        size_t preview_artists = artist_array_size < 10 ? artist_array_size : 10;
+        size_t preview_artists = artist_array_size < PREVIEW_ITEMS ? artist_array_size : PREVIEW_ITEMS;
         printf("Top %zu artists:\n", preview_artists);
         for (size_t i = 0; i < preview_artists; ++i) {
             printf("  %s: %lld songs\n", artist_entries[i].key, artist_entries[i].value);
         }
-
-        free(word_entries);
-        free(artist_entries);
-
-        ht_free(&global_words);
-        ht_free(&global_artists);
-    } else {
-        send_hash_table(&word_counts, 0, 100, MPI_COMM_WORLD);
-        send_hash_table(&artist_counts, 0, 200, MPI_COMM_WORLD);
-        ht_free(&word_counts);
-        ht_free(&artist_counts);
+        if (detail_outputs.sentiment) {
+            printf("Sentiment: %lld positive, %lld neutral, %lld negative (%lld ambiguous)\n",
+                   (long long)sentiment_totals[SENTIMENT_POSITIVE], (long long)sentiment_totals[SENTIMENT_NEUTRAL],
+                   (long long)sentiment_totals[SENTIMENT_NEGATIVE], (long long)sentiment_totals[SENTIMENT_AMBIGUOUS]);
+        }
+        if (ngram_entries) {
+            printf("Total %u-grams counted: %lld (%lld distinct)\n", ngram_size, (long long)ngram_totals[0],
+                   (long long)ngram_totals[1]);
+            size_t preview_ngrams = ngram_array_size < PREVIEW_ITEMS ? ngram_array_size : PREVIEW_ITEMS;
+            printf("Top %zu %u-grams:\n", preview_ngrams, ngram_size);
+            for (size_t i = 0; i < preview_ngrams; ++i) {
+                printf("  %s: %lld\n", ngram_entries[i].key, ngram_entries[i].value);
+            }
+        }
+    }
+    free(word_entries);
+    free(artist_entries);
+    free(ngram_entries);
+    ht_free(&ngrams);
+    /* Os contadores das tabelas entram no perfil do processo quando elas são liberadas. */
+    profile_merge(&rank_profile, &stats.profile);
+    rank_profile.counters[COUNTER_RECORDS] += stats.song_total;
+    rank_profile.counters[COUNTER_TOKENS] += stats.word_total;
+    local_stats_free(&stats);
+    if (policy.is_stopword == custom_stopword) {
+        ht_free(&custom_stopwords);
     }
 
     MPI_Barrier(MPI_COMM_WORLD);
@@ -1081,6 +6882,24 @@ int main(int argc, char **argv) {
     MPI_Reduce(&total_time, &max_total, 1, MPI_DOUBLE, MPI_MAX, 0, MPI_COMM_WORLD);
     MPI_Reduce(&total_time, &min_total, 1, MPI_DOUBLE, MPI_MIN, 0, MPI_COMM_WORLD);
 
+    long long *chunks_per_process = rank == 0 ? (long long *)calloc((size_t)world_size, sizeof(long long)) : NULL;
+    MPI_Gather(&schedule.chunks_taken, 1, MPI_LONG_LONG, chunks_per_process, 1, MPI_LONG_LONG, 0, MPI_COMM_WORLD);
+    free(schedule.spans.data);
+    free(schedule.sentiment_spans.data);
+
+    double *phase_seconds = rank == 0 ? (double *)calloc((size_t)world_size * PHASE_COUNT, sizeof(double)) : NULL;
+    long long *counter_values =
+        rank == 0 ? (long long *)calloc((size_t)world_size * COUNTER_COUNT, sizeof(long long)) : NULL;
+    MPI_Gather(rank_profile.seconds, PHASE_COUNT, MPI_DOUBLE, phase_seconds, PHASE_COUNT, MPI_DOUBLE, 0,
+               MPI_COMM_WORLD);
+    MPI_Gather(rank_profile.counters, COUNTER_COUNT, MPI_LONG_LONG, counter_values, COUNTER_COUNT, MPI_LONG_LONG, 0,
+               MPI_COMM_WORLD);
+
+    long long total_bytes_sent = 0;
+    long long max_bytes_sent = 0;
+    MPI_Reduce(&bytes_sent, &total_bytes_sent, 1, MPI_LONG_LONG, MPI_SUM, 0, MPI_COMM_WORLD);
+    MPI_Reduce(&bytes_sent, &max_bytes_sent, 1, MPI_LONG_LONG, MPI_MAX, 0, MPI_COMM_WORLD);
+
     if (rank == 0) {
         double avg_compute = sum_compute / world_size;
         double avg_total = sum_total / world_size;
@@ -1091,6 +6910,42 @@ int main(int argc, char **argv) {
             fprintf(metrics_fp, "  \"processes\": %d,\n", world_size);
             fprintf(metrics_fp, "  \"total_songs\": %lld,\n", (long long)global_song_total);
             fprintf(metrics_fp, "  \"total_words\": %lld,\n", (long long)global_word_total);
+            fprintf(metrics_fp, "  \"tokenizer_kernel\": \"%s\",\n", tokenizer_kernel);
+            fprintf(metrics_fp, "  \"dataset_cache\": \"%s\",\n",
+                    cache_state == CACHE_HIT ? "hit" : (cache_state == CACHE_BUILT ? "built" : "off"));
+            fprintf(metrics_fp, "  \"token_index\": \"%s\",\n",
+                    index_state == CACHE_HIT ? "hit" : (index_state == CACHE_BUILT ? "built" : "off"));
+            fprintf(metrics_fp, "  \"incremental\": \"%s\",\n",
+                    snapshot_state == CACHE_HIT ? "hit" : (snapshot_state == CACHE_BUILT ? "built" : "off"));
+            if (snapshot_dir) {
+                fprintf(metrics_fp, "  \"incremental_start\": %lld,\n", scan_range[0]);
+            }
+            fprintf(metrics_fp, "  \"approximate\": %s,\n", approx_counting ? "true" : "false");
+            fprintf(metrics_fp, "  \"ngram_size\": %u,\n", ngram_size);
+            if (ngram_size) {
+                fprintf(metrics_fp, "  \"ngram_total\": %lld,\n", (long long)ngram_totals[0]);
+                fprintf(metrics_fp, "  \"ngram_distinct\": %lld,\n", (long long)ngram_totals[1]);
+            }
+            if (detail_outputs.sentiment) {
+                fprintf(metrics_fp, "  \"sentiment_ambiguous\": %lld,\n",
+                        (long long)sentiment_totals[SENTIMENT_AMBIGUOUS]);
+            }
+            if (approx_counting) {
+                fprintf(metrics_fp, "  \"approx_distinct_words\": %.0f,\n", approx_distinct_words);
+                fprintf(metrics_fp, "  \"approx_distinct_artists\": %.0f,\n", approx_distinct_artists);
+                fprintf(metrics_fp, "  \"approx_word_error_bound\": %lld,\n",
+                        (long long)ceil(exp(1.0) * (double)global_word_total / (double)APPROX_WIDTH));
+            }
+            fprintf(metrics_fp, "  \"schedule\": \"%s\",\n", schedule.mode == SCHEDULE_DYNAMIC ? "dynamic" : "static");
+            fprintf(metrics_fp, "  \"chunks_per_rank\": [");
+            for (int r = 0; r < world_size; ++r) {
+                fprintf(metrics_fp, "%s%lld", r > 0 ? ", " : "", chunks_per_process ? chunks_per_process[r] : 0LL);
+            }
+            fprintf(metrics_fp, "],\n");
+            fprintf(metrics_fp, "  \"communication_bytes\": {\n");
+            fprintf(metrics_fp, "    \"total\": %lld,\n", total_bytes_sent);
+            fprintf(metrics_fp, "    \"max_per_rank\": %lld\n", max_bytes_sent);
+            fprintf(metrics_fp, "  },\n");
             fprintf(metrics_fp, "  \"compute_time\": {\n");
             fprintf(metrics_fp, "    \"avg_seconds\": %.6f,\n", avg_compute);
             fprintf(metrics_fp, "    \"min_seconds\": %.6f,\n", min_compute);
@@ -1100,7 +6955,8 @@ int main(int argc, char **argv) {
             fprintf(metrics_fp, "    \"avg_seconds\": %.6f,\n", avg_total);
             fprintf(metrics_fp, "    \"min_seconds\": %.6f,\n", min_total);
             fprintf(metrics_fp, "    \"max_seconds\": %.6f\n", max_total);
-            fprintf(metrics_fp, "  }\n");
+            fprintf(metrics_fp, "  },\n");
+            write_profile_json(metrics_fp, phase_seconds, counter_values, world_size);
             fprintf(metrics_fp, "}\n");
             fclose(metrics_fp);
         } else {
@@ -1108,6 +6964,10 @@ int main(int argc, char **argv) {
         }
     }
 
+    free(chunks_per_process);
+    free(phase_seconds);
+    free(counter_values);
     MPI_Finalize();
     return EXIT_SUCCESS;
 }
+#endif
@@ -0,0 +1,544 @@
+/* Gerado por scripts/generate_stopwords.py a partir de src/stopwords_default.txt; não editar. */
+#ifndef STOPWORDS_DEFAULT_H
+#define STOPWORDS_DEFAULT_H
+
+#define STOPWORD_COUNT 179
+#define STOPWORD_MAX_LENGTH 10
+#define STOPWORD_TABLE_BITS 9
+#define STOPWORD_BUCKETS 128
+
+static const uint32_t stopword_seeds[STOPWORD_BUCKETS] = {
+    0U, 1U, 4U, 0U, 0U, 0U, 1U, 0U,
+    1U, 0U, 0U, 0U, 0U, 0U, 0U, 0U,
+    3U, 5U, 0U, 0U, 0U, 0U, 0U, 0U,
+    0U, 0U, 0U, 1U, 1U, 0U, 0U, 0U,
+    0U, 0U, 1U, 0U, 0U, 0U, 1U, 0U,
+    0U, 0U, 0U, 0U, 0U, 0U, 0U, 0U,
+    0U, 0U, 0U, 0U, 1U, 1U, 0U, 0U,
+    0U, 0U, 0U, 2U, 0U, 0U, 0U, 3U,
+    2U, 0U, 1U, 0U, 0U, 0U, 2U, 0U,
+    0U, 0U, 1U, 0U, 0U, 0U, 1U, 1U,
+    0U, 0U, 0U, 0U, 1U, 0U, 0U, 0U,
+    0U, 0U, 0U, 0U, 0U, 0U, 0U, 0U,
+    0U, 0U, 0U, 0U, 0U, 0U, 1U, 0U,
+    1U, 1U, 0U, 0U, 0U, 0U, 0U, 0U,
+    0U, 0U, 0U, 0U, 3U, 0U, 0U, 0U,
+    0U, 0U, 0U, 0U, 2U, 0U, 2U, 0U,
+};
+
+static const StringView stopword_table[1U << STOPWORD_TABLE_BITS] = {
+    {NULL, 0},
+    {"before", 6},
+    {NULL, 0},
+    {NULL, 0},
+    {NULL, 0},
+    {"which", 5},
+    {"does", 4},
+    {NULL, 0},
+    {"wouldn't", 8},
+    {"if", 2},
+    {NULL, 0},
+    {NULL, 0},
+    {"too", 3},
+    {NULL, 0},
+    {NULL, 0},
+    {NULL, 0},
+    {NULL, 0},
+    {NULL, 0},
+    {"a", 1},
+    {NULL, 0},
+    {NULL, 0},
+    {NULL, 0},
+    {NULL, 0},
+    {"m", 1},
+    {NULL, 0},
+    {NULL, 0},
+    {"some", 4},
+    {"do", 2},
+    {"when", 4},
+    {"you're", 6},
+    {NULL, 0},
+    {"him", 3},
+    {"herself", 7},
+    {"most", 4},
+    {NULL, 0},
+    {"whom", 4},
+    {NULL, 0},
+    {NULL, 0},
+    {NULL, 0},
+    {NULL, 0},
+    {NULL, 0},
+    {"out", 3},
+    {NULL, 0},
+    {"don", 3},
+    {NULL, 0},
+    {NULL, 0},
+    {"weren", 5},
+    {"aren", 4},
+    {NULL, 0},
+    {"d", 1},
+    {NULL, 0},
+    {"by", 2},
+    {NULL, 0},
+    {NULL, 0},
+    {NULL, 0},
+    {NULL, 0},
+    {NULL, 0},
+    {NULL, 0},
+    {NULL, 0},
+    {NULL, 0},
+    {"was", 3},
+    {"no", 2},
+    {NULL, 0},
+    {NULL, 0},
+    {"while", 5},
+    {NULL, 0},
+    {NULL, 0},
+    {NULL, 0},
+    {NULL, 0},
+    {NULL, 0},
+    {"shouldn", 7},
+    {"it's", 4},
+    {NULL, 0},
+    {NULL, 0},
+    {NULL, 0},
+    {NULL, 0},
+    {NULL, 0},
+    {NULL, 0},
+    {NULL, 0},
+    {NULL, 0},
+    {NULL, 0},
+    {NULL, 0},
+    {NULL, 0},
+    {NULL, 0},
+    {"there", 5},
+    {NULL, 0},
+    {NULL, 0},
+    {"just", 4},
+    {"shan't", 6},
+    {NULL, 0},
+    {"to", 2},
+    {"once", 4},
+    {NULL, 0},
+    {NULL, 0},
+    {"between", 7},
+    {NULL, 0},
+    {NULL, 0},
+    {"didn't", 6},
+    {NULL, 0},
+    {NULL, 0},
+    {"that'll", 7},
+    {NULL, 0},
+    {"doesn't", 7},
+    {NULL, 0},
+    {"because", 7},
+    {NULL, 0},
+    {"about", 5},
+    {"theirs", 6},
+    {NULL, 0},
+    {"over", 4},
+    {NULL, 0},
+    {NULL, 0},
+    {NULL, 0},
+    {NULL, 0},
+    {"mustn", 5},
+    {"their", 5},
+    {"during", 6},
+    {NULL, 0},
+    {NULL, 0},
+    {NULL, 0},
+    {NULL, 0},
+    {NULL, 0},
+    {NULL, 0},
+    {"any", 3},
+    {"against", 7},
+    {NULL, 0},
+    {NULL, 0},
+    {"weren't", 7},
+    {NULL, 0},
+    {NULL, 0},
+    {NULL, 0},
+    {"on", 2},
+    {NULL, 0},
+    {"you'll", 6},
+    {"your", 4},
+    {"haven", 5},
+    {"had", 3},
+    {"you", 3},
+    {"nor", 3},
+    {NULL, 0},
+    {NULL, 0},
+    {NULL, 0},
+    {NULL, 0},
+    {NULL, 0},
+    {"her", 3},
+    {"me", 2},
+    {"been", 4},
+    {"itself", 6},
+    {NULL, 0},
+    {NULL, 0},
+    {"y", 1},
+    {"such", 4},
+    {"mustn't", 7},
+    {"hasn", 4},
+    {"isn", 3},
+    {NULL, 0},
+    {NULL, 0},
+    {NULL, 0},
+    {NULL, 0},
+    {NULL, 0},
+    {NULL, 0},
+    {"in", 2},
+    {"s", 1},
+    {NULL, 0},
+    {"we", 2},
+    {NULL, 0},
+    {"hadn", 4},
+    {NULL, 0},
+    {"further", 7},
+    {"now", 3},
+    {"few", 3},
+    {NULL, 0},
+    {NULL, 0},
+    {"yours", 5},
+    {"has", 3},
+    {NULL, 0},
+    {NULL, 0},
+    {NULL, 0},
+    {"be", 2},
+    {"were", 4},
+    {NULL, 0},
+    {NULL, 0},
+    {"or", 2},
+    {"above", 5},
+    {NULL, 0},
+    {NULL, 0},
+    {NULL, 0},
+    {"ain", 3},
+    {NULL, 0},
+    {NULL, 0},
+    {NULL, 0},
+    {"until", 5},
+    {NULL, 0},
+    {NULL, 0},
+    {"doing", 5},
+    {"are", 3},
+    {NULL, 0},
+    {"you've", 6},
+    {NULL, 0},
+    {NULL, 0},
+    {NULL, 0},
+    {NULL, 0},
+    {NULL, 0},
+    {NULL, 0},
+    {NULL, 0},
+    {"have", 4},
+    {NULL, 0},
+    {NULL, 0},
+    {NULL, 0},
+    {"through", 7},
+    {NULL, 0},
+    {NULL, 0},
+    {NULL, 0},
+    {NULL, 0},
+    {NULL, 0},
+    {NULL, 0},
+    {NULL, 0},
+    {NULL, 0},
+    {"both", 4},
+    {"being", 5},
+    {NULL, 0},
+    {"more", 4},
+    {NULL, 0},
+    {"here", 4},
+    {NULL, 0},
+    {"should", 6},
+    {NULL, 0},
+    {NULL, 0},
+    {NULL, 0},
+    {NULL, 0},
+    {NULL, 0},
+    {"from", 4},
+    {"themselves", 10},
+    {NULL, 0},
+    {NULL, 0},
+    {NULL, 0},
+    {NULL, 0},
+    {NULL, 0},
+    {NULL, 0},
+    {NULL, 0},
+    {NULL, 0},
+    {NULL, 0},
+    {NULL, 0},
+    {"mightn't", 8},
+    {"couldn't", 8},
+    {NULL, 0},
+    {NULL, 0},
+    {NULL, 0},
+    {NULL, 0},
+    {NULL, 0},
+    {NULL, 0},
+    {NULL, 0},
+    {"after", 5},
+    {NULL, 0},
+    {NULL, 0},
+    {NULL, 0},
+    {"it", 2},
+    {"i", 1},
+    {NULL, 0},
+    {"what", 4},
+    {NULL, 0},
+    {"wasn't", 6},
+    {NULL, 0},
+    {NULL, 0},
+    {NULL, 0},
+    {NULL, 0},
+    {NULL, 0},
+    {NULL, 0},
+    {"and", 3},
+    {"mightn", 6},
+    {"hadn't", 6},
+    {NULL, 0},
+    {NULL, 0},
+    {"wasn", 4},
+    {"each", 4},
+    {"isn't", 5},
+    {"why", 3},
+    {"not", 3},
+    {NULL, 0},
+    {NULL, 0},
+    {"then", 4},
+    {"how", 3},
+    {NULL, 0},
+    {NULL, 0},
+    {"so", 2},
+    {"hers", 4},
+    {"very", 4},
+    {"needn't", 7},
+    {NULL, 0},
+    {"than", 4},
+    {NULL, 0},
+    {"into", 4},
+    {NULL, 0},
+    {"for", 3},
+    {NULL, 0},
+    {NULL, 0},
+    {NULL, 0},
+    {"an", 2},
+    {NULL, 0},
+    {NULL, 0},
+    {NULL, 0},
+    {NULL, 0},
+    {NULL, 0},
+    {NULL, 0},
+    {NULL, 0},
+    {NULL, 0},
+    {NULL, 0},
+    {NULL, 0},
+    {NULL, 0},
+    {NULL, 0},
+    {NULL, 0},
+    {"this", 4},
+    {NULL, 0},
+    {NULL, 0},
+    {NULL, 0},
+    {NULL, 0},
+    {NULL, 0},
+    {NULL, 0},
+    {NULL, 0},
+    {"needn", 5},
+    {NULL, 0},
+    {NULL, 0},
+    {"the", 3},
+    {NULL, 0},
+    {NULL, 0},
+    {NULL, 0},
+    {NULL, 0},
+    {NULL, 0},
+    {NULL, 0},
+    {NULL, 0},
+    {NULL, 0},
+    {"all", 3},
+    {"t", 1},
+    {"ll", 2},
+    {NULL, 0},
+    {NULL, 0},
+    {"wouldn", 6},
+    {NULL, 0},
+    {NULL, 0},
+    {NULL, 0},
+    {"aren't", 6},
+    {"couldn", 6},
+    {"did", 3},
+    {"they", 4},
+    {NULL, 0},
+    {NULL, 0},
+    {"same", 4},
+    {NULL, 0},
+    {NULL, 0},
+    {NULL, 0},
+    {NULL, 0},
+    {NULL, 0},
+    {NULL, 0},
+    {NULL, 0},
+    {NULL, 0},
+    {NULL, 0},
+    {NULL, 0},
+    {NULL, 0},
+    {NULL, 0},
+    {NULL, 0},
+    {NULL, 0},
+    {"will", 4},
+    {NULL, 0},
+    {"she", 3},
+    {"shan", 4},
+    {NULL, 0},
+    {"won", 3},
+    {NULL, 0},
+    {NULL, 0},
+    {NULL, 0},
+    {NULL, 0},
+    {"that", 4},
+    {NULL, 0},
+    {"as", 2},
+    {NULL, 0},
+    {NULL, 0},
+    {NULL, 0},
+    {"with", 4},
+    {NULL, 0},
+    {"ma", 2},
+    {NULL, 0},
+    {"up", 2},
+    {NULL, 0},
+    {NULL, 0},
+    {"these", 5},
+    {NULL, 0},
+    {NULL, 0},
+    {NULL, 0},
+    {NULL, 0},
+    {"shouldn't", 9},
+    {NULL, 0},
+    {NULL, 0},
+    {NULL, 0},
+    {NULL, 0},
+    {NULL, 0},
+    {NULL, 0},
+    {"o", 1},
+    {NULL, 0},
+    {NULL, 0},
+    {NULL, 0},
+    {NULL, 0},
+    {NULL, 0},
+    {NULL, 0},
+    {"of", 2},
+    {NULL, 0},
+    {"down", 4},
+    {NULL, 0},
+    {NULL, 0},
+    {NULL, 0},
+    {NULL, 0},
+    {NULL, 0},
+    {NULL, 0},
+    {"himself", 7},
+    {"its", 3},
+    {"yourselves", 10},
+    {NULL, 0},
+    {NULL, 0},
+    {NULL, 0},
+    {"hasn't", 6},
+    {"where", 5},
+    {NULL, 0},
+    {"who", 3},
+    {NULL, 0},
+    {"my", 2},
+    {NULL, 0},
+    {NULL, 0},
+    {NULL, 0},
+    {NULL, 0},
+    {NULL, 0},
+    {NULL, 0},
+    {"she's", 5},
+    {"under", 5},
+    {NULL, 0},
+    {NULL, 0},
+    {NULL, 0},
+    {"doesn", 5},
+    {NULL, 0},
+    {"can", 3},
+    {NULL, 0},
+    {NULL, 0},
+    {"he", 2},
+    {NULL, 0},
+    {NULL, 0},
+    {"don't", 5},
+    {NULL, 0},
+    {NULL, 0},
+    {"you'd", 5},
+    {NULL, 0},
+    {NULL, 0},
+    {"own", 3},
+    {NULL, 0},
+    {"myself", 6},
+    {NULL, 0},
+    {"our", 3},
+    {NULL, 0},
+    {NULL, 0},
+    {"should've", 9},
+    {"those", 5},
+    {NULL, 0},
+    {NULL, 0},
+    {NULL, 0},
+    {"his", 3},
+    {"other", 5},
+    {"ve", 2},
+    {"is", 2},
+    {NULL, 0},
+    {NULL, 0},
+    {NULL, 0},
+    {"re", 2},
+    {NULL, 0},
+    {"only", 4},
+    {NULL, 0},
+    {"having", 6},
+    {NULL, 0},
+    {NULL, 0},
+    {"but", 3},
+    {"ourselves", 9},
+    {NULL, 0},
+    {NULL, 0},
+    {NULL, 0},
+    {"at", 2},
+    {NULL, 0},
+    {"didn", 4},
+    {NULL, 0},
+    {"haven't", 7},
+    {"again", 5},
+    {NULL, 0},
+    {NULL, 0},
+    {NULL, 0},
+    {"them", 4},
+    {NULL, 0},
+    {NULL, 0},
+    {NULL, 0},
+    {"won't", 5},
+    {NULL, 0},
+    {NULL, 0},
+    {"below", 5},
+    {NULL, 0},
+    {"off", 3},
+    {NULL, 0},
+    {NULL, 0},
+    {NULL, 0},
+    {NULL, 0},
+    {NULL, 0},
+    {NULL, 0},
+    {"yourself", 8},
+    {"am", 2},
+    {NULL, 0},
+    {NULL, 0},
+    {"ours", 4},
+    {NULL, 0},
+    {NULL, 0},
+};
+
+#endif